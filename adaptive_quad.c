@@ -0,0 +1,320 @@
+/*
+ * Task-parallel adaptive Gauss-Kronrod quadrature
+ *
+ * Integrates a 1-D function to an absolute tolerance by recursive
+ * bisection: every interval is evaluated with the 15-point Kronrod rule
+ * and its embedded 7-point Gauss rule, |K15 - G7| is the local error
+ * estimate, and an interval is accepted once that estimate is below its
+ * share of the tolerance, tol * width / (b - a).
+ *
+ * Intervals are processed depth-first from a small stack owned by the
+ * running task, so refining a piece costs no task creation. Only when a
+ * stack holds more than QUAD_SHARE pending intervals is the oldest (and
+ * widest) one handed to a new OpenMP task for idle threads to pick up.
+ * Results and counters go to per-thread cache-line-padded slots.
+ *
+ * The uniform midpoint rule of piWithReduction.c is run as the baseline
+ * at equal accuracy: its step count is doubled until it reaches the error
+ * the adaptive integrator achieved (or the tolerance, if that is larger).
+ *
+ * Compile: gcc -fopenmp -O2 adaptive_quad.c -o adaptive_quad -lm
+ * Run: ./adaptive_quad [tolerance] [integrand] [threads]
+ *      integrands: pi (default), sqrt, log, peak, osc
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <omp.h>
+#include "bench.h"
+
+#define QUAD_STACK 128
+#define QUAD_SHARE 8              // Pending intervals before one is given away as a task
+#define QUAD_MIN_WIDTH 1e-12      // Accept narrower intervals regardless of the estimate
+#define QUAD_INITIAL_PER_THREAD 4 // Initial tasks per thread
+#define QUAD_POINTS 15
+#define BASELINE_MIN_STEPS 1000
+#define BASELINE_MAX_STEPS 1500000000L  // num_steps of piWithReduction.c
+
+// Kronrod nodes (positive half, last is the centre) and weights; Gauss
+// nodes are the odd-indexed Kronrod nodes
+static const double xgk[8] = {
+    0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+    0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+    0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+    0.207784955007898467600689403773245, 0.000000000000000000000000000000000};
+static const double wgk[8] = {
+    0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+    0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+    0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+    0.204432940075298892414161999234649, 0.209482141084727828012999174891714};
+static const double wg[4] = {
+    0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+    0.381830050505118944950369775488975, 0.417959183673469387755102040816327};
+
+typedef double (*quad_fn)(double x);
+
+typedef struct {
+    const char *name;
+    quad_fn f;
+    double a, b;
+    double exact;
+    const char *description;
+} integrand;
+
+static double f_pi(double x) { return 4.0 / (1.0 + x * x); }
+static double f_sqrt(double x) { return sqrt(x); }
+static double f_log(double x) { return log(x); }
+static double f_peak(double x) { return 1.0 / ((x - 0.3) * (x - 0.3) + 1e-6); }
+static double f_osc(double x) { return sin(50.0 * x) * sin(50.0 * x); }
+
+static integrand integrands[] = {
+    {"pi", f_pi, 0.0, 1.0, M_PI, "4/(1+x^2) on [0,1]"},
+    {"sqrt", f_sqrt, 0.0, 1.0, 2.0 / 3.0, "sqrt(x) on [0,1], infinite slope at 0"},
+    {"log", f_log, 0.0, 1.0, -1.0, "log(x) on [0,1], singular at 0"},
+    {"peak", f_peak, 0.0, 1.0, 0.0, "1/((x-0.3)^2+1e-6) on [0,1], narrow peak"},
+    {"osc", f_osc, 0.0, 1.0, 0.0, "sin(50x)^2 on [0,1], oscillating"},
+};
+#define NUM_INTEGRANDS ((int)(sizeof(integrands) / sizeof(integrands[0])))
+
+// Per-thread results and counters, padded to avoid false sharing
+typedef struct {
+    double sum, comp;            // Neumaier-compensated sum of accepted intervals
+    long long evaluations;
+    long long intervals;         // Accepted intervals
+    long long tasks;             // Tasks created
+    char pad[64 - 2 * sizeof(double) - 3 * sizeof(long long)];
+} __attribute__((aligned(64))) quad_thread;
+
+typedef struct {
+    const integrand *in;
+    double tol_density;          // Tolerance per unit width
+    quad_thread *threads;
+} quad_problem;
+
+typedef struct {
+    double a, b;
+} interval;
+
+// 15-point Kronrod estimate of the integral over [a, b] and |K15 - G7|
+static void gauss_kronrod(quad_fn f, double a, double b, double *estimate, double *error) {
+    double centre = 0.5 * (a + b), half = 0.5 * (b - a);
+    double fc = f(centre);
+    double kronrod = fc * wgk[7], gauss = fc * wg[3];
+
+    for (int j = 0; j < 7; j++) {
+        double dx = half * xgk[j];
+        double pair = f(centre - dx) + f(centre + dx);
+        kronrod += wgk[j] * pair;
+        if (j & 1) {
+            gauss += wg[j / 2] * pair;
+        }
+    }
+    *estimate = kronrod * half;
+    *error = fabs((kronrod - gauss) * half);
+}
+
+static void accumulate(quad_thread *t, double x) {
+    double s = t->sum + x;
+    t->comp += fabs(t->sum) >= fabs(x) ? (t->sum - s) + x : (x - s) + t->sum;
+    t->sum = s;
+}
+
+/**
+ * Refine [a, b] depth-first on a task-local stack; when more than
+ * QUAD_SHARE intervals are pending the oldest is spawned as a task, and an
+ * interval that would overflow the stack is spawned instead of split
+ */
+static void adapt_task(const quad_problem *q, double a, double b) {
+    interval stack[QUAD_STACK];
+    int top = 0;
+    stack[top++] = (interval){a, b};
+
+    while (top > 0) {
+        quad_thread *t = &q->threads[omp_get_thread_num()];
+        interval iv = stack[--top];
+        double estimate, error;
+        gauss_kronrod(q->in->f, iv.a, iv.b, &estimate, &error);
+        t->evaluations += QUAD_POINTS;
+
+        double width = iv.b - iv.a;
+        if (error <= q->tol_density * width || width < QUAD_MIN_WIDTH) {
+            accumulate(t, estimate);
+            t->intervals++;
+            continue;
+        }
+        if (top + 2 > QUAD_STACK) {
+            t->tasks++;
+            #pragma omp task firstprivate(iv)
+            adapt_task(q, iv.a, iv.b);
+            continue;
+        }
+
+        double mid = 0.5 * (iv.a + iv.b);
+        stack[top++] = (interval){mid, iv.b};
+        stack[top++] = (interval){iv.a, mid};
+
+        if (top > QUAD_SHARE) {
+            interval give = stack[0];
+            memmove(stack, stack + 1, (top - 1) * sizeof(interval));
+            top--;
+            t->tasks++;
+            #pragma omp task firstprivate(give)
+            adapt_task(q, give.a, give.b);
+        }
+    }
+}
+
+typedef struct {
+    quad_problem problem;
+    int nthreads;
+} adaptive_ctx;
+
+static double integrate_adaptive(void *c) {
+    adaptive_ctx *x = (adaptive_ctx *)c;
+    quad_problem *q = &x->problem;
+    const integrand *in = q->in;
+    memset(q->threads, 0, sizeof(quad_thread) * x->nthreads);
+
+    #pragma omp parallel num_threads(x->nthreads)
+    #pragma omp single
+    {
+        // Equal initial pieces so every thread starts with work
+        int pieces = QUAD_INITIAL_PER_THREAD * x->nthreads;
+        double width = (in->b - in->a) / pieces;
+        for (int i = 0; i < pieces; i++) {
+            double a = in->a + i * width;
+            double b = i == pieces - 1 ? in->b : a + width;
+            q->threads[omp_get_thread_num()].tasks++;
+            #pragma omp task firstprivate(a, b)
+            adapt_task(q, a, b);
+        }
+    }
+
+    double sum = 0.0, comp = 0.0;
+    for (int i = 0; i < x->nthreads; i++) {
+        quad_thread tmp = {.sum = sum, .comp = comp};
+        accumulate(&tmp, q->threads[i].sum + q->threads[i].comp);
+        sum = tmp.sum;
+        comp = tmp.comp;
+    }
+    return sum + comp;
+}
+
+typedef struct {
+    const integrand *in;
+    long num_steps;
+} midpoint_ctx;
+
+/**
+ * Fixed-step midpoint rule as in piWithReduction.c; the pi integrand is
+ * written out so the baseline is the original loop, not an indirect call
+ */
+static double integrate_midpoint(void *c) {
+    midpoint_ctx *x = (midpoint_ctx *)c;
+    const integrand *in = x->in;
+    long num_steps = x->num_steps;
+    double step = (in->b - in->a) / (double)num_steps;
+    double sum = 0.0;
+
+    if (in->f == f_pi) {
+#pragma omp parallel for reduction(+ : sum)
+        for (long i = 0; i < num_steps; i++) {
+            double x = (i + 0.5) * step;
+            sum += 4.0 / (1.0 + x * x);
+        }
+    } else {
+#pragma omp parallel for reduction(+ : sum)
+        for (long i = 0; i < num_steps; i++) {
+            sum += in->f(in->a + (i + 0.5) * step);
+        }
+    }
+    return step * sum;
+}
+
+int main(int argc, char **argv) {
+    double tol = argc > 1 ? atof(argv[1]) : 1e-10;
+    const char *name = argc > 2 ? argv[2] : "pi";
+    int threads = argc > 3 ? atoi(argv[3]) : omp_get_max_threads();
+
+    integrand *in = NULL;
+    for (int i = 0; i < NUM_INTEGRANDS; i++) {
+        if (strcmp(integrands[i].name, name) == 0) {
+            in = &integrands[i];
+        }
+    }
+    if (in == NULL || !(tol > 0.0) || threads < 1) {
+        printf("Usage: %s [tolerance] [integrand] [threads]\n", argv[0]);
+        printf("Integrands:");
+        for (int i = 0; i < NUM_INTEGRANDS; i++) {
+            printf(" %s", integrands[i].name);
+        }
+        printf("\n");
+        return 1;
+    }
+    // Closed forms that are easier to write at run time
+    integrands[3].exact = (atan(0.7 / 1e-3) + atan(0.3 / 1e-3)) / 1e-3;
+    integrands[4].exact = 0.5 - sin(100.0) / 200.0;
+    omp_set_num_threads(threads);
+
+    adaptive_ctx actx;
+    actx.nthreads = threads;
+    actx.problem.in = in;
+    actx.problem.tol_density = tol / (in->b - in->a);
+    actx.problem.threads = aligned_alloc(64, sizeof(quad_thread) * threads);
+    if (actx.problem.threads == NULL) {
+        fprintf(stderr, "Error: Failed to allocate per-thread slots\n");
+        return 1;
+    }
+
+    // Before any output: in csv/json mode the records own stdout
+    bench_config cfg;
+    bench_init(&cfg, "adaptive_quad");
+    cfg.threads = threads;
+
+    printf("Integrating %s to a tolerance of %.1e using %d threads\n", in->description, tol, threads);
+
+    bench_result ar = bench_run(&cfg, "adaptive", integrate_adaptive, &actx, in->exact, tol);
+    long long evaluations = 0, intervals = 0, tasks = 0, most = 0;
+    for (int i = 0; i < threads; i++) {
+        quad_thread *t = &actx.problem.threads[i];
+        evaluations += t->evaluations;
+        intervals += t->intervals;
+        tasks += t->tasks;
+        most = t->evaluations > most ? t->evaluations : most;
+    }
+    double adaptive_error = fabs(ar.value - in->exact);
+
+    // Baseline: double the uniform step count until it is as accurate
+    double target = adaptive_error > tol ? adaptive_error : tol;
+    midpoint_ctx mctx = {in, BASELINE_MIN_STEPS};
+    double midpoint_error = INFINITY;
+    for (;;) {
+        midpoint_error = fabs(integrate_midpoint(&mctx) - in->exact);
+        if (midpoint_error <= target || mctx.num_steps * 2 > BASELINE_MAX_STEPS) {
+            break;
+        }
+        mctx.num_steps *= 2;
+    }
+    cfg.size = mctx.num_steps;
+    bench_result mr = bench_run(&cfg, "midpoint", integrate_midpoint, &mctx, in->exact, target);
+
+    printf("\n%-10s %16s %12s %12s\n", "Method", "Evaluations", "Time (s)", "Error");
+    printf("----------------------------------------------------\n");
+    printf("%-10s %16lld %12.6f %12.2e\n", "adaptive", evaluations, ar.median, adaptive_error);
+    printf("%-10s %16ld %12.6f %12.2e%s\n", "midpoint", mctx.num_steps, mr.median, midpoint_error,
+           midpoint_error <= target ? "" : "  (step limit, target not reached)");
+    printf("Adaptive: %lld intervals, %lld tasks, busiest thread %.1f%% of the evaluations\n", intervals,
+           tasks, 100.0 * most / evaluations);
+    if (midpoint_error <= target) {
+        printf("Midpoint needs %.1fx the evaluations and %.1fx the time for an error of %.1e\n",
+               (double)mctx.num_steps / evaluations, mr.median / ar.median, target);
+    } else {
+        printf("Midpoint stays at %.1e after %ld steps, %.1fx the time of the adaptive run\n",
+               midpoint_error, mctx.num_steps, mr.median / ar.median);
+    }
+
+    free(actx.problem.threads);
+    bench_finish(&cfg);
+    return cfg.failures != 0;
+}
@@ -0,0 +1,459 @@
+/*
+ * bench.h - Shared benchmark harness
+ *
+ * Every benchmark program registers its variants with bench_run(), which
+ * performs untimed warmup runs, times a number of repetitions, checks the
+ * result against a reference value and reports min/median/mean/stddev and
+ * a 95% confidence interval of the mean. Every record shows the check
+ * (ok/FAIL); cfg->failures counts the failed ones and programs exit
+ * nonzero when it is not 0.
+ *
+ * Configuration comes from the environment so the programs keep their
+ * positional command lines:
+ *   BENCH_WARMUP  untimed runs before measuring (default 1)
+ *   BENCH_REPS    timed repetitions (default 5)
+ *   BENCH_FORMAT  text | csv | json (default text)
+ *   BENCH_OUTPUT  file for the records (default stdout)
+ *   BENCH_APPEND  1: append to BENCH_OUTPUT and leave out the CSV header;
+ *                 set by programs that re-run themselves for their children
+ *
+ * In csv/json mode without BENCH_OUTPUT the records own stdout and the
+ * program's human-readable printf output is redirected to stderr, so
+ * "BENCH_FORMAT=csv ./count3s > results.csv" gives a clean CSV file.
+ * json mode writes one JSON object per line.
+ *
+ * Timed variants, sweep points and counter readings all go to the same
+ * output. In csv mode they share one header (BENCH_CSV_HEADER) whose
+ * first column, record, is run, sweep or counters; fields a record does
+ * not have are left empty. json objects carry the same "record" key.
+ *
+ * BENCH_COUNTERS=1 adds hardware counters around every timed region when
+ * the program attaches them (see perfcounters.h); the program declares
+ * the work of the next variant in cfg->work_ops and cfg->work_bytes.
+ *
+ * OpenMP programs also get bench_sweep(), an in-process scaling sweep over
+ * a thread list and a size list that reports strong- and weak-scaling
+ * speedup, parallel efficiency and the Karp-Flatt serial fraction.
+ *
+ * Checklist for a program using the harness:
+ *   - call bench_init before printing anything: earlier output lands in
+ *     front of the records; "BENCH_FORMAT=csv ./prog 2>/dev/null" must
+ *     print nothing but the header and records
+ *   - give bench_run a reference wherever the result is known
+ *   - exit nonzero when cfg.failures is not 0
+ *
+ * Header-only: include it and compile the program as before, plus -lm.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define BENCH_DEFAULT_WARMUP 1
+#define BENCH_DEFAULT_REPS 5
+#define BENCH_MAX_LIST 64
+
+enum { BENCH_TEXT, BENCH_CSV, BENCH_JSON };
+
+struct bench_config;
+
+// Hooks around the timed repetitions of bench_run (used by perfcounters.h)
+typedef void (*bench_region_begin_fn)(void *state);
+typedef void (*bench_region_end_fn)(void *state, struct bench_config *cfg, const char *name,
+                                    double seconds, int reps);
+
+typedef struct bench_config {
+    const char *program;
+    int warmup;
+    int reps;
+    int format;
+    FILE *out;          // Destination of the records
+    int header_done;    // BENCH_CSV_HEADER written
+    int threads;        // Reported with every record, set by the program
+    long long size;     // Problem size, set by the program
+    double work_ops;    // Operations per run of the next variant, 0 if unknown
+    double work_bytes;  // Bytes moved per run of the next variant, 0 if unknown
+    void *counters;     // State passed to the region hooks
+    bench_region_begin_fn counters_begin;
+    bench_region_end_fn counters_end;
+    int failures;       // Records whose check failed; programs exit nonzero on any
+} bench_config;
+
+typedef struct {
+    const char *name;
+    int runs;
+    double min, median, mean, stddev, ci95;  // Seconds
+    double value;       // Result of the last run
+    int checked;        // 1 when a reference value was given
+    int correct;
+} bench_result;
+
+// A benchmarked variant; returns its result so it can be checked
+typedef double (*bench_fn)(void *ctx);
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline int bench_env_int(const char *name, int fallback) {
+    const char *v = getenv(name);
+    return (v != NULL && *v != '\0') ? atoi(v) : fallback;
+}
+
+static inline void bench_init(bench_config *cfg, const char *program) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->program = program;
+    cfg->warmup = bench_env_int("BENCH_WARMUP", BENCH_DEFAULT_WARMUP);
+    cfg->reps = bench_env_int("BENCH_REPS", BENCH_DEFAULT_REPS);
+    if (cfg->warmup < 0) {
+        cfg->warmup = 0;
+    }
+    if (cfg->reps < 1) {
+        cfg->reps = 1;
+    }
+
+    const char *fmt = getenv("BENCH_FORMAT");
+    if (fmt != NULL && strcmp(fmt, "csv") == 0) {
+        cfg->format = BENCH_CSV;
+    } else if (fmt != NULL && strcmp(fmt, "json") == 0) {
+        cfg->format = BENCH_JSON;
+    } else {
+        cfg->format = BENCH_TEXT;
+    }
+
+    cfg->out = stdout;
+    const char *path = getenv("BENCH_OUTPUT");
+    if (path != NULL && *path != '\0') {
+        int append = bench_env_int("BENCH_APPEND", 0);
+        cfg->out = fopen(path, append ? "a" : "w");
+        cfg->header_done = append;
+        if (cfg->out == NULL) {
+            fprintf(stderr, "bench: cannot open BENCH_OUTPUT '%s', using stdout\n", path);
+            cfg->out = stdout;
+        }
+    }
+    if (cfg->format != BENCH_TEXT && cfg->out == stdout) {
+        // Keep stdout for the records, send everything else to stderr
+        fflush(stdout);
+        int fd = dup(STDOUT_FILENO);
+        FILE *records = fd >= 0 ? fdopen(fd, "w") : NULL;
+        if (records != NULL) {
+            cfg->out = records;
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+        }
+    }
+}
+
+static inline void bench_finish(bench_config *cfg) {
+    fflush(stdout);
+    if (cfg->out != stdout) {
+        fclose(cfg->out);
+        cfg->out = stdout;
+    }
+}
+
+#define BENCH_CSV_HEADER                                                               \
+    "record,program,variant,series,threads,size,runs,min_s,median_s,mean_s,stddev_s,"  \
+    "ci95_s,value,check,speedup,efficiency,karp_flatt,cycles,instructions,llc_misses,"  \
+    "branch_misses,ipc,nominal_gbs,dram_gbs,gops,ai_ops_per_byte,attainable_gops,"      \
+    "roofline_fraction\n"
+
+static inline void bench_csv_header(bench_config *cfg) {
+    if (!cfg->header_done) {
+        fputs(BENCH_CSV_HEADER, cfg->out);
+        cfg->header_done = 1;
+    }
+}
+
+static inline int bench_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Two-sided 95% Student t quantile for df degrees of freedom
+static inline double bench_t95(int df) {
+    static const double t[] = {0.0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+                               2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+                               2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069,
+                               2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (df < 1) {
+        return 0.0;
+    }
+    return df <= 30 ? t[df] : 1.960;
+}
+
+/*
+ * Summarize times[0..n) (sorted in place), check value against reference
+ * (skipped when reference is NAN; tolerance is absolute) and emit a record.
+ * Used directly for measurements that cannot be repeated, e.g. cold runs.
+ */
+static inline bench_result bench_report(bench_config *cfg, const char *name, double *times, int n,
+                                        double value, double reference, double tolerance) {
+    bench_result r;
+    memset(&r, 0, sizeof(r));
+    r.name = name;
+    r.runs = n;
+    r.value = value;
+
+    qsort(times, n, sizeof(double), bench_cmp_double);
+    r.min = times[0];
+    r.median = n % 2 ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+    for (int i = 0; i < n; i++) {
+        r.mean += times[i];
+    }
+    r.mean /= n;
+    if (n > 1) {
+        double ss = 0.0;
+        for (int i = 0; i < n; i++) {
+            ss += (times[i] - r.mean) * (times[i] - r.mean);
+        }
+        r.stddev = sqrt(ss / (n - 1));
+        r.ci95 = bench_t95(n - 1) * r.stddev / sqrt((double)n);
+    }
+    r.checked = !isnan(reference);
+    r.correct = !r.checked || fabs(value - reference) <= tolerance;
+    cfg->failures += !r.correct;
+
+    const char *check = r.checked ? (r.correct ? "ok" : "FAIL") : "none";
+    if (cfg->format == BENCH_CSV) {
+        bench_csv_header(cfg);
+        fprintf(cfg->out, "run,%s,%s,,%d,%lld,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%.17g,%s,,,,,,,,,,,,,,\n",
+                cfg->program, name, cfg->threads, cfg->size, n, r.min, r.median, r.mean,
+                r.stddev, r.ci95, value, check);
+    } else if (cfg->format == BENCH_JSON) {
+        fprintf(cfg->out, "{\"record\":\"run\",\"program\":\"%s\",\"variant\":\"%s\",\"threads\":%d,"
+                "\"size\":%lld,\"runs\":%d,\"min_s\":%.9f,\"median_s\":%.9f,\"mean_s\":%.9f,\"stddev_s\":%.9f,"
+                "\"ci95_s\":%.9f,\"value\":%.17g,\"check\":\"%s\"}\n",
+                cfg->program, name, cfg->threads, cfg->size, n, r.min, r.median, r.mean,
+                r.stddev, r.ci95, value, check);
+    } else {
+        fprintf(cfg->out, "   [%s] runs=%d min=%.6f median=%.6f mean=%.6f sd=%.6f ci95=+/-%.6f s%s%s\n",
+                name, n, r.min, r.median, r.mean, r.stddev, r.ci95, r.checked ? " check=" : "",
+                r.checked ? check : "");
+    }
+    fflush(cfg->out);
+    return r;
+}
+
+/*
+ * Run fn(ctx) cfg->warmup times untimed, then cfg->reps times timed into
+ * times[]; returns the result of the last run. With a name and attached
+ * counters the timed repetitions are wrapped by the counter hooks.
+ */
+static inline double bench_measure(bench_config *cfg, const char *name, bench_fn fn, void *ctx,
+                                   double *times) {
+    double value = 0.0;
+    int counted = name != NULL && cfg->counters_begin != NULL;
+
+    for (int i = 0; i < cfg->warmup; i++) {
+        value = fn(ctx);
+    }
+    if (counted) {
+        cfg->counters_begin(cfg->counters);
+    }
+    double total = 0.0;
+    for (int i = 0; i < cfg->reps; i++) {
+        double start = bench_now();
+        value = fn(ctx);
+        times[i] = bench_now() - start;
+        total += times[i];
+    }
+    if (counted) {
+        cfg->counters_end(cfg->counters, cfg, name, total, cfg->reps);
+    }
+    return value;
+}
+
+/*
+ * Measure fn(ctx) and report the result of the last run against
+ * reference (NAN: no check)
+ */
+static inline bench_result bench_run(bench_config *cfg, const char *name, bench_fn fn, void *ctx,
+                                     double reference, double tolerance) {
+    double *times = (double *)malloc(cfg->reps * sizeof(double));
+    double value = bench_measure(cfg, name, fn, ctx, times);
+    bench_result r = bench_report(cfg, name, times, cfg->reps, value, reference, tolerance);
+    free(times);
+    return r;
+}
+
+// Measure fn(ctx) and return only the median time, without emitting a record
+static inline double bench_median(bench_config *cfg, bench_fn fn, void *ctx) {
+    double *times = (double *)malloc(cfg->reps * sizeof(double));
+    int n = cfg->reps;
+
+    bench_measure(cfg, NULL, fn, ctx, times);
+    qsort(times, n, sizeof(double), bench_cmp_double);
+    double median = n % 2 ? times[n / 2] : 0.5 * (times[n / 2 - 1] + times[n / 2]);
+
+    free(times);
+    return median;
+}
+
+static inline int bench_cmp_ll(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Parse a comma-separated list such as "1,2,4,max" or "1e6,1e8" into
+ * values[], sorted ascending. "max" stands for max_value. Returns the
+ * number of entries, 0 on a malformed or empty list.
+ */
+static inline int bench_parse_list(const char *arg, long long *values, int max, long long max_value) {
+    int n = 0;
+    const char *p = arg;
+
+    while (*p != '\0' && n < max) {
+        char *end;
+        if (strncmp(p, "max", 3) == 0) {
+            values[n] = max_value;
+            end = (char *)p + 3;
+        } else {
+            values[n] = (long long)strtod(p, &end);
+        }
+        if (end == p || values[n] <= 0 || (*end != ',' && *end != '\0')) {
+            return 0;
+        }
+        n++;
+        p = *end == ',' ? end + 1 : end;
+    }
+    qsort(values, n, sizeof(long long), bench_cmp_ll);
+    return n;
+}
+
+#ifdef _OPENMP
+// Kernel of a sweep: run on a problem of the given size, return the result
+typedef double (*bench_sized_fn)(void *ctx, long long size);
+
+// Weak-scaling size for p of pmax threads when work grows linearly with size
+static inline long long bench_weak_linear(long long size, int p, int pmax) {
+    return size * p / pmax;
+}
+
+typedef struct {
+    bench_sized_fn fn;
+    void *ctx;
+    long long size;
+} bench_sized_call;
+
+static inline double bench_call_sized(void *c) {
+    bench_sized_call *x = (bench_sized_call *)c;
+    return x->fn(x->ctx, x->size);
+}
+
+/*
+ * Scaling sweep of one kernel. For every size in sizes[] two series run
+ * over threads[] (ascending):
+ *   strong: fixed total size
+ *   weak:   size scaled by weak_size(size, p, pmax), so per-thread work is
+ *           constant and the largest thread count solves the full size
+ * Speedup is taken against the first thread count (scaled to one thread if
+ * that is not 1); weak scaling reports scaled speedup p * T(p0) / T(p).
+ * The Karp-Flatt metric e = (1/S - 1/p) / (1 - 1/p) estimates the serial
+ * fraction. The caller owns data large enough for the largest size.
+ */
+static inline void bench_sweep(bench_config *cfg, const char *name, bench_sized_fn fn, void *ctx,
+                               const long long *threads, int nthreads, const long long *sizes, int nsizes,
+                               long long (*weak_size)(long long size, int p, int pmax)) {
+    int saved_threads = omp_get_max_threads();
+    int pmax = (int)threads[nthreads - 1];
+
+    for (int series = 0; series < 2; series++) {
+        const char *series_name = series == 0 ? "strong" : "weak";
+        for (int s = 0; s < nsizes; s++) {
+            double t0 = 0.0;
+            int p0 = (int)threads[0];
+
+            if (cfg->format == BENCH_TEXT) {
+                fprintf(cfg->out, "\n%s, %s scaling, size %lld\n", name, series_name, sizes[s]);
+                fprintf(cfg->out, "%8s %14s %12s %10s %11s %11s\n", "Threads", "Size", "Time (s)",
+                        "Speedup", "Efficiency", "Karp-Flatt");
+            } else if (cfg->format == BENCH_CSV) {
+                bench_csv_header(cfg);
+            }
+
+            for (int t = 0; t < nthreads; t++) {
+                int p = (int)threads[t];
+                bench_sized_call call = {fn, ctx, series == 0 ? sizes[s] : weak_size(sizes[s], p, pmax)};
+                if (call.size < 1) {
+                    call.size = 1;
+                }
+
+                omp_set_num_threads(p);
+                double time = bench_median(cfg, bench_call_sized, &call);
+                if (t == 0) {
+                    t0 = time;
+                }
+
+                double speedup = p0 * t0 / time;
+                if (series == 1) {
+                    speedup *= (double)p / p0;  // Scaled speedup
+                }
+                double efficiency = speedup / p;
+                double karp_flatt = p > 1 ? (1.0 / speedup - 1.0 / p) / (1.0 - 1.0 / p) : 0.0;
+
+                if (cfg->format == BENCH_TEXT) {
+                    fprintf(cfg->out, "%8d %14lld %12.6f %9.2fx %10.1f%% %11.4f\n", p, call.size, time,
+                            speedup, efficiency * 100, karp_flatt);
+                } else if (cfg->format == BENCH_CSV) {
+                    fprintf(cfg->out, "sweep,%s,%s,%s,%d,%lld,,,%.9f,,,,,,%.4f,%.4f,%.6f,,,,,,,,,,,\n",
+                            cfg->program, name,
+                            series_name, p, call.size, time, speedup, efficiency, karp_flatt);
+                } else {
+                    fprintf(cfg->out, "{\"record\":\"sweep\",\"program\":\"%s\",\"variant\":\"%s\","
+                            "\"series\":\"%s\",\"threads\":%d,\"size\":%lld,\"median_s\":%.9f,\"speedup\":%.4f,"
+                            "\"efficiency\":%.4f,\"karp_flatt\":%.6f}\n", cfg->program, name,
+                            series_name, p, call.size, time, speedup, efficiency, karp_flatt);
+                }
+                fflush(cfg->out);
+            }
+        }
+    }
+
+    omp_set_num_threads(saved_threads);
+}
+
+/*
+ * Parse "--sweep <threads> [sizes]" arguments. Thread counts default to
+ * 1,2,4,... up to the number of processors; sizes default to
+ * default_size. Returns 0 and prints a message on a malformed list.
+ */
+static inline int bench_parse_sweep(int argc, char **argv, int first, long long default_size,
+                                    long long *threads, int *nthreads, long long *sizes, int *nsizes) {
+    long long procs = omp_get_num_procs();
+    if (argc > first) {
+        *nthreads = bench_parse_list(argv[first], threads, BENCH_MAX_LIST, procs);
+    } else {
+        *nthreads = 0;
+        for (long long p = 1; p < procs && *nthreads < BENCH_MAX_LIST - 1; p *= 2) {
+            threads[(*nthreads)++] = p;
+        }
+        threads[(*nthreads)++] = procs;
+    }
+    if (argc > first + 1) {
+        *nsizes = bench_parse_list(argv[first + 1], sizes, BENCH_MAX_LIST, default_size);
+    } else {
+        sizes[0] = default_size;
+        *nsizes = 1;
+    }
+    if (*nthreads == 0 || *nsizes == 0) {
+        fprintf(stderr, "Error: --sweep expects comma-separated positive lists, e.g. 1,2,4,max 1e6,1e8\n");
+        return 0;
+    }
+    return 1;
+}
+#endif /* _OPENMP */
+
+#endif /* BENCH_H */
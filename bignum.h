@@ -0,0 +1,281 @@
+/*
+ * bignum.h - Unsigned arbitrary-precision integers for big Fibonacci numbers
+ *
+ * Numbers are little-endian arrays of 64-bit limbs; products of two limbs
+ * use unsigned __int128. Provided: add, subtract (a >= b), shift left by
+ * one, compare, multiply, remainder by a single limb and a log10 estimate.
+ *
+ * Multiplication is schoolbook up to BN_KARATSUBA_LIMBS limbs and
+ * Karatsuba above, splitting each operand into halves and forming three
+ * half-size products:
+ *   z0 = a0 b0,  z2 = a1 b1,  z1 = (a0 + a1)(b0 + b1) - z0 - z2
+ * Inside an OpenMP parallel region the three products become tasks while
+ * the operands have at least BN_TASK_LIMBS limbs. Below that each product
+ * recurses serially in one scratch buffer allocated up front, so the
+ * serial recursion never calls malloc.
+ *
+ * Header-only, no dependencies beyond libc (and OpenMP for the tasks).
+ */
+
+#ifndef BIGNUM_H
+#define BIGNUM_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BN_KARATSUBA_LIMBS 32
+#define BN_TASK_LIMBS 2048
+
+typedef unsigned __int128 bn_dlimb;
+
+typedef struct {
+    uint64_t *limb;
+    size_t len;      // Limbs in use, no leading zero limbs; 0 means zero
+    size_t cap;
+} bignum;
+
+static inline void bn_init(bignum *a) {
+    a->limb = NULL;
+    a->len = 0;
+    a->cap = 0;
+}
+
+static inline void bn_free(bignum *a) {
+    free(a->limb);
+    bn_init(a);
+}
+
+static inline void bn_reserve(bignum *a, size_t cap) {
+    if (cap > a->cap) {
+        a->limb = (uint64_t *)realloc(a->limb, cap * sizeof(uint64_t));
+        a->cap = cap;
+    }
+}
+
+static inline void bn_normalize(bignum *a) {
+    while (a->len > 0 && a->limb[a->len - 1] == 0) {
+        a->len--;
+    }
+}
+
+static inline void bn_set_u64(bignum *a, uint64_t v) {
+    bn_reserve(a, 1);
+    a->limb[0] = v;
+    a->len = v != 0;
+}
+
+static inline void bn_copy(bignum *r, const bignum *a) {
+    bn_reserve(r, a->len);
+    memcpy(r->limb, a->limb, a->len * sizeof(uint64_t));
+    r->len = a->len;
+}
+
+static inline int bn_cmp(const bignum *a, const bignum *b) {
+    if (a->len != b->len) {
+        return a->len < b->len ? -1 : 1;
+    }
+    for (size_t i = a->len; i-- > 0;) {
+        if (a->limb[i] != b->limb[i]) {
+            return a->limb[i] < b->limb[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// r = a + b; r may alias a or b
+static inline void bn_add(bignum *r, const bignum *a, const bignum *b) {
+    if (a->len < b->len) {
+        const bignum *t = a;
+        a = b;
+        b = t;
+    }
+    size_t alen = a->len, blen = b->len;
+    bn_reserve(r, alen + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < alen; i++) {
+        bn_dlimb s = (bn_dlimb)a->limb[i] + (i < blen ? b->limb[i] : 0) + carry;
+        r->limb[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+    r->limb[alen] = carry;
+    r->len = alen + 1;
+    bn_normalize(r);
+}
+
+// r = a - b for a >= b; r may alias a or b
+static inline void bn_sub(bignum *r, const bignum *a, const bignum *b) {
+    size_t alen = a->len, blen = b->len;
+    bn_reserve(r, alen);
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < alen; i++) {
+        uint64_t bi = i < blen ? b->limb[i] : 0;
+        uint64_t d = a->limb[i] - bi - borrow;
+        borrow = (a->limb[i] < bi) || (a->limb[i] - bi < borrow);
+        r->limb[i] = d;
+    }
+    r->len = alen;
+    bn_normalize(r);
+}
+
+// r = 2a; r may alias a
+static inline void bn_shl1(bignum *r, const bignum *a) {
+    size_t len = a->len;
+    bn_reserve(r, len + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint64_t v = a->limb[i];
+        r->limb[i] = (v << 1) | carry;
+        carry = v >> 63;
+    }
+    r->limb[len] = carry;
+    r->len = len + 1;
+    bn_normalize(r);
+}
+
+/* Limb-array kernels; r never aliases the inputs */
+
+// r[0..2n) = a[0..n) * b[0..n)
+static inline void bn_mul_schoolbook(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n) {
+    memset(r, 0, 2 * n * sizeof(uint64_t));
+    for (size_t i = 0; i < n; i++) {
+        uint64_t carry = 0, ai = a[i];
+        for (size_t j = 0; j < n; j++) {
+            bn_dlimb p = (bn_dlimb)ai * b[j] + r[i + j] + carry;
+            r[i + j] = (uint64_t)p;
+            carry = (uint64_t)(p >> 64);
+        }
+        r[i + n] = carry;
+    }
+}
+
+// r[0..n] = a[0..n) + b[0..m), m <= n; returns nothing, top limb holds the carry
+static inline void bn_add_limbs(uint64_t *r, const uint64_t *a, size_t n, const uint64_t *b, size_t m) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n; i++) {
+        bn_dlimb s = (bn_dlimb)a[i] + (i < m ? b[i] : 0) + carry;
+        r[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+    r[n] = carry;
+}
+
+// a[0..n) -= b[0..m), m <= n, result known to be non-negative
+static inline void bn_sub_in_place(uint64_t *a, size_t n, const uint64_t *b, size_t m) {
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < n && (i < m || borrow); i++) {
+        uint64_t bi = i < m ? b[i] : 0;
+        uint64_t d = a[i] - bi - borrow;
+        borrow = (a[i] < bi) || (a[i] - bi < borrow);
+        a[i] = d;
+    }
+}
+
+// a[0..n) += b[0..m), carry propagated within a
+static inline void bn_add_in_place(uint64_t *a, size_t n, const uint64_t *b, size_t m) {
+    uint64_t carry = 0;
+    for (size_t i = 0; i < n && (i < m || carry); i++) {
+        bn_dlimb s = (bn_dlimb)a[i] + (i < m ? b[i] : 0) + carry;
+        a[i] = (uint64_t)s;
+        carry = (uint64_t)(s >> 64);
+    }
+}
+
+// Scratch limbs the serial Karatsuba needs for n-limb operands
+static inline size_t bn_karatsuba_scratch(size_t n) {
+    size_t total = 0;
+    while (n > BN_KARATSUBA_LIMBS) {
+        size_t h = n - n / 2;
+        total += 4 * (h + 1);   // a0 + a1, b0 + b1 and their product
+        n = h + 1;
+    }
+    return total;
+}
+
+/*
+ * r[0..2n) = a[0..n) * b[0..n) with scratch of bn_karatsuba_scratch(n)
+ * limbs; spawns tasks for the three products while n >= BN_TASK_LIMBS
+ * (each task then allocates its own scratch)
+ */
+static void bn_mul_karatsuba(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n, uint64_t *scratch) {
+    if (n <= BN_KARATSUBA_LIMBS) {
+        bn_mul_schoolbook(r, a, b, n);
+        return;
+    }
+    size_t m = n / 2, h = n - m;
+    uint64_t *sa = scratch, *sb = scratch + (h + 1), *z1 = scratch + 2 * (h + 1);
+    uint64_t *rest = scratch + 4 * (h + 1);
+
+    bn_add_limbs(sa, a + m, h, a, m);
+    bn_add_limbs(sb, b + m, h, b, m);
+
+    if (n >= BN_TASK_LIMBS) {
+        #pragma omp task
+        {
+            uint64_t *s = (uint64_t *)malloc((bn_karatsuba_scratch(m) + 1) * sizeof(uint64_t));
+            bn_mul_karatsuba(r, a, b, m, s);
+            free(s);
+        }
+        #pragma omp task
+        {
+            uint64_t *s = (uint64_t *)malloc((bn_karatsuba_scratch(h) + 1) * sizeof(uint64_t));
+            bn_mul_karatsuba(r + 2 * m, a + m, b + m, h, s);
+            free(s);
+        }
+        bn_mul_karatsuba(z1, sa, sb, h + 1, rest);
+        #pragma omp taskwait
+    } else {
+        bn_mul_karatsuba(r, a, b, m, rest);
+        bn_mul_karatsuba(r + 2 * m, a + m, b + m, h, rest);
+        bn_mul_karatsuba(z1, sa, sb, h + 1, rest);
+    }
+
+    // z1 -= z0 + z2, then r += z1 * B^m
+    bn_sub_in_place(z1, 2 * (h + 1), r, 2 * m);
+    bn_sub_in_place(z1, 2 * (h + 1), r + 2 * m, 2 * h);
+    bn_add_in_place(r + m, 2 * n - m, z1, 2 * (h + 1) < 2 * n - m ? 2 * (h + 1) : 2 * n - m);
+}
+
+// r = a * b; r must not alias a or b
+static inline void bn_mul(bignum *r, const bignum *a, const bignum *b) {
+    if (a->len == 0 || b->len == 0) {
+        r->len = 0;
+        return;
+    }
+    size_t n = a->len > b->len ? a->len : b->len;
+    // Zero-extend the shorter operand; fast doubling multiplies near-equal sizes
+    uint64_t *buf = (uint64_t *)calloc(2 * n + bn_karatsuba_scratch(n) + 1, sizeof(uint64_t));
+    uint64_t *pa = buf, *pb = buf + n;
+    memcpy(pa, a->limb, a->len * sizeof(uint64_t));
+    memcpy(pb, b->limb, b->len * sizeof(uint64_t));
+
+    bn_reserve(r, 2 * n);
+    bn_mul_karatsuba(r->limb, pa, pb, n, buf + 2 * n);
+    r->len = a->len + b->len;
+    bn_normalize(r);
+    free(buf);
+}
+
+// a mod m for a single-limb m > 0
+static inline uint64_t bn_mod_u64(const bignum *a, uint64_t m) {
+    bn_dlimb rem = 0;
+    for (size_t i = a->len; i-- > 0;) {
+        rem = ((rem << 64) | a->limb[i]) % m;
+    }
+    return (uint64_t)rem;
+}
+
+// log10(a) from the top two limbs, accurate to about 1e-15 relative; -inf for zero
+static inline double bn_log10(const bignum *a) {
+    if (a->len == 0) {
+        return -INFINITY;
+    }
+    double top = (double)a->limb[a->len - 1];
+    if (a->len > 1) {
+        top += (double)a->limb[a->len - 2] * 0x1.0p-64;
+    }
+    return log10(top) + 64.0 * (a->len - 1) * log10(2.0);
+}
+
+#endif /* BIGNUM_H */
@@ -1,20 +1,32 @@
+/*
+ * Compile: gcc -fopenmp -O2 blockpi.c -o blockpi -lm
+ * Run: ./blockpi [num_steps] [threads]
+ * Midpoint-rule pi, one contiguous block of steps per thread, summed through
+ * a per-thread partial array.
+ * Sweep: ./blockpi --sweep [thread_list] [step_list]   (e.g. 1,2,4,max 1e8,1e9)
+ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <string.h>
 #include <omp.h>
+#include "bench.h"
+#include "perfcounters.h"
+#include "pikernel.h"
 
 static long num_steps = 1000000;
 double step;
 
-int main()
-{
-    double pi = 0.0;
-    step = 1.0 / (double)num_steps;
+typedef struct {
+    double *partial;
+    int rcp;
+} pi_ctx;
 
-    double start_time = omp_get_wtime();
+static double compute_pi_scalar(void *ctx)
+{
+    double *partial = ((pi_ctx *)ctx)->partial;
     int threads_env = omp_get_max_threads();
 
-    double *partial = malloc(sizeof(double) * threads_env);
-
     #pragma omp parallel
     {
         int threadId = omp_get_thread_num();
@@ -39,12 +51,92 @@ int main()
     for (int i = 0; i < threads_env; i++)
         sum += partial[i];
 
-    pi = step * sum;
+    return step * sum;
+}
+
+static double compute_pi(void *ctx)
+{
+    double *partial = ((pi_ctx *)ctx)->partial;
+    int rcp = ((pi_ctx *)ctx)->rcp;
+    int threads_env = omp_get_max_threads();
+
+    #pragma omp parallel
+    {
+        int threadId = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+
+        long chunk = num_steps / nthreads;
+        long start = threadId * chunk;
+        long end = (threadId == nthreads - 1) ? num_steps : start + chunk;
+
+        partial[threadId] = pi_midpoint_sum(start, end - start, 1, step, rcp);
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < threads_env; i++)
+        sum += partial[i];
+
+    return step * sum;
+}
+
+static double compute_pi_steps(void *ctx, long long steps)
+{
+    num_steps = steps;
+    step = 1.0 / (double)num_steps;
+    return compute_pi(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--sweep") != 0) {
+        num_steps = (long)atof(argv[1]);
+        if (argc > 2)
+            omp_set_num_threads(atoi(argv[2]));
+        if (num_steps < 1) {
+            printf("Usage: %s [num_steps] [threads]\n", argv[0]);
+            return 1;
+        }
+    }
+    step = 1.0 / (double)num_steps;
+
+    int threads_env = omp_get_max_threads();
+    bench_config cfg;
+    bench_init(&cfg, "blockpi");
+    cfg.threads = threads_env;
+    cfg.size = num_steps;
+
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+        long long threads[BENCH_MAX_LIST], sizes[BENCH_MAX_LIST];
+        int nthreads, nsizes;
+        if (!bench_parse_sweep(argc, argv, 2, num_steps, threads, &nthreads, sizes, &nsizes))
+            return 1;
+        int sweep_threads = (int)threads[nthreads - 1];
+        if (sweep_threads < omp_get_max_threads())
+            sweep_threads = omp_get_max_threads();
+        pi_ctx sweep_ctx = {malloc(sizeof(double) * sweep_threads), 0};
+        bench_sweep(&cfg, "block simd", compute_pi_steps, &sweep_ctx, threads, nthreads, sizes, nsizes, bench_weak_linear);
+        free(sweep_ctx.partial);
+        bench_finish(&cfg);
+        return 0;
+    }
+
+    pi_ctx ctx = {malloc(sizeof(double) * threads_env), 0};
+
+    perf_counters pc;
+    perf_attach(&cfg, &pc);
+    cfg.work_ops = PI_OPS_PER_STEP * num_steps;
+    bench_result s = bench_run(&cfg, "block", compute_pi_scalar, &ctx, M_PI, 1e-10);
+    bench_result r = bench_run(&cfg, "block simd", compute_pi, &ctx, M_PI, 1e-10);
+    ctx.rcp = 1;
+    bench_result q = bench_run(&cfg, "block simd rcp", compute_pi, &ctx, M_PI, 1e-10);
+    perf_detach(&pc);
 
-    printf("Approximation of Pi: %.10f\n", pi);
+    printf("Approximation of Pi: %.10f\n", r.value);
     printf("Threads used: %d\n", threads_env);
-    printf("Time taken: %f seconds\n", omp_get_wtime() - start_time);
+    printf("Time taken: %f seconds (scalar %f, reciprocal %f)\n", r.median, s.median, q.median);
+    printf("SIMD speedup over scalar: %.2fx, %.2fx with reciprocal\n", s.median / r.median, s.median / q.median);
 
-    free(partial);
-    return 0;
+    free(ctx.partial);
+    bench_finish(&cfg);
+    return cfg.failures != 0;
 }
@@ -0,0 +1,276 @@
+/*
+ * bufalloc.h - Page-size and NUMA-aware allocation of benchmark buffers
+ *
+ * buf_alloc() maps a buffer with mmap, aligned to 2 MB (so also to cache
+ * lines), picks the page size, sets the NUMA policy of the range and
+ * first-touches it before returning, so page placement no longer depends
+ * on whichever loop happens to write the data first:
+ *   pages  small      4 KB pages, transparent huge pages refused
+ *          thp        madvise(MADV_HUGEPAGE) on the 2 MB-aligned range
+ *          hugetlb    MAP_HUGETLB from the reserved pool
+ *                     (/proc/sys/vm/nr_hugepages), falling back to thp
+ *   numa   serial     one thread touches everything, the way a serial
+ *                     initialization loop places all pages on one node
+ *          local      parallel first touch, each page lands on the node
+ *                     of the thread that will use it
+ *          interleave pages round-robin over all nodes (mbind)
+ *
+ * The parallel touch gives every thread the same contiguous range of
+ * elements that schedule(static) gives it in the compute loop (the first
+ * n % p threads get one element more), so loops over the buffer with that
+ * schedule and the same thread count stay on local memory. With huge
+ * pages the page at a range boundary goes to the first of the two threads.
+ *
+ * Policies come from the environment for programs that just want a good
+ * default (buf_policy_from_env):
+ *   BUF_PAGES  small | thp | hugetlb (default thp)
+ *   BUF_NUMA   serial | local | interleave (default local)
+ *
+ * buf_inspect() reports what the kernel actually did: bytes backed by huge
+ * pages (from /proc/self/smaps) and pages per node (move_pages on a sample
+ * of pages). The NUMA calls go through raw syscalls, so no -lnuma is
+ * needed; where they are not permitted the policy falls back to the
+ * kernel default and info->numa_ok is 0.
+ *
+ * Usage: int *a = buf_alloc(n * sizeof(int), sizeof(int), buf_policy_from_env(), NULL);
+ *        ... buf_free(a, n * sizeof(int));
+ */
+
+#ifndef BUFALLOC_H
+#define BUFALLOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define BUF_HUGE_PAGE (2UL << 20)
+#define BUF_MAX_NODES 64
+#define BUF_SAMPLE_PAGES 4096   // Pages queried per buf_inspect
+#define BUF_MPOL_INTERLEAVE 3   // From <numaif.h>
+#define BUF_MPOL_LOCAL 4
+
+enum { BUF_PAGES_SMALL, BUF_PAGES_THP, BUF_PAGES_HUGETLB };
+enum { BUF_NUMA_SERIAL, BUF_NUMA_LOCAL, BUF_NUMA_INTERLEAVE };
+
+typedef struct {
+    int pages;
+    int numa;
+} buf_policy;
+
+typedef struct {
+    int hugetlb;                      // MAP_HUGETLB succeeded
+    int numa_ok;                      // mbind accepted the policy (always 1 for serial)
+    double touch_seconds;             // Mapping plus first touch
+} buf_info;
+
+typedef struct {
+    size_t huge_bytes;                // Backed by transparent or hugetlb pages
+    int nodes;                        // Nodes online
+    long node_pages[BUF_MAX_NODES];   // Sampled pages per node
+    long sampled;                     // Pages with a known node
+} buf_stats;
+
+static const char *buf_pages_names[] = {"small", "thp", "hugetlb"};
+static const char *buf_numa_names[] = {"serial", "local", "interleave"};
+
+static inline size_t buf_round_huge(size_t bytes) {
+    return (bytes + BUF_HUGE_PAGE - 1) & ~(BUF_HUGE_PAGE - 1);
+}
+
+/* Number of online NUMA nodes (highest online node + 1), 1 without sysfs */
+static inline int buf_numa_nodes(void) {
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    int nodes = 1;
+    if (f != NULL) {
+        char line[256];
+        if (fgets(line, sizeof(line), f) != NULL) {
+            // e.g. "0", "0-1" or "0,2-3": the last number is the highest node
+            char *p = line + strlen(line);
+            while (p > line && (p[-1] < '0' || p[-1] > '9')) {
+                p--;
+            }
+            while (p > line && p[-1] >= '0' && p[-1] <= '9') {
+                p--;
+            }
+            nodes = atoi(p) + 1;
+        }
+        fclose(f);
+    }
+    return nodes < 1 ? 1 : (nodes > BUF_MAX_NODES ? BUF_MAX_NODES : nodes);
+}
+
+static inline int buf_lookup(const char *value, const char **names, int count, int fallback) {
+    for (int i = 0; value != NULL && i < count; i++) {
+        if (strcmp(value, names[i]) == 0) {
+            return i;
+        }
+    }
+    if (value != NULL) {
+        fprintf(stderr, "bufalloc: unknown setting '%s', using %s\n", value, names[fallback]);
+    }
+    return fallback;
+}
+
+static inline buf_policy buf_policy_from_env(void) {
+    buf_policy policy;
+    policy.pages = buf_lookup(getenv("BUF_PAGES"), buf_pages_names, 3, BUF_PAGES_THP);
+    policy.numa = buf_lookup(getenv("BUF_NUMA"), buf_numa_names, 3, BUF_NUMA_LOCAL);
+    return policy;
+}
+
+/* "pages/numa", e.g. "thp/local" */
+static inline const char *buf_policy_name(buf_policy policy, char *buf, size_t len) {
+    snprintf(buf, len, "%s/%s", buf_pages_names[policy.pages], buf_numa_names[policy.numa]);
+    return buf;
+}
+
+/*
+ * Zero elements [lo, hi) of thread tid's schedule(static) share of n
+ * elements among nthreads
+ */
+static inline void buf_touch_share(char *base, size_t n, size_t elem_size, int tid, int nthreads) {
+    size_t q = n / nthreads, r = n % nthreads;
+    size_t lo = tid * q + ((size_t)tid < r ? (size_t)tid : r);
+    size_t hi = lo + q + ((size_t)tid < r);
+    memset(base + lo * elem_size, 0, (hi - lo) * elem_size);
+}
+
+/*
+ * Allocate bytes (zeroed) with the given policy; elem_size is the element
+ * size of the compute loop whose schedule(static) the first touch follows.
+ * info may be NULL. Returns NULL on failure; release with buf_free.
+ */
+static inline void *buf_alloc(size_t bytes, size_t elem_size, buf_policy policy, buf_info *info) {
+    size_t len = buf_round_huge(bytes > 0 ? bytes : 1);
+    char *p = MAP_FAILED;
+    buf_info local = {0, 1, 0.0};
+    double start = omp_get_wtime();
+
+    if (policy.pages == BUF_PAGES_HUGETLB) {
+        p = (char *)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        local.hugetlb = p != MAP_FAILED;
+    }
+    if (p == MAP_FAILED) {
+        // Over-map by one huge page and trim to a 2 MB-aligned range
+        char *raw = (char *)mmap(NULL, len + BUF_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return NULL;
+        }
+        p = (char *)(((uintptr_t)raw + BUF_HUGE_PAGE - 1) & ~(uintptr_t)(BUF_HUGE_PAGE - 1));
+        if (p > raw) {
+            munmap(raw, p - raw);
+        }
+        munmap(p + len, raw + BUF_HUGE_PAGE - p);
+        madvise(p, len, policy.pages == BUF_PAGES_SMALL ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+    }
+
+    if (policy.numa != BUF_NUMA_SERIAL) {
+        unsigned long mask[BUF_MAX_NODES / (8 * sizeof(unsigned long))] = {0};
+        int mode = BUF_MPOL_LOCAL;
+        if (policy.numa == BUF_NUMA_INTERLEAVE) {
+            int nodes = buf_numa_nodes();
+            for (int node = 0; node < nodes; node++) {
+                mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+            }
+            mode = BUF_MPOL_INTERLEAVE;
+        }
+        local.numa_ok = syscall(SYS_mbind, p, len, mode, mode == BUF_MPOL_LOCAL ? NULL : mask,
+                                mode == BUF_MPOL_LOCAL ? 0UL : (unsigned long)BUF_MAX_NODES + 1, 0) == 0;
+    }
+
+    if (elem_size == 0 || bytes % elem_size != 0) {
+        elem_size = 1;
+    }
+    if (policy.numa == BUF_NUMA_SERIAL) {
+        memset(p, 0, bytes);
+    } else {
+#pragma omp parallel
+        buf_touch_share(p, bytes / elem_size, elem_size, omp_get_thread_num(), omp_get_num_threads());
+    }
+
+    local.touch_seconds = omp_get_wtime() - start;
+    if (info != NULL) {
+        *info = local;
+    }
+    return p;
+}
+
+static inline void buf_free(void *p, size_t bytes) {
+    if (p != NULL) {
+        munmap(p, buf_round_huge(bytes > 0 ? bytes : 1));
+    }
+}
+
+/*
+ * Huge-page coverage and node placement of [p, p + bytes); the buffer
+ * must have been touched
+ */
+static inline buf_stats buf_inspect(void *p, size_t bytes) {
+    buf_stats stats;
+    memset(&stats, 0, sizeof(stats));
+    stats.nodes = buf_numa_nodes();
+
+    // Sum AnonHugePages and *_Hugetlb of the mappings that overlap the buffer
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (f != NULL) {
+        char line[256];
+        int inside = 0;
+        uintptr_t lo = (uintptr_t)p, hi = lo + bytes;
+        while (fgets(line, sizeof(line), f) != NULL) {
+            unsigned long start, end, kb;
+            if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+                inside = start < hi && end > lo;
+            } else if (inside && (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1 ||
+                                  sscanf(line, "Private_Hugetlb: %lu kB", &kb) == 1 ||
+                                  sscanf(line, "Shared_Hugetlb: %lu kB", &kb) == 1)) {
+                stats.huge_bytes += kb << 10;
+            }
+        }
+        fclose(f);
+    }
+    if (stats.huge_bytes > bytes) {
+        stats.huge_bytes = bytes;   // The mapping is rounded up to whole huge pages
+    }
+
+    // move_pages without target nodes only reports where each page is
+    long page = sysconf(_SC_PAGESIZE);
+    long npages = (long)((bytes + page - 1) / page);
+    long samples = npages < BUF_SAMPLE_PAGES ? npages : BUF_SAMPLE_PAGES;
+    void *pages[BUF_SAMPLE_PAGES];
+    int status[BUF_SAMPLE_PAGES];
+    for (long s = 0; s < samples; s++) {
+        pages[s] = (char *)p + (npages * s / samples) * page;
+    }
+    if (samples > 0 && syscall(SYS_move_pages, 0, samples, pages, NULL, status, 0) == 0) {
+        for (long s = 0; s < samples; s++) {
+            if (status[s] >= 0 && status[s] < BUF_MAX_NODES) {
+                stats.node_pages[status[s]]++;
+                stats.sampled++;
+            }
+        }
+    }
+    return stats;
+}
+
+/* Placement as text, e.g. "n0 50% n1 50%", or "n/a" if unknown */
+static inline const char *buf_nodes_text(const buf_stats *stats, char *buf, size_t len) {
+    size_t pos = 0;
+    buf[0] = '\0';
+    if (stats->sampled == 0) {
+        snprintf(buf, len, "n/a");
+        return buf;
+    }
+    for (int node = 0; node < stats->nodes && pos < len; node++) {
+        pos += snprintf(buf + pos, len - pos, "%sn%d %.0f%%", node ? " " : "", node,
+                        100.0 * stats->node_pages[node] / stats->sampled);
+    }
+    return buf;
+}
+
+#endif
@@ -11,35 +11,221 @@
  * 4. Parallel with atomic operations
  * 5. Parallel with reduction clause
  * 6. Parallel with private counters (manual reduction)
+ * 7. Explicit SIMD kernel (SSE2/AVX2/AVX-512, picked at startup from cpuid)
+ * 8. Explicit SIMD kernel combined with OpenMP threading
+ * 9. Full histogram of all values 0-9 in a single pass, compared with
+ *    one counting pass per value
+ * 10. Compact storage layouts (uint8, 4-bit nibbles, per-value bitmaps)
+ *    encoded from the int array and counted in their compressed form
+ * 11. Pattern search (--pattern): count and locate multi-element needles
+ *    with a SIMD first/last-element filter, correct across the OpenMP
+ *    chunk boundaries, plus a one-pass scan for many needles at once,
+ *    against a naive per-position comparison loop
+ * 12. Range-count index (--range): block prefix counts built in parallel
+ *    for O(1) "3s in [l, r)" queries, a Fenwick tree for data with point
+ *    updates, and sorted query batches, against rescanning each range
+ * 13. Allocation policies (--alloc): the array in 4 KB, transparent and
+ *    hugetlb pages with serial, parallel (local) or interleaved first
+ *    touch (bufalloc.h), timed on a streaming count and a random gather
+ * 14. Counter contention suite (--contention): critical, atomic, reduction,
+ *    packed and cache-line padded private counters, thread-local counters
+ *    with one final atomic and sharded atomic counters, over densities of
+ *    3s from 0% to 100% and a list of thread counts
  * 
- * Compile: gcc -fopenmp -O2 count3s.c -o count3s
- * Run: count3s.exe [array_size] [num_threads]
+ * File mode counts raw int32 or uint8 records straight from disk, either
+ * through mmap or through double-buffered chunked reads, for data sets
+ * larger than RAM. --write produces such a file from the generator.
+ * 
+ * Every variant is timed through the shared harness in bench.h (warmup,
+ * repetitions, median/stddev/CI, CSV or JSON records via BENCH_FORMAT);
+ * BENCH_COUNTERS=1 adds hardware counters and the roofline position.
+ * 
+ * Compile: gcc -fopenmp -O2 count3s.c -o count3s -lm
+ * Run: count3s.exe [array_size] [num_threads] [density_of_3s]
+ *      count3s.exe --file <path> [int32|uint8] [num_threads]
+ *      count3s.exe --write <path> [int32|uint8] [array_size] [density_of_3s]
+ *      count3s.exe --sweep [thread_list] [size_list] [density_of_3s]
+ *      count3s.exe --pattern [needles] [array_size] [num_threads] [density_of_3s]
+ *        (needles: elements by commas, needles by slashes, e.g. 3,3/1,2,3)
+ *      count3s.exe --range [array_size] [num_threads] [num_queries] [density_of_3s]
+ *      count3s.exe --alloc [array_size] [num_threads] [density_of_3s]
+ *      count3s.exe --contention [thread_list] [density_list] [array_size]
+ *        (e.g. 1,2,4,max 0,0.01,0.1,1 1e7)
+ *    BUF_PAGES=small|thp|hugetlb and BUF_NUMA=serial|local|interleave pick
+ *    the policy of the main array (default thp/local, see bufalloc.h)
+ * 
+ * Sweep mode initializes the largest array once and runs strong- and
+ * weak-scaling series over the thread and size lists (e.g. 1,2,4,max 1e7,1e8).
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "perfcounters.h"
+#include "bufalloc.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
 
 // Default values
 #define DEFAULT_ARRAY_SIZE 100000000
 #define DEFAULT_NUM_THREADS 4
-#define NUM_RUNS 5  // Number of runs for averaging
+#define DEFAULT_DENSITY 0.1  // Fraction of elements equal to 3 (uniform 0-9)
+#define DATA_SEED 42ULL
+#define SIMD_BLOCK (1LL << 24)  // Elements per block before 32-bit lane counters are flushed
+#define STREAM_CHUNK (64LL << 20)  // Bytes per read buffer in streaming file mode
+#define MMAP_PREFETCH (8LL << 20)  // Bytes each thread asks the kernel to read ahead
+#define HIST_BINS 10    // Alphabet size for the histogram variant (values 0-9)
+#define HIST_COPIES 4   // Sub-histograms per thread, must match the unroll in histogram_parallel
+#define PATTERN_MAX_LEN 16
+#define PATTERN_MAX_NEEDLES 64
+#define PATTERN_HASH_BITS 12    // Buckets of the multi-needle table
+#define PATTERN_BUCKETS (1 << PATTERN_HASH_BITS)
+#define PATTERN_CHECK_SIZE 4099   // Array of the chunk-boundary check (odd on purpose)
+#define PATTERN_CHECK_PARTS 64
+#define PATTERN_DEFAULT_NEEDLES "3,3/1,2,3/3,3,3,3/3,1,4,1,5,9,2,6"
+#define RANGE_BLOCK 128   // Elements per prefix entry of the range index (512 bytes)
+#define ALLOC_GATHERS (1LL << 24)   // Random reads per gather run of the allocation mode
+#define COUNTER_LINE 64      // Cache line size for padded counters
+#define COUNTER_SHARDS 4     // Shards of the sharded counter in the contention suite
+#define CONTENTION_SIZE 10000000LL
+#define RANGE_RADIX_BITS 11   // Digit of the radix sort of batched query endpoints
+#define RANGE_BATCH_MAX_SIZE (1LL << 32)      // Batched positions fit the upper 32 key bits
+#define RANGE_BATCH_MAX_QUERIES (1LL << 31)   // and the 2 nq endpoint numbers the lower 32
+#define RANGE_DEFAULT_QUERIES 1000000
+#define RANGE_RESCAN_QUERIES 100   // Queries timed with a rescan (each reads ~1/3 of the array)
+
+// Vectorized counting kernel: number of elements equal to value in arr[0..n)
+typedef long long (*count_kernel_fn)(const int *arr, long long n, int value);
+typedef long long (*count_bytes_fn)(const uint8_t *arr, long long n, int value);
+// Pattern kernel: matches of needle[0..m) starting in [first, last), see variant 11
+typedef long long (*pattern_kernel_fn)(const int *arr, long long first, long long last, const int *needle,
+                                       int m, long long *first_pos, long long *last_pos);
 
 // Function prototypes
-void initialize_array(int *arr, long long size);
+void initialize_array(int *arr, long long size, double density);
+void initialize_range(int *arr, long long first, long long count, double density);
 long long count3s_sequential(int *arr, long long size);
 long long count3s_parallel_race(int *arr, long long size);
 long long count3s_parallel_critical(int *arr, long long size);
 long long count3s_parallel_atomic(int *arr, long long size);
 long long count3s_parallel_reduction(int *arr, long long size);
 long long count3s_parallel_private(int *arr, long long size);
-void run_benchmark(int *arr, long long size, int num_threads);
-double get_average_time(double *times, int num_runs);
+long long count3s_simd(int *arr, long long size);
+long long count3s_parallel_simd(int *arr, long long size);
+const char *select_count_kernel(void);
+long long count_records_parallel(const void *data, long long n, int record_size, int value);
+int histogram_parallel(int *arr, long long size, int nbins, long long *hist);
+void histogram_by_passes(int *arr, long long size, int nbins, long long *hist);
+void encode_uint8(int *arr, long long size, uint8_t *out);
+void encode_nibbles(int *arr, long long size, uint8_t *out);
+void encode_bitmaps(int *arr, long long size, uint64_t **bitmaps);
+long long count_uint8_parallel(uint8_t *data, long long size, int value);
+long long count_nibbles_parallel(uint8_t *data, long long size, int value);
+long long count_bitmap_parallel(uint64_t *bitmap, long long size);
+int write_data_file(const char *path, int record_size, long long size, double density);
+int run_file_benchmark(bench_config *cfg, const char *path, int record_size, int num_threads);
+void run_benchmark(bench_config *cfg, int *arr, long long size, int num_threads);
+int run_sweep(bench_config *cfg, int argc, char *argv[]);
+long long pattern_count_parallel(int *arr, long long size, const int *needle, int m, int parts,
+                                 long long *first_pos, long long *last_pos);
+long long pattern_count_naive(int *arr, long long size, const int *needle, int m, int threads,
+                              long long *first_pos, long long *last_pos);
+int run_pattern(bench_config *cfg, int argc, char *argv[]);
+int run_range(bench_config *cfg, int argc, char *argv[]);
+int run_alloc(bench_config *cfg, int argc, char *argv[]);
+int run_contention(bench_config *cfg, int argc, char *argv[]);
 
 int main(int argc, char *argv[]) {
     long long array_size = DEFAULT_ARRAY_SIZE;
     int num_threads = DEFAULT_NUM_THREADS;
+    double density = DEFAULT_DENSITY;
+    bench_config cfg;
+    perf_counters pc;
+    
+    // File modes: count3s --file <path> [format] [threads], --write <path> [format] [size] [density]
+    if (argc > 2 && (strcmp(argv[1], "--file") == 0 || strcmp(argv[1], "--write") == 0)) {
+        int record_size = 4;
+        if (argc > 3) {
+            if (strcmp(argv[3], "uint8") == 0) {
+                record_size = 1;
+            } else if (strcmp(argv[3], "int32") != 0) {
+                fprintf(stderr, "Error: Unknown record format '%s' (use int32 or uint8)\n", argv[3]);
+                return 1;
+            }
+        }
+        select_count_kernel();
+        if (strcmp(argv[1], "--write") == 0) {
+            if (argc > 4) {
+                array_size = atoll(argv[4]);
+            }
+            if (argc > 5) {
+                density = atof(argv[5]);
+            }
+            return write_data_file(argv[2], record_size, array_size, density);
+        }
+        if (argc > 4) {
+            num_threads = atoi(argv[4]);
+        }
+        omp_set_num_threads(num_threads);
+        bench_init(&cfg, "count3s-file");
+        cfg.threads = num_threads;
+        perf_attach(&cfg, &pc);
+        int status = run_file_benchmark(&cfg, argv[2], record_size, num_threads);
+        perf_detach(&pc);
+        bench_finish(&cfg);
+        return status;
+    }
+    
+    if (argc > 1 && strcmp(argv[1], "--pattern") == 0) {
+        bench_init(&cfg, "count3s-pattern");
+        int status = run_pattern(&cfg, argc, argv);
+        bench_finish(&cfg);
+        return status;
+    }
+    
+    if (argc > 1 && strcmp(argv[1], "--range") == 0) {
+        bench_init(&cfg, "count3s-range");
+        int status = run_range(&cfg, argc, argv);
+        bench_finish(&cfg);
+        return status;
+    }
+    
+    if (argc > 1 && strcmp(argv[1], "--alloc") == 0) {
+        bench_init(&cfg, "count3s-alloc");
+        perf_attach(&cfg, &pc);
+        int status = run_alloc(&cfg, argc, argv);
+        perf_detach(&pc);
+        bench_finish(&cfg);
+        return status;
+    }
+    
+    if (argc > 1 && strcmp(argv[1], "--contention") == 0) {
+        bench_init(&cfg, "count3s-contention");
+        perf_attach(&cfg, &pc);
+        int status = run_contention(&cfg, argc, argv);
+        perf_detach(&pc);
+        bench_finish(&cfg);
+        return status;
+    }
+    
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+        select_count_kernel();
+        bench_init(&cfg, "count3s-sweep");
+        int status = run_sweep(&cfg, argc, argv);
+        bench_finish(&cfg);
+        return status;
+    }
     
     // Parse command line arguments
     if (argc > 1) {
@@ -48,62 +234,98 @@ int main(int argc, char *argv[]) {
     if (argc > 2) {
         num_threads = atoi(argv[2]);
     }
+    if (argc > 3) {
+        density = atof(argv[3]);
+    }
+    if (array_size <= 0 || num_threads <= 0 || density < 0.0 || density > 1.0) {
+        fprintf(stderr, "Usage: %s [array_size] [num_threads] [density_of_3s (0-1)]\n", argv[0]);
+        return 1;
+    }
+    
+    bench_init(&cfg, "count3s");
+    cfg.threads = num_threads;
+    cfg.size = array_size;
     
     printf("=======================================================\n");
     printf("Count3s - Parallel Programming Performance Analysis\n");
     printf("=======================================================\n");
     printf("Array size: %lld elements\n", array_size);
     printf("Number of threads: %d\n", num_threads);
-    printf("Number of runs per variant: %d\n", NUM_RUNS);
+    printf("Density of 3s: %.4f\n", density);
+    printf("Number of runs per variant: %d (+%d warmup)\n", cfg.reps, cfg.warmup);
+    printf("SIMD kernel: %s\n", select_count_kernel());
     printf("=======================================================\n\n");
     
-    // Allocate and initialize array
-    printf("Allocating and initializing array...\n");
-    int *arr = (int *)malloc(array_size * sizeof(int));
+    // Set number of threads
+    omp_set_num_threads(num_threads);
+    
+    // Allocate (pages placed by the BUF_PAGES/BUF_NUMA policy) and initialize array
+    char policy_name[48];
+    buf_policy policy = buf_policy_from_env();
+    printf("Allocating and initializing array (%s pages)...\n", buf_policy_name(policy, policy_name,
+                                                                             sizeof(policy_name)));
+    double init_start = omp_get_wtime();
+    int *arr = (int *)buf_alloc(array_size * sizeof(int), sizeof(int), policy, NULL);
     if (arr == NULL) {
         fprintf(stderr, "Error: Failed to allocate memory for array\n");
         return 1;
     }
-    
-    initialize_array(arr, array_size);
-    printf("Array initialized successfully.\n\n");
-    
-    // Set number of threads
-    omp_set_num_threads(num_threads);
+    initialize_array(arr, array_size, density);
+    printf("Array initialized successfully in %.6f seconds.\n\n", omp_get_wtime() - init_start);
     
     // Run benchmarks
-    run_benchmark(arr, array_size, num_threads);
+    perf_attach(&cfg, &pc);
+    run_benchmark(&cfg, arr, array_size, num_threads);
+    perf_detach(&pc);
     
     // Cleanup
-    free(arr);
+    buf_free(arr, array_size * sizeof(int));
     
     printf("\n=======================================================\n");
     printf("Benchmark completed successfully!\n");
     printf("=======================================================\n");
+    bench_finish(&cfg);
     
-    return 0;
+    return cfg.failures != 0;
+}
+
+/**
+ * SplitMix64 finalizer: a counter-based generator, the value for element i
+ * depends only on (seed, i), so no state is shared between threads
+ */
+static inline uint64_t splitmix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
 }
 
 /**
  * Initialize array with random values (0-9)
- * Expected count of 3s: approximately array_size / 10
+ * Each element is 3 with probability density, otherwise uniform over the
+ * other nine digits; density 0.1 gives uniform 0-9.
+ * Expected count of 3s: approximately array_size * density
+ * The contents are bit-identical for any number of threads.
+ */
+void initialize_array(int *arr, long long size, double density) {
+    initialize_range(arr, 0, size, density);
+}
+
+/**
+ * Fill arr[0..count) with elements first..first+count-1 of the sequence
+ * generated by initialize_array, so large data sets can be produced in chunks
  */
-void initialize_array(int *arr, long long size) {
-    // Use a fixed seed for reproducibility
-    srand(42);
+void initialize_range(int *arr, long long first, long long count, double density) {
+    // Threshold on the upper 32 random bits; density 1.0 must always hit
+    uint64_t threshold = (uint64_t)(density * 4294967296.0);
+    uint64_t key = splitmix64(DATA_SEED);
     
-    #pragma omp parallel
-    {
-        // Each thread uses a different seed based on thread ID
-        int tid = omp_get_thread_num();
-        unsigned int seed = 42 + tid * 1000;
-        
-        #pragma omp for
-        for (long long i = 0; i < size; i++) {
-            // Use rand() with thread-local manipulation for Windows compatibility
-            int local_rand = rand() + tid;
-            arr[i] = (local_rand % 10);  // Values from 0 to 9
-        }
+    #pragma omp parallel for simd schedule(static)
+    for (long long i = 0; i < count; i++) {
+        uint64_t r = splitmix64(key + (uint64_t)(first + i));
+        uint32_t other = (uint32_t)(((r & 0xFFFFFFFFULL) * 9) >> 32);  // 0-8
+        int value = (int)other + (other >= 3);                           // skips 3
+        arr[i] = (r >> 32) < threshold ? 3 : value;
     }
 }
 
@@ -222,189 +444,2326 @@ long long count3s_parallel_private(int *arr, long long size) {
 }
 
 /**
- * Calculate average time from multiple runs
+ * Scalar counting kernel, used when no SIMD extension is available
  */
-double get_average_time(double *times, int num_runs) {
-    double sum = 0.0;
-    for (int i = 0; i < num_runs; i++) {
-        sum += times[i];
+static long long count_value_scalar(const int *arr, long long n, int value) {
+    long long c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    long long i = 0;
+    
+    for (; i + 4 <= n; i += 4) {
+        c0 += arr[i] == value;
+        c1 += arr[i + 1] == value;
+        c2 += arr[i + 2] == value;
+        c3 += arr[i + 3] == value;
     }
-    return sum / num_runs;
+    for (; i < n; i++) {
+        c0 += arr[i] == value;
+    }
+    
+    return c0 + c1 + c2 + c3;
 }
 
 /**
- * Run all variants and measure performance
+ * Scalar byte kernel: 8-bit match counters are flushed every 255 elements
+ * so the inner loop stays narrow and auto-vectorizes
  */
-void run_benchmark(int *arr, long long size, int num_threads) {
-    double times[NUM_RUNS];
-    double start_time, end_time;
-    long long result;
-    long long correct_count = 0;
+static long long count_bytes_scalar(const uint8_t *arr, long long n, int value) {
+    long long count = 0;
+    long long i = 0;
     
-    printf("-------------------------------------------------------\n");
-    printf("Running benchmarks...\n");
-    printf("-------------------------------------------------------\n\n");
+    while (i < n) {
+        long long end = i + 255 < n ? i + 255 : n;
+        uint8_t c = 0;
+        for (; i < end; i++) {
+            c += arr[i] == value;
+        }
+        count += c;
+    }
     
-    // ===== VARIANT 1: Sequential =====
-    printf("1. SEQUENTIAL VERSION (Baseline)\n");
-    for (int run = 0; run < NUM_RUNS; run++) {
-        start_time = omp_get_wtime();
-        result = count3s_sequential(arr, size);
-        end_time = omp_get_wtime();
-        times[run] = end_time - start_time;
+    return count;
+}
+
+#ifdef HAVE_X86_SIMD
+/**
+ * SSE2 kernel: compare 4 ints at a time; a match gives an all-ones lane (-1),
+ * so subtracting the mask increments the lane counter. Four independent
+ * accumulators hide the compare/subtract latency.
+ */
+__attribute__((target("sse2")))
+static long long count_value_sse2(const int *arr, long long n, int value) {
+    const __m128i v = _mm_set1_epi32(value);
+    long long count = 0;
+    long long i = 0;
+    
+    while (i + 16 <= n) {
+        long long end = i + SIMD_BLOCK < n ? i + SIMD_BLOCK : n;
+        __m128i a0 = _mm_setzero_si128(), a1 = _mm_setzero_si128();
+        __m128i a2 = _mm_setzero_si128(), a3 = _mm_setzero_si128();
         
-        if (run == 0) {
-            correct_count = result;  // Use as reference
-            printf("   Count of 3s: %lld\n", result);
+        for (; i + 16 <= end; i += 16) {
+            a0 = _mm_sub_epi32(a0, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + i)), v));
+            a1 = _mm_sub_epi32(a1, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + i + 4)), v));
+            a2 = _mm_sub_epi32(a2, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + i + 8)), v));
+            a3 = _mm_sub_epi32(a3, _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(arr + i + 12)), v));
         }
+        
+        int lanes[4];
+        __m128i sum = _mm_add_epi32(_mm_add_epi32(a0, a1), _mm_add_epi32(a2, a3));
+        _mm_storeu_si128((__m128i *)lanes, sum);
+        count += (long long)lanes[0] + lanes[1] + lanes[2] + lanes[3];
     }
-    double seq_time = get_average_time(times, NUM_RUNS);
-    printf("   Average time: %.6f seconds\n", seq_time);
-    printf("   Speedup: 1.00x (baseline)\n\n");
     
-    // ===== VARIANT 2: Parallel with Race Condition =====
-    printf("2. PARALLEL WITH RACE CONDITION (INCORRECT!)\n");
-    printf("   WARNING: This version demonstrates the race condition problem\n");
-    for (int run = 0; run < NUM_RUNS; run++) {
-        start_time = omp_get_wtime();
-        result = count3s_parallel_race(arr, size);
-        end_time = omp_get_wtime();
-        times[run] = end_time - start_time;
+    return count + count_value_scalar(arr + i, n - i, value);
+}
+
+/**
+ * AVX2 kernel: same scheme as SSE2 with 8 ints per vector
+ */
+__attribute__((target("avx2")))
+static long long count_value_avx2(const int *arr, long long n, int value) {
+    const __m256i v = _mm256_set1_epi32(value);
+    long long count = 0;
+    long long i = 0;
+    
+    while (i + 32 <= n) {
+        long long end = i + SIMD_BLOCK < n ? i + SIMD_BLOCK : n;
+        __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
+        __m256i a2 = _mm256_setzero_si256(), a3 = _mm256_setzero_si256();
         
-        if (run == 0) {
-            printf("   Count of 3s: %lld (Correct: %lld) - ", result, correct_count);
-            if (result == correct_count) {
-                printf("Correct (by chance)\n");
-            } else {
-                printf("INCORRECT! (Error: %lld)\n", correct_count - result);
-            }
+        for (; i + 32 <= end; i += 32) {
+            a0 = _mm256_sub_epi32(a0, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + i)), v));
+            a1 = _mm256_sub_epi32(a1, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + i + 8)), v));
+            a2 = _mm256_sub_epi32(a2, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + i + 16)), v));
+            a3 = _mm256_sub_epi32(a3, _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(arr + i + 24)), v));
+        }
+        
+        int lanes[8];
+        __m256i sum = _mm256_add_epi32(_mm256_add_epi32(a0, a1), _mm256_add_epi32(a2, a3));
+        _mm256_storeu_si256((__m256i *)lanes, sum);
+        for (int l = 0; l < 8; l++) {
+            count += lanes[l];
         }
     }
-    double race_time = get_average_time(times, NUM_RUNS);
-    printf("   Average time: %.6f seconds\n", race_time);
-    printf("   Speedup: %.2fx\n", seq_time / race_time);
-    printf("   Note: Result is unreliable due to race condition!\n\n");
     
-    // ===== VARIANT 3: Parallel with Critical Section =====
-    printf("3. PARALLEL WITH CRITICAL SECTION\n");
-    for (int run = 0; run < NUM_RUNS; run++) {
-        start_time = omp_get_wtime();
-        result = count3s_parallel_critical(arr, size);
-        end_time = omp_get_wtime();
-        times[run] = end_time - start_time;
+    return count + count_value_scalar(arr + i, n - i, value);
+}
+
+/**
+ * AVX-512 kernel: compares produce a 16-bit mask register, which is
+ * accumulated with popcount into four independent scalar counters
+ */
+__attribute__((target("avx512f,popcnt")))
+static long long count_value_avx512(const int *arr, long long n, int value) {
+    const __m512i v = _mm512_set1_epi32(value);
+    long long c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    long long i = 0;
+    
+    for (; i + 64 <= n; i += 64) {
+        c0 += _mm_popcnt_u32(_mm512_cmpeq_epi32_mask(_mm512_loadu_si512(arr + i), v));
+        c1 += _mm_popcnt_u32(_mm512_cmpeq_epi32_mask(_mm512_loadu_si512(arr + i + 16), v));
+        c2 += _mm_popcnt_u32(_mm512_cmpeq_epi32_mask(_mm512_loadu_si512(arr + i + 32), v));
+        c3 += _mm_popcnt_u32(_mm512_cmpeq_epi32_mask(_mm512_loadu_si512(arr + i + 48), v));
+    }
+    
+    return c0 + c1 + c2 + c3 + count_value_scalar(arr + i, n - i, value);
+}
+
+/**
+ * AVX2 byte kernel: byte lanes count up to 255 matches, then they are
+ * widened with a sum of absolute differences against zero
+ */
+__attribute__((target("avx2")))
+static long long count_bytes_avx2(const uint8_t *arr, long long n, int value) {
+    const __m256i v = _mm256_set1_epi8((char)value);
+    __m256i total = _mm256_setzero_si256();
+    long long i = 0;
+    
+    while (i + 64 <= n) {
+        long long end = i + 127 * 64 < n ? i + 127 * 64 : n;
+        __m256i a0 = _mm256_setzero_si256(), a1 = _mm256_setzero_si256();
         
-        if (run == 0) {
-            printf("   Count of 3s: %lld ", result);
-            printf(result == correct_count ? "(Correct)\n" : "(INCORRECT!)\n");
+        for (; i + 64 <= end; i += 64) {
+            a0 = _mm256_sub_epi8(a0, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(arr + i)), v));
+            a1 = _mm256_sub_epi8(a1, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(arr + i + 32)), v));
         }
+        
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(a0, a1), _mm256_setzero_si256()));
     }
-    double critical_time = get_average_time(times, NUM_RUNS);
-    printf("   Average time: %.6f seconds\n", critical_time);
-    printf("   Speedup: %.2fx\n", seq_time / critical_time);
-    printf("   Efficiency: %.2f%%\n", (seq_time / critical_time) / num_threads * 100);
-    printf("   Note: Critical section creates bottleneck\n\n");
     
-    // ===== VARIANT 4: Parallel with Atomic =====
-    printf("4. PARALLEL WITH ATOMIC OPERATIONS\n");
-    for (int run = 0; run < NUM_RUNS; run++) {
-        start_time = omp_get_wtime();
-        result = count3s_parallel_atomic(arr, size);
-        end_time = omp_get_wtime();
-        times[run] = end_time - start_time;
-        
-        if (run == 0) {
-            printf("   Count of 3s: %lld ", result);
-            printf(result == correct_count ? "(Correct)\n" : "(INCORRECT!)\n");
+    long long lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + count_bytes_scalar(arr + i, n - i, value);
+}
+
+/**
+ * AVX-512BW byte kernel: 64 compares per instruction into a mask register
+ */
+__attribute__((target("avx512f,avx512bw,popcnt")))
+static long long count_bytes_avx512(const uint8_t *arr, long long n, int value) {
+    const __m512i v = _mm512_set1_epi8((char)value);
+    long long c0 = 0, c1 = 0;
+    long long i = 0;
+    
+    for (; i + 128 <= n; i += 128) {
+        c0 += _mm_popcnt_u64(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(arr + i), v));
+        c1 += _mm_popcnt_u64(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(arr + i + 64), v));
+    }
+    
+    return c0 + c1 + count_bytes_scalar(arr + i, n - i, value);
+}
+#endif
+
+/**
+ * Pattern search (variant 11)
+ * 
+ * Counts occurrences of a needle of m <= PATTERN_MAX_LEN ints, overlapping
+ * ones included, and locates the first and last. A position i can only
+ * match when arr[i] equals the first and arr[i + m - 1] the last needle
+ * element, so the SIMD kernels compare a vector of first candidates and a
+ * vector of last candidates, AND the two masks and verify only the
+ * surviving positions against the middle of the needle.
+ * 
+ * Kernels count the matches that START in [first, last), where
+ * last <= size - m + 1; a match may read up to m - 1 elements past last.
+ * The parallel driver splits the start positions (not the elements) into
+ * parts, so a match that straddles a chunk boundary is read across it and
+ * counted exactly once, by the part holding its start.
+ */
+static long long pattern_scalar(const int *arr, long long first, long long last, const int *needle,
+                                int m, long long *first_pos, long long *last_pos) {
+    long long count = 0;
+    
+    for (long long i = first; i < last; i++) {
+        if (arr[i] == needle[0] && arr[i + m - 1] == needle[m - 1] &&
+            (m <= 2 || memcmp(arr + i + 1, needle + 1, (m - 2) * sizeof(int)) == 0)) {
+            if (*first_pos < 0) {
+                *first_pos = i;
+            }
+            *last_pos = i;
+            count++;
         }
     }
-    double atomic_time = get_average_time(times, NUM_RUNS);
-    printf("   Average time: %.6f seconds\n", atomic_time);
-    printf("   Speedup: %.2fx\n", seq_time / atomic_time);
-    printf("   Efficiency: %.2f%%\n", (seq_time / atomic_time) / num_threads * 100);
-    printf("   Note: Better than critical, but still has overhead\n\n");
     
-    // ===== VARIANT 5: Parallel with Reduction =====
-    printf("5. PARALLEL WITH REDUCTION CLAUSE (BEST)\n");
-    for (int run = 0; run < NUM_RUNS; run++) {
-        start_time = omp_get_wtime();
-        result = count3s_parallel_reduction(arr, size);
-        end_time = omp_get_wtime();
-        times[run] = end_time - start_time;
-        
-        if (run == 0) {
-            printf("   Count of 3s: %lld ", result);
-            printf(result == correct_count ? "(Correct)\n" : "(INCORRECT!)\n");
+    return count;
+}
+
+#ifdef HAVE_X86_SIMD
+/**
+ * AVX2 first/last filter: 8 candidate positions per step, candidates
+ * extracted from the combined mask with count-trailing-zeros
+ */
+__attribute__((target("avx2")))
+static long long pattern_avx2(const int *arr, long long first, long long last, const int *needle,
+                              int m, long long *first_pos, long long *last_pos) {
+    const __m256i vf = _mm256_set1_epi32(needle[0]);
+    const __m256i vl = _mm256_set1_epi32(needle[m - 1]);
+    long long count = 0;
+    long long i = first;
+    
+    for (; i + 8 <= last; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(arr + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(arr + i + m - 1));
+        __m256i eq = _mm256_and_si256(_mm256_cmpeq_epi32(a, vf), _mm256_cmpeq_epi32(b, vl));
+        unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        while (mask) {
+            long long p = i + __builtin_ctz(mask);
+            if (m <= 2 || memcmp(arr + p + 1, needle + 1, (m - 2) * sizeof(int)) == 0) {
+                if (*first_pos < 0) {
+                    *first_pos = p;
+                }
+                *last_pos = p;
+                count++;
+            }
+            mask &= mask - 1;
         }
     }
-    double reduction_time = get_average_time(times, NUM_RUNS);
-    printf("   Average time: %.6f seconds\n", reduction_time);
-    printf("   Speedup: %.2fx\n", seq_time / reduction_time);
-    printf("   Efficiency: %.2f%%\n", (seq_time / reduction_time) / num_threads * 100);
-    printf("   Note: Optimal approach with minimal overhead\n\n");
     
-    // ===== VARIANT 6: Parallel with Private Counters =====
-    printf("6. PARALLEL WITH PRIVATE COUNTERS (Manual Reduction)\n");
-    for (int run = 0; run < NUM_RUNS; run++) {
-        start_time = omp_get_wtime();
-        result = count3s_parallel_private(arr, size);
-        end_time = omp_get_wtime();
-        times[run] = end_time - start_time;
+    return count + pattern_scalar(arr, i, last, needle, m, first_pos, last_pos);
+}
+
+/**
+ * AVX-512 first/last filter: 16 candidate positions per step, the two
+ * compares produce mask registers that are ANDed directly
+ */
+__attribute__((target("avx512f")))
+static long long pattern_avx512(const int *arr, long long first, long long last, const int *needle,
+                                int m, long long *first_pos, long long *last_pos) {
+    const __m512i vf = _mm512_set1_epi32(needle[0]);
+    const __m512i vl = _mm512_set1_epi32(needle[m - 1]);
+    long long count = 0;
+    long long i = first;
+    
+    for (; i + 16 <= last; i += 16) {
+        unsigned int mask = _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(arr + i), vf) &
+                            _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(arr + i + m - 1), vl);
+        while (mask) {
+            long long p = i + __builtin_ctz(mask);
+            if (m <= 2 || memcmp(arr + p + 1, needle + 1, (m - 2) * sizeof(int)) == 0) {
+                if (*first_pos < 0) {
+                    *first_pos = p;
+                }
+                *last_pos = p;
+                count++;
+            }
+            mask &= mask - 1;
+        }
+    }
+    
+    return count + pattern_scalar(arr, i, last, needle, m, first_pos, last_pos);
+}
+#endif
+
+// Kernel selected at startup by select_count_kernel()
+static count_kernel_fn count_kernel = count_value_scalar;
+static count_bytes_fn count_bytes_kernel = count_bytes_scalar;
+static pattern_kernel_fn pattern_kernel = pattern_scalar;
+
+/**
+ * Pick the widest counting kernel the CPU supports (cpuid via GCC builtins)
+ * Returns the name of the selected instruction set
+ */
+const char *select_count_kernel(void) {
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt")) {
+        count_kernel = count_value_avx512;
+        count_bytes_kernel = __builtin_cpu_supports("avx512bw") ? count_bytes_avx512 : count_bytes_avx2;
+        pattern_kernel = pattern_avx512;
+        return "AVX-512";
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        count_kernel = count_value_avx2;
+        count_bytes_kernel = count_bytes_avx2;
+        pattern_kernel = pattern_avx2;
+        return "AVX2";
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        count_kernel = count_value_sse2;
+        count_bytes_kernel = count_bytes_scalar;
+        pattern_kernel = pattern_scalar;
+        return "SSE2";
+    }
+#endif
+    count_kernel = count_value_scalar;
+    count_bytes_kernel = count_bytes_scalar;
+    pattern_kernel = pattern_scalar;
+    return "scalar";
+}
+
+/**
+ * Variant 7: Explicit SIMD kernel, single thread
+ */
+long long count3s_simd(int *arr, long long size) {
+    return count_kernel(arr, size, 3);
+}
+
+/**
+ * Variant 8: Explicit SIMD kernel with OpenMP threading
+ * Each thread runs the vector kernel over one contiguous block
+ */
+long long count3s_parallel_simd(int *arr, long long size) {
+    long long count = 0;
+    
+    #pragma omp parallel reduction(+:count)
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        long long chunk = size / nthreads;
+        long long start = tid * chunk;
+        long long end = (tid == nthreads - 1) ? size : start + chunk;
         
-        if (run == 0) {
-            printf("   Count of 3s: %lld ", result);
-            printf(result == correct_count ? "(Correct)\n" : "(INCORRECT!)\n");
+        count += count_kernel(arr + start, end - start, 3);
+    }
+    
+    return count;
+}
+
+/**
+ * Count records equal to value in parallel; record_size is 4 (int32) or 1 (uint8)
+ */
+long long count_records_parallel(const void *data, long long n, int record_size, int value) {
+    long long count = 0;
+    
+    #pragma omp parallel reduction(+:count)
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        long long chunk = n / nthreads;
+        long long start = tid * chunk;
+        long long end = (tid == nthreads - 1) ? n : start + chunk;
+        
+        if (record_size == 1) {
+            count += count_bytes_kernel((const uint8_t *)data + start, end - start, value);
+        } else {
+            count += count_kernel((const int *)data + start, end - start, value);
         }
     }
-    double private_time = get_average_time(times, NUM_RUNS);
-    printf("   Average time: %.6f seconds\n", private_time);
-    printf("   Speedup: %.2fx\n", seq_time / private_time);
-    printf("   Efficiency: %.2f%%\n", (seq_time / private_time) / num_threads * 100);
-    printf("   Note: Similar to reduction but manual implementation\n\n");
     
-    // ===== SUMMARY TABLE =====
-    printf("-------------------------------------------------------\n");
-    printf("PERFORMANCE SUMMARY\n");
-    printf("-------------------------------------------------------\n");
-    printf("%-25s %12s %10s %10s\n", "Variant", "Time (s)", "Speedup", "Efficiency");
-    printf("-------------------------------------------------------\n");
-    printf("%-25s %12.6f %10.2fx %9.1f%%\n", "Sequential", seq_time, 1.0, 100.0);
-    printf("%-25s %12.6f %10.2fx %9.1f%%\n", "Race Condition", race_time, 
-           seq_time / race_time, (seq_time / race_time) / num_threads * 100);
-    printf("%-25s %12.6f %10.2fx %9.1f%%\n", "Critical Section", critical_time, 
-           seq_time / critical_time, (seq_time / critical_time) / num_threads * 100);
-    printf("%-25s %12.6f %10.2fx %9.1f%%\n", "Atomic", atomic_time, 
-           seq_time / atomic_time, (seq_time / atomic_time) / num_threads * 100);
-    printf("%-25s %12.6f %10.2fx %9.1f%%\n", "Reduction", reduction_time, 
-           seq_time / reduction_time, (seq_time / reduction_time) / num_threads * 100);
-    printf("%-25s %12.6f %10.2fx %9.1f%%\n", "Private Counters", private_time, 
-           seq_time / private_time, (seq_time / private_time) / num_threads * 100);
-    printf("-------------------------------------------------------\n");
+    return count;
+}
+
+/**
+ * Write size generated records to path, produced in chunks so the file
+ * may be larger than RAM
+ */
+int write_data_file(const char *path, int record_size, long long size, double density) {
+    if (size <= 0 || density < 0.0 || density > 1.0) {
+        fprintf(stderr, "Error: Invalid array size or density\n");
+        return 1;
+    }
     
-    // ===== ANALYSIS =====
-    printf("\nANALYSIS:\n");
-    printf("-------------------------------------------------------\n");
-    printf("Best performing variant: ");
-    double best_time = reduction_time;
-    const char *best_name = "Reduction";
+    FILE *f = fopen(path, "wb");
+    long long chunk = STREAM_CHUNK / sizeof(int);
+    int *buf = (int *)malloc(chunk * sizeof(int));
+    if (f == NULL || buf == NULL) {
+        fprintf(stderr, "Error: Cannot open '%s' or allocate the write buffer\n", path);
+        return 1;
+    }
     
-    if (private_time < best_time) {
-        best_time = private_time;
-        best_name = "Private Counters";
+    double start_time = omp_get_wtime();
+    for (long long first = 0; first < size; first += chunk) {
+        long long n = size - first < chunk ? size - first : chunk;
+        initialize_range(buf, first, n, density);
+        if (record_size == 1) {
+            uint8_t *bytes = (uint8_t *)buf;  // Narrow in place, front to back
+            for (long long i = 0; i < n; i++) {
+                bytes[i] = (uint8_t)buf[i];
+            }
+        }
+        if (fwrite(buf, record_size, n, f) != (size_t)n) {
+            fprintf(stderr, "Error: Short write to '%s'\n", path);
+            fclose(f);
+            free(buf);
+            return 1;
+        }
     }
+    fclose(f);
+    free(buf);
     
-    printf("%s (%.6f seconds, %.2fx speedup)\n", best_name, best_time, seq_time / best_time);
+    printf("Wrote %lld %s records (%.2f GB) to %s in %.3f seconds\n", size,
+           record_size == 1 ? "uint8" : "int32", (double)size * record_size * 1e-9,
+           path, omp_get_wtime() - start_time);
+    return 0;
+}
+
+/**
+ * Ask the kernel to drop the file from the page cache, so the next pass
+ * is a cold read. This is advisory: dirty pages and some file systems
+ * keep their pages resident.
+ */
+static void drop_page_cache(int fd) {
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+/**
+ * Count through a read-only mapping. Every thread walks its own block in
+ * MMAP_PREFETCH steps and requests the next step with MADV_WILLNEED
+ * before counting the current one, so page-in overlaps with counting.
+ */
+static long long count_file_mmap(int fd, long long n, int record_size) {
+    size_t bytes = (size_t)n * record_size;
+    void *map = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return -1;
+    }
+    madvise(map, bytes, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(map, bytes, MADV_HUGEPAGE);  // Only honored for file systems with huge page support
+#endif
     
-    printf("\nKey Observations:\n");
-    printf("1. Race Condition: Produces incorrect results due to data races\n");
-    printf("2. Critical Section: Correct but very slow due to serialization\n");
-    printf("3. Atomic: Better than critical but still has synchronization overhead\n");
-    printf("4. Reduction: Optimal - compiler optimizes the reduction operation\n");
-    printf("5. Private Counters: Similar to reduction, good manual alternative\n");
+    long long count = 0;
+    long long step = MMAP_PREFETCH / record_size;
     
-    printf("\nFactors affecting performance:\n");
-    printf("- Number of threads: More threads = more potential speedup (up to a limit)\n");
-    printf("- Array size: Larger arrays benefit more from parallelization\n");
-    printf("- Frequency of 3s: More 3s = more synchronization overhead (except reduction)\n");
-    printf("- Cache effects: False sharing can reduce performance\n");
-    printf("- Thread scheduling: OS scheduling can impact performance\n");
+    #pragma omp parallel reduction(+:count)
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        long long chunk = n / nthreads;
+        long long start = tid * chunk;
+        long long end = (tid == nthreads - 1) ? n : start + chunk;
+        
+        for (long long i = start; i < end; i += step) {
+            long long len = end - i < step ? end - i : step;
+            long long next = i + step;
+            if (next < end) {
+                // madvise needs a page-aligned start address
+                uintptr_t addr = (uintptr_t)map + next * record_size;
+                uintptr_t page = addr & ~(uintptr_t)4095;
+                long long ahead = end - next < step ? end - next : step;
+                madvise((void *)page, addr - page + ahead * record_size, MADV_WILLNEED);
+            }
+            if (record_size == 1) {
+                count += count_bytes_kernel((const uint8_t *)map + i, len, 3);
+            } else {
+                count += count_kernel((const int *)map + i, len, 3);
+            }
+        }
+    }
+    
+    munmap(map, bytes);
+    return count;
+}
+
+// Double-buffered reader state shared by the I/O thread and the counting threads
+typedef struct {
+    int fd;
+    long long total_bytes;
+    char *buf[2];
+    long long len[2];   // Valid bytes in each buffer, 0 marks end of file
+    int ready[2];       // 1 while a buffer is filled and not yet consumed
+    int error;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} stream_state;
+
+/**
+ * I/O thread: fill the two buffers alternately, blocking while the
+ * counting threads still hold the buffer it wants to refill
+ */
+static void *stream_reader(void *arg) {
+    stream_state *st = (stream_state *)arg;
+    long long offset = 0;
+    
+    for (int b = 0;; b ^= 1) {
+        pthread_mutex_lock(&st->lock);
+        while (st->ready[b]) {
+            pthread_cond_wait(&st->cond, &st->lock);
+        }
+        pthread_mutex_unlock(&st->lock);
+        
+        long long want = st->total_bytes - offset < STREAM_CHUNK ? st->total_bytes - offset : STREAM_CHUNK;
+        long long got = 0;
+        while (got < want) {
+            ssize_t r = pread(st->fd, st->buf[b] + got, want - got, offset + got);
+            if (r <= 0) {
+                st->error = 1;
+                want = got;
+                break;
+            }
+            got += r;
+        }
+        offset += got;
+        
+        pthread_mutex_lock(&st->lock);
+        st->len[b] = got;
+        st->ready[b] = 1;
+        pthread_cond_broadcast(&st->cond);
+        pthread_mutex_unlock(&st->lock);
+        
+        if (got == 0) {
+            return NULL;
+        }
+    }
+}
+
+/**
+ * Count with double-buffered reads: while the OpenMP threads count one
+ * buffer, the I/O thread reads the next chunk into the other
+ */
+static long long count_file_stream(int fd, long long n, int record_size) {
+    stream_state st;
+    memset(&st, 0, sizeof(st));
+    st.fd = fd;
+    st.total_bytes = n * record_size;
+    st.buf[0] = (char *)aligned_alloc(4096, STREAM_CHUNK);
+    st.buf[1] = (char *)aligned_alloc(4096, STREAM_CHUNK);
+    if (st.buf[0] == NULL || st.buf[1] == NULL) {
+        fprintf(stderr, "Error: Failed to allocate stream buffers\n");
+        free(st.buf[0]);
+        free(st.buf[1]);
+        return -1;
+    }
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.cond, NULL);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    
+    pthread_t reader;
+    pthread_create(&reader, NULL, stream_reader, &st);
+    
+    long long count = 0;
+    for (int b = 0;; b ^= 1) {
+        pthread_mutex_lock(&st.lock);
+        while (!st.ready[b]) {
+            pthread_cond_wait(&st.cond, &st.lock);
+        }
+        long long len = st.len[b];
+        pthread_mutex_unlock(&st.lock);
+        
+        if (len == 0) {
+            break;
+        }
+        count += count_records_parallel(st.buf[b], len / record_size, record_size, 3);
+        
+        pthread_mutex_lock(&st.lock);
+        st.ready[b] = 0;
+        pthread_cond_broadcast(&st.cond);
+        pthread_mutex_unlock(&st.lock);
+    }
+    
+    pthread_join(reader, NULL);
+    pthread_mutex_destroy(&st.lock);
+    pthread_cond_destroy(&st.cond);
+    free(st.buf[0]);
+    free(st.buf[1]);
+    return st.error ? -1 : count;
+}
+
+// Benchmark context for one file counting method
+typedef struct {
+    int fd;
+    long long n;
+    int record_size;
+    long long (*method)(int fd, long long n, int record_size);
+} file_ctx;
+
+static double bench_file(void *c) {
+    file_ctx *x = (file_ctx *)c;
+    return (double)x->method(x->fd, x->n, x->record_size);
+}
+
+/**
+ * File mode: count 3s in a raw record file with mmap and with streaming
+ * reads, each once from a dropped page cache (cold) and then over the
+ * harness repetitions with a page-cache-hot file
+ */
+int run_file_benchmark(bench_config *cfg, const char *path, int record_size, int num_threads) {
+    int fd = open(path, O_RDONLY);
+    struct stat sb;
+    if (fd < 0 || fstat(fd, &sb) != 0) {
+        fprintf(stderr, "Error: Cannot open '%s'\n", path);
+        return 1;
+    }
+    long long n = sb.st_size / record_size;
+    if (sb.st_size % record_size != 0) {
+        fprintf(stderr, "Warning: Ignoring %lld trailing bytes\n", (long long)(sb.st_size % record_size));
+    }
+    if (n == 0) {
+        fprintf(stderr, "Error: '%s' holds no complete records\n", path);
+        close(fd);
+        return 1;
+    }
+    double gb = (double)n * record_size * 1e-9;
+    cfg->size = n;
+    
+    printf("=======================================================\n");
+    printf("Count3s - Out-of-core File Mode\n");
+    printf("=======================================================\n");
+    printf("File: %s (%lld %s records, %.2f GB)\n", path, n, record_size == 1 ? "uint8" : "int32", gb);
+    printf("Number of threads: %d\n", num_threads);
+    printf("Number of hot runs per method: %d (+%d warmup)\n", cfg->reps, cfg->warmup);
+    printf("=======================================================\n\n");
+    
+    const char *names[2] = {"mmap", "stream"};
+    long long (*methods[2])(int, long long, int) = {count_file_mmap, count_file_stream};
+    double cold_time[2], hot_time[2];
+    long long counts[2];
+    int ok = 1;
+    
+    for (int m = 0; m < 2; m++) {
+        char name[32];
+        drop_page_cache(fd);
+        double start_time = omp_get_wtime();
+        counts[m] = methods[m](fd, n, record_size);
+        cold_time[m] = omp_get_wtime() - start_time;
+        
+        double reference = m == 0 ? NAN : (double)counts[0];
+        snprintf(name, sizeof(name), "%s cold", names[m]);
+        ok &= bench_report(cfg, name, &cold_time[m], 1, (double)counts[m], reference, 0.0).correct;
+        
+        file_ctx ctx = {fd, n, record_size, methods[m]};
+        cfg->work_ops = (double)n;
+        cfg->work_bytes = (double)n * record_size;
+        snprintf(name, sizeof(name), "%s hot", names[m]);
+        bench_result r = bench_run(cfg, name, bench_file, &ctx, (double)counts[0], 0.0);
+        hot_time[m] = r.median;
+        ok &= r.correct;
+    }
+    close(fd);
+    
+    printf("%-12s %14s %12s %10s %12s %10s\n", "Method", "Count of 3s", "Cold (s)", "GB/s", "Hot (s)", "GB/s");
+    printf("-------------------------------------------------------------------------\n");
+    for (int m = 0; m < 2; m++) {
+        printf("%-12s %14lld %12.6f %10.2f %12.6f %10.2f\n", names[m], counts[m],
+               cold_time[m], gb / cold_time[m], hot_time[m], gb / hot_time[m]);
+    }
+    printf("-------------------------------------------------------------------------\n");
+    
+    ok &= counts[0] >= 0;
+    printf("Results %s\n", ok ? "match (Correct)" : "DIFFER (INCORRECT!)");
+    printf("Compare with the Bandwidth lines of the in-memory SIMD variants.\n");
+    printf("Cold runs depend on POSIX_FADV_DONTNEED being honored by the file system.\n");
+    return ok ? 0 : 1;
+}
+
+/**
+ * Variant 9: Full histogram of all values in one pass
+ * 
+ * Every thread owns HIST_COPIES sub-histograms in one cache-line-aligned
+ * block and rotates between them element by element, so runs of equal
+ * values do not serialize on a store-to-load dependency through one
+ * counter. Values outside [0, nbins) land in an overflow slot. The
+ * per-thread histograms are merged with a pairwise tree reduction.
+ * hist must hold nbins counters. Returns 0, or -1 (hist zeroed) when the
+ * buffers cannot be allocated.
+ */
+int histogram_parallel(int *arr, long long size, int nbins, long long *hist) {
+    int max_threads = omp_get_max_threads();
+    // nbins counters plus the overflow slot, rounded up to whole cache lines
+    int stride = (nbins + 1 + 7) / 8 * 8;
+    long long **sub = (long long **)malloc(max_threads * sizeof(long long *));
+    int failed = sub == NULL;
+    
+    #pragma omp parallel if (!failed)
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        long long *h = (long long *)aligned_alloc(64, HIST_COPIES * stride * sizeof(long long));
+        if (h == NULL) {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        // All threads must agree before entering the worksharing loop and barriers
+        #pragma omp barrier
+        
+        if (!failed) {
+            memset(h, 0, HIST_COPIES * stride * sizeof(long long));
+            long long *h0 = h, *h1 = h + stride, *h2 = h + 2 * stride, *h3 = h + 3 * stride;
+            unsigned int bins = (unsigned int)nbins;
+            
+            #pragma omp for schedule(static)
+            for (long long i = 0; i < size - size % HIST_COPIES; i += HIST_COPIES) {
+                unsigned int v0 = arr[i], v1 = arr[i + 1], v2 = arr[i + 2], v3 = arr[i + 3];
+                h0[v0 < bins ? v0 : bins]++;
+                h1[v1 < bins ? v1 : bins]++;
+                h2[v2 < bins ? v2 : bins]++;
+                h3[v3 < bins ? v3 : bins]++;
+            }
+            if (tid == nthreads - 1) {
+                for (long long i = size - size % HIST_COPIES; i < size; i++) {
+                    unsigned int v = arr[i];
+                    h0[v < bins ? v : bins]++;
+                }
+            }
+            
+            // Fold the copies into the first one
+            for (int c = 1; c < HIST_COPIES; c++) {
+                for (int b = 0; b < nbins; b++) {
+                    h[b] += h[c * stride + b];
+                }
+            }
+            sub[tid] = h;
+            
+            // Tree reduction: log2(threads) rounds of pairwise merges
+            for (int step = 1; step < nthreads; step *= 2) {
+                #pragma omp barrier
+                if (tid % (2 * step) == 0 && tid + step < nthreads) {
+                    for (int b = 0; b < nbins; b++) {
+                        h[b] += sub[tid + step][b];
+                    }
+                }
+            }
+            #pragma omp barrier
+            
+            if (tid == 0) {
+                memcpy(hist, h, nbins * sizeof(long long));
+            }
+            #pragma omp barrier
+        }
+        free(h);
+    }
+    
+    free(sub);
+    if (failed) {
+        fprintf(stderr, "Error: Failed to allocate histogram buffers\n");
+        memset(hist, 0, nbins * sizeof(long long));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Baseline for variant 9: one SIMD + OpenMP counting pass per value
+ */
+void histogram_by_passes(int *arr, long long size, int nbins, long long *hist) {
+    for (int v = 0; v < nbins; v++) {
+        hist[v] = count_records_parallel(arr, size, sizeof(int), v);
+    }
+}
+
+/**
+ * Compact layouts (variant 10)
+ * 
+ * uint8:   one byte per element, values 0-255
+ * nibble:  two elements per byte (element 2j in the low nibble), values
+ *          0-15; an odd tail is padded with 0xF
+ * bitmap:  one bit-sliced bitmap per value 0..HIST_BINS-1, bit i of bitmap v
+ *          set when arr[i] == v; counting a value reads only its bitmap
+ */
+void encode_uint8(int *arr, long long size, uint8_t *out) {
+    #pragma omp parallel for simd schedule(static)
+    for (long long i = 0; i < size; i++) {
+        out[i] = (uint8_t)arr[i];
+    }
+}
+
+void encode_nibbles(int *arr, long long size, uint8_t *out) {
+    long long pairs = size / 2;
+    
+    #pragma omp parallel for simd schedule(static)
+    for (long long j = 0; j < pairs; j++) {
+        out[j] = (uint8_t)((arr[2 * j] & 0xF) | ((arr[2 * j + 1] & 0xF) << 4));
+    }
+    if (size % 2) {
+        out[pairs] = (uint8_t)((arr[size - 1] & 0xF) | 0xF0);
+    }
+}
+
+/**
+ * bitmaps holds HIST_BINS arrays of (size + 63) / 64 words. Every thread
+ * builds whole 64-element words, so no two threads write the same word.
+ */
+void encode_bitmaps(int *arr, long long size, uint64_t **bitmaps) {
+    long long words = (size + 63) / 64;
+    
+    #pragma omp parallel for schedule(static)
+    for (long long w = 0; w < words; w++) {
+        uint64_t bits[HIST_BINS] = {0};
+        long long base = w * 64;
+        int len = size - base < 64 ? (int)(size - base) : 64;
+        for (int b = 0; b < len; b++) {
+            unsigned int v = arr[base + b];
+            if (v < HIST_BINS) {
+                bits[v] |= 1ULL << b;
+            }
+        }
+        for (int v = 0; v < HIST_BINS; v++) {
+            bitmaps[v][w] = bits[v];
+        }
+    }
+}
+
+long long count_uint8_parallel(uint8_t *data, long long size, int value) {
+    return count_records_parallel(data, size, 1, value);
+}
+
+/**
+ * SWAR nibble count: XOR with the broadcast value turns matching nibbles
+ * into zero; OR-folding each nibble into its low bit and inverting leaves
+ * exactly one set bit per match
+ */
+long long count_nibbles_parallel(uint8_t *data, long long size, int value) {
+    long long bytes = (size + 1) / 2;
+    long long words = bytes / 8;
+    const uint64_t pattern = 0x1111111111111111ULL * (uint64_t)(value & 0xF);
+    const uint64_t low_bits = 0x1111111111111111ULL;
+    long long count = 0;
+    
+    #pragma omp parallel for reduction(+:count) schedule(static)
+    for (long long w = 0; w < words; w++) {
+        uint64_t x;
+        memcpy(&x, data + w * 8, sizeof(x));
+        x ^= pattern;
+        x |= x >> 1;
+        x |= x >> 2;
+        count += __builtin_popcountll(~x & low_bits);
+    }
+    
+    // Tail bytes; the 0xF padding nibble of an odd size is excluded explicitly
+    for (long long j = words * 8; j < bytes; j++) {
+        count += (data[j] & 0xF) == value;
+        if (2 * j + 1 < size) {
+            count += (data[j] >> 4) == value;
+        }
+    }
+    
+    return count;
+}
+
+long long count_bitmap_parallel(uint64_t *bitmap, long long size) {
+    long long words = (size + 63) / 64;
+    long long count = 0;
+    
+    #pragma omp parallel for reduction(+:count) schedule(static)
+    for (long long w = 0; w < words; w++) {
+        count += __builtin_popcountll(bitmap[w]);
+    }
+    
+    return count;
+}
+
+// Benchmark context: the array plus the variant under test
+typedef struct {
+    int *arr;
+    long long size;
+    long long (*count)(int *arr, long long size);
+    long long *hist;
+    uint8_t *bytes;
+    uint8_t *nibbles;
+    uint64_t *bitmap;
+} count3s_ctx;
+
+// Registered count3s variants, run in this order; the first is the reference
+typedef struct {
+    const char *title;
+    const char *name;
+    long long (*count)(int *arr, long long size);
+    const char *note;
+} count3s_variant;
+
+static const count3s_variant count3s_variants[] = {
+    {"SEQUENTIAL VERSION (Baseline)", "Sequential", count3s_sequential,
+     "Baseline for speedup"},
+    {"PARALLEL WITH RACE CONDITION (INCORRECT!)", "Race Condition", count3s_parallel_race,
+     "Result is unreliable due to race condition!"},
+    {"PARALLEL WITH CRITICAL SECTION", "Critical Section", count3s_parallel_critical,
+     "Critical section creates bottleneck"},
+    {"PARALLEL WITH ATOMIC OPERATIONS", "Atomic", count3s_parallel_atomic,
+     "Better than critical, but still has overhead"},
+    {"PARALLEL WITH REDUCTION CLAUSE (BEST)", "Reduction", count3s_parallel_reduction,
+     "Optimal approach with minimal overhead"},
+    {"PARALLEL WITH PRIVATE COUNTERS (Manual Reduction)", "Private Counters", count3s_parallel_private,
+     "Similar to reduction but manual implementation"},
+    {"EXPLICIT SIMD KERNEL (Single Thread)", "SIMD (1 thread)", count3s_simd,
+     "Compare/mask accumulation, no reliance on auto-vectorization"},
+    {"EXPLICIT SIMD KERNEL WITH OPENMP", "SIMD + OpenMP", count3s_parallel_simd,
+     "Fewer threads are needed to saturate memory bandwidth"},
+};
+#define NUM_VARIANTS (int)(sizeof(count3s_variants) / sizeof(count3s_variants[0]))
+
+// Threads a variant runs on: the sequential and single-thread SIMD ones use one core
+static int variant_threads(int v, int num_threads) {
+    return (v == 0 || count3s_variants[v].count == count3s_simd) ? 1 : num_threads;
+}
+
+static double bench_count3s(void *c) {
+    count3s_ctx *x = (count3s_ctx *)c;
+    return (double)x->count(x->arr, x->size);
+}
+
+static double bench_histogram(void *c) {
+    count3s_ctx *x = (count3s_ctx *)c;
+    if (histogram_parallel(x->arr, x->size, HIST_BINS, x->hist) != 0) {
+        return -1.0;
+    }
+    return (double)x->hist[3];
+}
+
+static double bench_histogram_passes(void *c) {
+    count3s_ctx *x = (count3s_ctx *)c;
+    histogram_by_passes(x->arr, x->size, HIST_BINS, x->hist);
+    return (double)x->hist[3];
+}
+
+static double bench_layout_uint8(void *c) {
+    count3s_ctx *x = (count3s_ctx *)c;
+    return (double)count_uint8_parallel(x->bytes, x->size, 3);
+}
+
+static double bench_layout_nibble(void *c) {
+    count3s_ctx *x = (count3s_ctx *)c;
+    return (double)count_nibbles_parallel(x->nibbles, x->size, 3);
+}
+
+static double bench_layout_bitmap(void *c) {
+    count3s_ctx *x = (count3s_ctx *)c;
+    return (double)count_bitmap_parallel(x->bitmap, x->size);
+}
+
+/**
+ * Run all variants and measure performance
+ * Times in the report are medians over the harness repetitions.
+ */
+void run_benchmark(bench_config *cfg, int *arr, long long size, int num_threads) {
+    count3s_ctx ctx = {arr, size, NULL, NULL, NULL, NULL, NULL};
+    double variant_time[NUM_VARIANTS];
+    long long correct_count = 0;
+    
+    printf("-------------------------------------------------------\n");
+    printf("Running benchmarks...\n");
+    printf("-------------------------------------------------------\n\n");
+    
+    // ===== VARIANTS 1-8: Counting 3s =====
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+        const count3s_variant *var = &count3s_variants[v];
+        printf("%d. %s\n", v + 1, var->title);
+        
+        ctx.count = var->count;
+        cfg->work_ops = (double)size;  // One compare per element
+        cfg->work_bytes = (double)size * sizeof(int);
+        // The race variant is expected to miscount, so it is not checked
+        int checked = v > 0 && var->count != count3s_parallel_race;
+        bench_result r = bench_run(cfg, var->name, bench_count3s, &ctx,
+                                   checked ? (double)correct_count : NAN, 0.0);
+        long long result = (long long)r.value;
+        variant_time[v] = r.median;
+        
+        if (v == 0) {
+            correct_count = result;  // Use as reference
+            printf("   Count of 3s: %lld\n", result);
+        } else if (var->count == count3s_parallel_race) {
+            printf("   Count of 3s: %lld (Correct: %lld) - ", result, correct_count);
+            if (result == correct_count) {
+                printf("Correct (by chance)\n");
+            } else {
+                printf("INCORRECT! (Error: %lld)\n", correct_count - result);
+            }
+        } else {
+            printf("   Count of 3s: %lld ", result);
+            printf(r.correct ? "(Correct)\n" : "(INCORRECT!)\n");
+        }
+        printf("   Median time: %.6f seconds\n", r.median);
+        printf("   Speedup: %.2fx\n", variant_time[0] / r.median);
+        if (v > 0) {
+            printf("   Efficiency: %.2f%%\n", (variant_time[0] / r.median) / variant_threads(v, num_threads) * 100);
+        }
+        printf("   Bandwidth: %.2f GB/s\n", size * sizeof(int) / r.median * 1e-9);
+        printf("   Note: %s\n\n", var->note);
+    }
+    
+    // ===== VARIANT 9: Full histogram in one pass =====
+    printf("9. FULL HISTOGRAM (values 0-%d, single pass)\n", HIST_BINS - 1);
+    long long hist[HIST_BINS], hist_ref[HIST_BINS];
+    ctx.hist = hist_ref;
+    cfg->work_ops = (double)size * HIST_BINS;
+    cfg->work_bytes = (double)size * sizeof(int) * HIST_BINS;
+    double passes_time = bench_run(cfg, "Separate count passes", bench_histogram_passes, &ctx,
+                                   (double)correct_count, 0.0).median;
+    ctx.hist = hist;
+    cfg->work_ops = (double)size;
+    cfg->work_bytes = (double)size * sizeof(int);
+    double hist_time = bench_run(cfg, "Single-pass histogram", bench_histogram, &ctx,
+                                 (double)correct_count, 0.0).median;
+    int hist_ok = hist[3] == correct_count;
+    for (int v = 0; v < HIST_BINS; v++) {
+        hist_ok = hist_ok && hist[v] == hist_ref[v];
+    }
+    printf("   Counts:");
+    for (int v = 0; v < HIST_BINS; v++) {
+        printf(" %d:%lld", v, hist[v]);
+    }
+    printf(hist_ok ? " (Correct)\n" : " (INCORRECT!)\n");
+    printf("   Single pass time: %.6f seconds\n", hist_time);
+    printf("   %d SIMD count passes: %.6f seconds\n", HIST_BINS, passes_time);
+    printf("   Speedup over separate passes: %.2fx\n", passes_time / hist_time);
+    printf("   Note: Reads the array once instead of %d times\n\n", HIST_BINS);
+    
+    // ===== VARIANT 10: Compact storage layouts =====
+    printf("10. COMPACT STORAGE LAYOUTS\n");
+    const char *layout_names[4] = {"int32", "uint8", "nibble", "bitmap"};
+    bench_fn layout_fns[4] = {NULL, bench_layout_uint8, bench_layout_nibble, bench_layout_bitmap};
+    double layout_bytes[4], encode_time[4], layout_time[4];
+    long long layout_count[4];
+    long long words = (size + 63) / 64;
+    uint8_t *bytes = (uint8_t *)malloc(size);
+    uint8_t *nibbles = (uint8_t *)malloc((size + 1) / 2);
+    uint64_t *bitmap_store = (uint64_t *)malloc(HIST_BINS * words * sizeof(uint64_t));
+    uint64_t *bitmaps[HIST_BINS];
+    for (int v = 0; v < HIST_BINS; v++) {
+        bitmaps[v] = bitmap_store + v * words;
+    }
+    
+    if (bytes == NULL || nibbles == NULL || bitmap_store == NULL) {
+        printf("   Skipped: not enough memory for the compact copies\n\n");
+        layout_time[0] = -1.0;
+    } else {
+        layout_bytes[0] = (double)size * sizeof(int);
+        layout_bytes[1] = (double)size;
+        layout_bytes[2] = (double)((size + 1) / 2);
+        layout_bytes[3] = (double)HIST_BINS * words * sizeof(uint64_t);
+        encode_time[0] = 0.0;
+        layout_time[0] = variant_time[NUM_VARIANTS - 1];
+        layout_count[0] = correct_count;
+        
+        double start_time = omp_get_wtime();
+        encode_uint8(arr, size, bytes);
+        encode_time[1] = omp_get_wtime() - start_time;
+        start_time = omp_get_wtime();
+        encode_nibbles(arr, size, nibbles);
+        encode_time[2] = omp_get_wtime() - start_time;
+        start_time = omp_get_wtime();
+        encode_bitmaps(arr, size, bitmaps);
+        encode_time[3] = omp_get_wtime() - start_time;
+        
+        ctx.bytes = bytes;
+        ctx.nibbles = nibbles;
+        ctx.bitmap = bitmaps[3];
+        for (int l = 1; l < 4; l++) {
+            char name[32];
+            snprintf(name, sizeof(name), "Layout %s", layout_names[l]);
+            cfg->work_ops = (double)size;
+            cfg->work_bytes = l == 3 ? layout_bytes[l] / HIST_BINS : layout_bytes[l];
+            bench_result r = bench_run(cfg, name, layout_fns[l], &ctx, (double)correct_count, 0.0);
+            layout_time[l] = r.median;
+            layout_count[l] = (long long)r.value;
+        }
+        
+        printf("   %-8s %10s %12s %12s %12s %14s\n", "Layout", "Footprint", "Encode (s)",
+               "Count (s)", "Gelem/s", "Count of 3s");
+        for (int l = 0; l < 4; l++) {
+            printf("   %-8s %7.1f MB %12.6f %12.6f %12.2f %14lld %s\n", layout_names[l],
+                   layout_bytes[l] / (1024.0 * 1024.0), encode_time[l], layout_time[l],
+                   size / layout_time[l] * 1e-9, layout_count[l],
+                   layout_count[l] == correct_count ? "(Correct)" : "(INCORRECT!)");
+        }
+        printf("   Note: The bitmap stores all %d values but counting one reads only 1 bit/element\n\n",
+               HIST_BINS);
+    }
+    free(bytes);
+    free(nibbles);
+    free(bitmap_store);
+    
+    // ===== SUMMARY TABLE =====
+    double seq_time = variant_time[0];
+    printf("-------------------------------------------------------\n");
+    printf("PERFORMANCE SUMMARY (median times)\n");
+    printf("-------------------------------------------------------\n");
+    printf("%-25s %12s %10s %10s\n", "Variant", "Time (s)", "Speedup", "Efficiency");
+    printf("-------------------------------------------------------\n");
+    for (int v = 0; v < NUM_VARIANTS; v++) {
+        printf("%-25s %12.6f %10.2fx %9.1f%%\n", count3s_variants[v].name, variant_time[v],
+               seq_time / variant_time[v], (seq_time / variant_time[v]) / variant_threads(v, num_threads) * 100);
+    }
+    printf("-------------------------------------------------------\n");
+    printf("%-25s %12s %10s\n", "Histogram (all values)", "Time (s)", "vs passes");
+    printf("-------------------------------------------------------\n");
+    printf("%-25s %12.6f %10.2fx\n", "Separate count passes", passes_time, 1.0);
+    printf("%-25s %12.6f %10.2fx\n", "Single-pass histogram", hist_time, passes_time / hist_time);
+    printf("-------------------------------------------------------\n");
+    if (layout_time[0] > 0.0) {
+        printf("%-25s %12s %10s\n", "Layout (SIMD + OpenMP)", "Time (s)", "vs int32");
+        printf("-------------------------------------------------------\n");
+        for (int l = 0; l < 4; l++) {
+            printf("%-25s %12.6f %10.2fx\n", layout_names[l], layout_time[l], layout_time[0] / layout_time[l]);
+        }
+        printf("-------------------------------------------------------\n");
+    }
+    
+    // ===== ANALYSIS =====
+    printf("\nANALYSIS:\n");
+    printf("-------------------------------------------------------\n");
+    printf("Best performing variant: ");
+    double best_time = 0.0;
+    const char *best_name = NULL;
+    
+    // The race condition variant is excluded, its result is wrong
+    for (int v = 1; v < NUM_VARIANTS; v++) {
+        if (count3s_variants[v].count == count3s_parallel_race) {
+            continue;
+        }
+        if (best_name == NULL || variant_time[v] < best_time) {
+            best_time = variant_time[v];
+            best_name = count3s_variants[v].name;
+        }
+    }
+    
+    printf("%s (%.6f seconds, %.2fx speedup)\n", best_name, best_time, seq_time / best_time);
+    
+    printf("\nKey Observations:\n");
+    printf("1. Race Condition: Produces incorrect results due to data races\n");
+    printf("2. Critical Section: Correct but very slow due to serialization\n");
+    printf("3. Atomic: Better than critical but still has synchronization overhead\n");
+    printf("4. Reduction: Optimal - compiler optimizes the reduction operation\n");
+    printf("5. Private Counters: Similar to reduction, good manual alternative\n");
+    printf("6. SIMD: Explicit vector compares make each core stream data faster\n");
+    printf("7. Histogram: One pass for all values beats one pass per value\n");
+    printf("8. Compact layouts: Fewer bytes per element means less memory traffic\n");
+    
+    printf("\nFactors affecting performance:\n");
+    printf("- Number of threads: More threads = more potential speedup (up to a limit)\n");
+    printf("- Array size: Larger arrays benefit more from parallelization\n");
+    printf("- Frequency of 3s: More 3s = more synchronization overhead (except reduction)\n");
+    printf("- Cache effects: False sharing can reduce performance\n");
+    printf("  (--contention sweeps both: densities 0-100%%, packed vs padded counters)\n");
+    printf("- Thread scheduling: OS scheduling can impact performance\n");
+}
+
+static double sweep_count3s(void *c, long long size) {
+    count3s_ctx *x = (count3s_ctx *)c;
+    return (double)x->count(x->arr, size);
+}
+
+/**
+ * Sweep mode: scaling curves for the reduction and SIMD + OpenMP variants
+ * The array is allocated and initialized once for the largest size; smaller
+ * problems run on a prefix of it.
+ */
+int run_sweep(bench_config *cfg, int argc, char *argv[]) {
+    long long threads[BENCH_MAX_LIST], sizes[BENCH_MAX_LIST];
+    int nthreads, nsizes;
+    double density = argc > 4 ? atof(argv[4]) : DEFAULT_DENSITY;
+    
+    if (!bench_parse_sweep(argc, argv, 2, DEFAULT_ARRAY_SIZE, threads, &nthreads, sizes, &nsizes)) {
+        return 1;
+    }
+    long long max_size = sizes[nsizes - 1];
+    
+    printf("=======================================================\n");
+    printf("Count3s - Scaling Sweep\n");
+    printf("=======================================================\n");
+    printf("Threads:");
+    for (int t = 0; t < nthreads; t++) {
+        printf(" %lld", threads[t]);
+    }
+    printf("\nSizes:");
+    for (int i = 0; i < nsizes; i++) {
+        printf(" %lld", sizes[i]);
+    }
+    printf("\nRuns per point: %d (+%d warmup)\n", cfg->reps, cfg->warmup);
+    printf("=======================================================\n");
+    
+    int *arr = (int *)malloc(max_size * sizeof(int));
+    if (arr == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for array\n");
+        return 1;
+    }
+    omp_set_num_threads((int)threads[nthreads - 1]);
+    double init_start = omp_get_wtime();
+    initialize_array(arr, max_size, density);
+    printf("Array of %lld elements initialized once in %.6f seconds.\n", max_size, omp_get_wtime() - init_start);
+    
+    count3s_ctx ctx = {arr, max_size, NULL, NULL, NULL, NULL, NULL};
+    ctx.count = count3s_parallel_reduction;
+    bench_sweep(cfg, "Reduction", sweep_count3s, &ctx, threads, nthreads, sizes, nsizes, bench_weak_linear);
+    ctx.count = count3s_parallel_simd;
+    bench_sweep(cfg, "SIMD + OpenMP", sweep_count3s, &ctx, threads, nthreads, sizes, nsizes, bench_weak_linear);
+    
+    free(arr);
+    return 0;
+}
+
+/**
+ * Variant 11 drivers: count needle in arr[0..size) over parts ranges of
+ * start positions; first_pos/last_pos get the first and last match (-1 if none)
+ */
+long long pattern_count_parallel(int *arr, long long size, const int *needle, int m, int parts,
+                                 long long *first_pos, long long *last_pos) {
+    long long starts = size - m + 1;
+    long long count = 0, first = LLONG_MAX, last = -1;
+    
+    if (starts > 0) {
+        #pragma omp parallel for reduction(+:count) reduction(min:first) reduction(max:last) schedule(static)
+        for (int p = 0; p < parts; p++) {
+            long long begin = starts * p / parts;
+            long long end = starts * (p + 1) / parts;
+            long long f = -1, l = -1;
+            count += pattern_kernel(arr, begin, end, needle, m, &f, &l);
+            if (f >= 0) {
+                first = f < first ? f : first;
+                last = l > last ? l : last;
+            }
+        }
+    }
+    
+    *first_pos = first == LLONG_MAX ? -1 : first;
+    *last_pos = last;
+    return count;
+}
+
+/**
+ * Baseline for variant 11: compare the needle at every position, element by
+ * element; parallel over positions when threads > 1
+ */
+long long pattern_count_naive(int *arr, long long size, const int *needle, int m, int threads,
+                              long long *first_pos, long long *last_pos) {
+    long long count = 0, first = LLONG_MAX, last = -1;
+    
+    #pragma omp parallel for reduction(+:count) reduction(min:first) reduction(max:last) \
+        schedule(static) num_threads(threads)
+    for (long long i = 0; i <= size - m; i++) {
+        int j = 0;
+        while (j < m && arr[i + j] == needle[j]) {
+            j++;
+        }
+        if (j == m) {
+            count++;
+            first = i < first ? i : first;
+            last = i > last ? i : last;
+        }
+    }
+    
+    *first_pos = first == LLONG_MAX ? -1 : first;
+    *last_pos = last;
+    return count;
+}
+
+/**
+ * Many needles in one pass: needles are bucketed by a hash of their first
+ * two elements (first element only for m = 1), so each position looks up
+ * one or two short candidate lists instead of testing every needle.
+ * Every thread scans a contiguous range of start positions; matches may
+ * read past the range end, as in pattern_count_parallel.
+ */
+typedef struct {
+    int count;
+    int len[PATTERN_MAX_NEEDLES];
+    int needle[PATTERN_MAX_NEEDLES][PATTERN_MAX_LEN];
+    int pair_start[PATTERN_BUCKETS + 1];   // Candidates of bucket b: pair_ids[pair_start[b]..pair_start[b+1])
+    int pair_ids[PATTERN_MAX_NEEDLES];
+    int single_start[PATTERN_BUCKETS + 1];
+    int single_ids[PATTERN_MAX_NEEDLES];
+} pattern_set;
+
+static inline unsigned int pattern_hash1(int a) {
+    return ((uint32_t)a * 0x9E3779B1u) >> (32 - PATTERN_HASH_BITS);
+}
+
+static inline unsigned int pattern_hash2(int a, int b) {
+    return ((uint32_t)a * 0x9E3779B1u ^ (uint32_t)b * 0x85EBCA77u) >> (32 - PATTERN_HASH_BITS);
+}
+
+void pattern_set_build(pattern_set *set) {
+    memset(set->pair_start, 0, sizeof(set->pair_start));
+    memset(set->single_start, 0, sizeof(set->single_start));
+    
+    // Counting sort of the needle ids by bucket
+    for (int k = 0; k < set->count; k++) {
+        const int *nd = set->needle[k];
+        if (set->len[k] == 1) {
+            set->single_start[pattern_hash1(nd[0]) + 1]++;
+        } else {
+            set->pair_start[pattern_hash2(nd[0], nd[1]) + 1]++;
+        }
+    }
+    for (int b = 0; b < PATTERN_BUCKETS; b++) {
+        set->pair_start[b + 1] += set->pair_start[b];
+        set->single_start[b + 1] += set->single_start[b];
+    }
+    int pair_next[PATTERN_BUCKETS], single_next[PATTERN_BUCKETS];
+    memcpy(pair_next, set->pair_start, sizeof(pair_next));
+    memcpy(single_next, set->single_start, sizeof(single_next));
+    for (int k = 0; k < set->count; k++) {
+        const int *nd = set->needle[k];
+        if (set->len[k] == 1) {
+            set->single_ids[single_next[pattern_hash1(nd[0])]++] = k;
+        } else {
+            set->pair_ids[pair_next[pattern_hash2(nd[0], nd[1])]++] = k;
+        }
+    }
+}
+
+void pattern_count_multi(int *arr, long long size, const pattern_set *set, long long *counts) {
+    int nk = set->count;
+    memset(counts, 0, nk * sizeof(long long));
+    
+    #pragma omp parallel for reduction(+:counts[:nk]) schedule(static)
+    for (long long i = 0; i < size; i++) {
+        unsigned int h1 = pattern_hash1(arr[i]);
+        for (int c = set->single_start[h1]; c < set->single_start[h1 + 1]; c++) {
+            int k = set->single_ids[c];
+            counts[k] += arr[i] == set->needle[k][0];
+        }
+        if (i + 1 < size) {
+            unsigned int h2 = pattern_hash2(arr[i], arr[i + 1]);
+            for (int c = set->pair_start[h2]; c < set->pair_start[h2 + 1]; c++) {
+                int k = set->pair_ids[c];
+                int m = set->len[k];
+                if (i + m <= size && memcmp(arr + i, set->needle[k], m * sizeof(int)) == 0) {
+                    counts[k]++;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Parse needles such as "3,3/1,2,3" (elements separated by commas,
+ * needles by slashes). Returns the number of needles, 0 on a malformed list.
+ */
+static int parse_needles(const char *arg, pattern_set *set) {
+    const char *p = arg;
+    set->count = 0;
+    
+    while (*p != '\0') {
+        if (set->count == PATTERN_MAX_NEEDLES) {
+            return 0;
+        }
+        int k = set->count++;
+        set->len[k] = 0;
+        for (;;) {
+            char *end;
+            long v = strtol(p, &end, 10);
+            if (end == p || set->len[k] == PATTERN_MAX_LEN) {
+                return 0;
+            }
+            set->needle[k][set->len[k]++] = (int)v;
+            p = end;
+            if (*p != ',') {
+                break;
+            }
+            p++;
+        }
+        if (*p == '/') {
+            p++;
+        } else if (*p != '\0') {
+            return 0;
+        }
+    }
+    return set->count;
+}
+
+/**
+ * Chunk-boundary check: for every needle, an array of back-to-back copies
+ * (separated by one value not in the needle, so matches are also found
+ * across copies only when the needle allows it) is counted with every
+ * part count from 1 to PATTERN_CHECK_PARTS and compared with the naive
+ * loop. Most chunk boundaries then fall inside a match. Returns the number
+ * of failed comparisons; a failed allocation counts as one.
+ */
+static int pattern_boundary_check(const pattern_set *set) {
+    int failures = 0;
+    int *arr = (int *)malloc(PATTERN_CHECK_SIZE * sizeof(int));
+    if (arr == NULL) {
+        fprintf(stderr, "Error: Failed to allocate the boundary check array\n");
+        return 1;
+    }
+    
+    for (int k = 0; k < set->count; k++) {
+        int m = set->len[k];
+        int separator = set->needle[k][0] - 1;
+        for (int j = 0; j < m; j++) {
+            separator = set->needle[k][j] - 1 < separator ? set->needle[k][j] - 1 : separator;
+        }
+        for (long long i = 0; i < PATTERN_CHECK_SIZE; i++) {
+            long long r = i % (m + 1);
+            arr[i] = r < m ? set->needle[k][r] : separator;
+        }
+        long long f0, l0, f, l;
+        long long expect = pattern_count_naive(arr, PATTERN_CHECK_SIZE, set->needle[k], m, 1, &f0, &l0);
+        for (int parts = 1; parts <= PATTERN_CHECK_PARTS; parts++) {
+            long long got = pattern_count_parallel(arr, PATTERN_CHECK_SIZE, set->needle[k], m, parts, &f, &l);
+            if (got != expect || f != f0 || l != l0) {
+                printf("   Boundary check failed: needle %d, %d parts: %lld instead of %lld\n", k + 1, parts,
+                       got, expect);
+                failures++;
+            }
+        }
+    }
+    
+    free(arr);
+    return failures;
+}
+
+typedef struct {
+    int *arr;
+    long long size;
+    pattern_set *set;
+    int needle;          // Index into set for the single-needle variants
+    int threads;
+    long long first, last;
+    long long *counts;   // pattern_set counts for the multi variants
+} pattern_ctx;
+
+static double bench_pattern_naive(void *c) {
+    pattern_ctx *x = (pattern_ctx *)c;
+    return (double)pattern_count_naive(x->arr, x->size, x->set->needle[x->needle], x->set->len[x->needle],
+                                       x->threads, &x->first, &x->last);
+}
+
+static double bench_pattern_simd(void *c) {
+    pattern_ctx *x = (pattern_ctx *)c;
+    return (double)pattern_count_parallel(x->arr, x->size, x->set->needle[x->needle], x->set->len[x->needle],
+                                          x->threads, &x->first, &x->last);
+}
+
+static double bench_pattern_passes(void *c) {
+    pattern_ctx *x = (pattern_ctx *)c;
+    double total = 0.0;
+    for (int k = 0; k < x->set->count; k++) {
+        x->counts[k] = pattern_count_parallel(x->arr, x->size, x->set->needle[k], x->set->len[k], x->threads,
+                                              &x->first, &x->last);
+        total += (double)x->counts[k];
+    }
+    return total;
+}
+
+static double bench_pattern_multi(void *c) {
+    pattern_ctx *x = (pattern_ctx *)c;
+    pattern_count_multi(x->arr, x->size, x->set, x->counts);
+    double total = 0.0;
+    for (int k = 0; k < x->set->count; k++) {
+        total += (double)x->counts[k];
+    }
+    return total;
+}
+
+/**
+ * Pattern mode: count3s --pattern [needles] [array_size] [num_threads] [density]
+ * Per needle: naive loop (1 and N threads) against the SIMD filter engine,
+ * then all needles by one SIMD pass each against the one-pass multi-needle scan
+ */
+int run_pattern(bench_config *cfg, int argc, char *argv[]) {
+    static pattern_set set;
+    const char *needles = argc > 2 ? argv[2] : PATTERN_DEFAULT_NEEDLES;
+    long long size = argc > 3 ? atoll(argv[3]) : DEFAULT_ARRAY_SIZE;
+    int num_threads = argc > 4 ? atoi(argv[4]) : DEFAULT_NUM_THREADS;
+    double density = argc > 5 ? atof(argv[5]) : DEFAULT_DENSITY;
+    
+    if (parse_needles(needles, &set) == 0 || size <= 0 || num_threads <= 0 || density < 0.0 || density > 1.0) {
+        fprintf(stderr, "Usage: %s --pattern [needles, e.g. 3,3/1,2,3 (at most %d of <= %d elements)] "
+                "[array_size] [num_threads] [density_of_3s]\n", argv[0], PATTERN_MAX_NEEDLES, PATTERN_MAX_LEN);
+        return 1;
+    }
+    pattern_set_build(&set);
+    omp_set_num_threads(num_threads);
+    cfg->threads = num_threads;
+    cfg->size = size;
+    
+    printf("=======================================================\n");
+    printf("Count3s - Pattern Search\n");
+    printf("=======================================================\n");
+    printf("Array size: %lld elements, %d threads, density of 3s %.4f\n", size, num_threads, density);
+    printf("Needles: %d, SIMD kernel: %s\n", set.count, select_count_kernel());
+    printf("=======================================================\n");
+    
+    int failures = pattern_boundary_check(&set);
+    printf("Chunk-boundary check (1-%d parts, matches across every boundary): %s\n\n", PATTERN_CHECK_PARTS,
+           failures == 0 ? "passed" : "FAILED");
+    
+    int *arr = (int *)malloc(size * sizeof(int));
+    long long *counts = (long long *)malloc(set.count * sizeof(long long));
+    long long *expected = (long long *)malloc(set.count * sizeof(long long));
+    if (arr == NULL || counts == NULL || expected == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for array\n");
+        return 1;
+    }
+    initialize_array(arr, size, density);
+    
+    pattern_ctx ctx = {arr, size, &set, 0, 1, -1, -1, counts};
+    double expected_total = 0.0;
+    double passes_naive = 0.0;
+    printf("%-24s %12s %12s %12s %12s %12s %9s\n", "Needle", "Count", "First", "Last", "Naive 1T (s)",
+           "SIMD (s)", "Speedup");
+    printf("-------------------------------------------------------------------------------------------------\n");
+    for (int k = 0; k < set.count; k++) {
+        char text[PATTERN_MAX_LEN * 12], name[PATTERN_MAX_LEN * 12 + 16];
+        int pos = 0;
+        for (int j = 0; j < set.len[k] && pos < (int)sizeof(text) - 12; j++) {
+            pos += snprintf(text + pos, sizeof(text) - pos, j ? ",%d" : "%d", set.needle[k][j]);
+        }
+        ctx.needle = k;
+        cfg->work_ops = (double)size;
+        cfg->work_bytes = (double)size * sizeof(int);
+        
+        ctx.threads = 1;
+        snprintf(name, sizeof(name), "Pattern %s naive 1", text);
+        bench_result naive1 = bench_run(cfg, name, bench_pattern_naive, &ctx, NAN, 0.0);
+        long long first = ctx.first, last = ctx.last;
+        expected[k] = (long long)naive1.value;
+        expected_total += naive1.value;
+        
+        ctx.threads = num_threads;
+        snprintf(name, sizeof(name), "Pattern %s naive", text);
+        bench_result naive = bench_run(cfg, name, bench_pattern_naive, &ctx, naive1.value, 0.0);
+        passes_naive += naive.median;
+        snprintf(name, sizeof(name), "Pattern %s SIMD", text);
+        bench_result simd = bench_run(cfg, name, bench_pattern_simd, &ctx, naive1.value, 0.0);
+        int ok = naive.correct && simd.correct && ctx.first == first && ctx.last == last;
+        failures += !ok;
+        
+        printf("%-24s %12lld %12lld %12lld %12.6f %12.6f %8.2fx %s\n", text, expected[k], first, last,
+               naive1.median, simd.median, naive.median / simd.median, ok ? "(Correct)" : "(INCORRECT!)");
+    }
+    printf("Speedup is SIMD over the naive loop with the same %d threads\n\n", num_threads);
+    
+    ctx.threads = num_threads;
+    cfg->work_ops = (double)size * set.count;
+    cfg->work_bytes = (double)size * sizeof(int) * set.count;
+    double passes_time = bench_run(cfg, "Pattern SIMD passes", bench_pattern_passes, &ctx, expected_total,
+                                   0.0).median;
+    cfg->work_bytes = (double)size * sizeof(int);
+    bench_result multi = bench_run(cfg, "Pattern one pass", bench_pattern_multi, &ctx, expected_total, 0.0);
+    int multi_ok = multi.correct;
+    for (int k = 0; k < set.count; k++) {
+        multi_ok = multi_ok && counts[k] == expected[k];
+    }
+    failures += !multi_ok;
+    
+    printf("%-32s %12s %10s\n", "All needles", "Time (s)", "vs naive");
+    printf("-------------------------------------------------------\n");
+    printf("%-32s %12.6f %9.2fx\n", "Naive loop, one pass per needle", passes_naive, 1.0);
+    printf("%-32s %12.6f %9.2fx\n", "SIMD filter, one pass per needle", passes_time, passes_naive / passes_time);
+    printf("%-32s %12.6f %9.2fx %s\n", "Hashed needles, one pass", multi.median, passes_naive / multi.median,
+           multi_ok ? "(Correct)" : "(INCORRECT!)");
+    printf("-------------------------------------------------------\n");
+    
+    free(arr);
+    free(counts);
+    free(expected);
+    return failures != 0;
+}
+
+/**
+ * Variant 12: range-count index for repeated "how many 3s in [l, r)"
+ * queries over unchanged data. prefix[b] holds the 3s in arr[0..b*RANGE_BLOCK),
+ * so rank(x) = 3s before x is one lookup plus a SIMD scan of at most half a
+ * block (from the nearer block edge). fenwick is a Fenwick tree over the
+ * same block counts for data that changes: O(log n) queries and point
+ * updates. The prefix array is only valid until the first update.
+ */
+typedef struct {
+    long long size;
+    long long nblocks;
+    long long *prefix;    // nblocks + 1 entries
+    long long *fenwick;   // 1-based, fenwick[i] covers blocks (i - lowbit(i), i]
+} range_index;
+
+typedef struct {
+    long long l, r;
+} range_query;
+
+/**
+ * Build both structures in parallel: each thread counts a contiguous run
+ * of blocks with the SIMD kernel and sums it locally, the per-thread
+ * totals are scanned once, and a second pass over the (small) prefix
+ * array adds each thread's offset. Fenwick nodes are differences of two
+ * prefix entries, so they follow in one more parallel loop.
+ */
+int range_index_build(range_index *idx, int *arr, long long size) {
+    long long nblocks = (size + RANGE_BLOCK - 1) / RANGE_BLOCK;
+    int max_threads = omp_get_max_threads();
+    long long *offset = (long long *)calloc(max_threads + 1, sizeof(long long));
+    
+    idx->size = size;
+    idx->nblocks = nblocks;
+    idx->prefix = (long long *)malloc((nblocks + 1) * sizeof(long long));
+    idx->fenwick = (long long *)malloc((nblocks + 1) * sizeof(long long));
+    if (offset == NULL || idx->prefix == NULL || idx->fenwick == NULL) {
+        free(offset);
+        return -1;
+    }
+    
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        long long lo = nblocks * tid / nthreads;
+        long long hi = nblocks * (tid + 1) / nthreads;
+        long long sum = 0;
+        
+        for (long long b = lo; b < hi; b++) {
+            long long start = b * RANGE_BLOCK;
+            long long len = start + RANGE_BLOCK <= size ? RANGE_BLOCK : size - start;
+            sum += count_kernel(arr + start, len, 3);
+            idx->prefix[b + 1] = sum;
+        }
+        offset[tid + 1] = sum;
+        
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int t = 0; t < nthreads; t++) {
+                offset[t + 1] += offset[t];
+            }
+            idx->prefix[0] = 0;
+        }
+        
+        for (long long b = lo; b < hi; b++) {
+            idx->prefix[b + 1] += offset[tid];
+        }
+        
+        #pragma omp barrier
+        #pragma omp for schedule(static)
+        for (long long i = 1; i <= nblocks; i++) {
+            idx->fenwick[i] = idx->prefix[i] - idx->prefix[i - (i & -i)];
+        }
+    }
+    
+    free(offset);
+    return 0;
+}
+
+void range_index_free(range_index *idx) {
+    free(idx->prefix);
+    free(idx->fenwick);
+}
+
+// 3s in arr[0..n) for n below a block, inlined: the count kernels only vectorize 64+ elements
+static inline long long range_scan(const int *arr, long long n) {
+    int count = 0;
+    #pragma omp simd reduction(+:count)
+    for (long long i = 0; i < n; i++) {
+        count += arr[i] == 3;
+    }
+    return count;
+}
+
+// 3s in arr[0..x) given the 3s before block b = x / RANGE_BLOCK
+static inline long long range_rank_from(const range_index *idx, const int *arr, long long x,
+                                        long long before, long long after) {
+    long long b = x / RANGE_BLOCK;
+    long long start = b * RANGE_BLOCK;
+    long long end = start + RANGE_BLOCK <= idx->size ? start + RANGE_BLOCK : idx->size;
+    
+    if (x - start <= end - x) {
+        return before + range_scan(arr + start, x - start);
+    }
+    return after - range_scan(arr + x, end - x);
+}
+
+/**
+ * 3s in arr[l..r) from the prefix array, O(1) plus the in-block scans
+ */
+long long range_count(const range_index *idx, const int *arr, long long l, long long r) {
+    long long bl = l / RANGE_BLOCK, br = r / RANGE_BLOCK;
+    long long rank_l = range_rank_from(idx, arr, l, idx->prefix[bl], idx->prefix[bl < idx->nblocks ? bl + 1 : bl]);
+    long long rank_r = range_rank_from(idx, arr, r, idx->prefix[br], idx->prefix[br < idx->nblocks ? br + 1 : br]);
+    return rank_r - rank_l;
+}
+
+// 3s in blocks [0, b) from the Fenwick tree
+static inline long long fenwick_prefix(const range_index *idx, long long b) {
+    long long sum = 0;
+    for (; b > 0; b -= b & -b) {
+        sum += idx->fenwick[b];
+    }
+    return sum;
+}
+
+static inline long long fenwick_rank(const range_index *idx, const int *arr, long long x) {
+    long long b = x / RANGE_BLOCK;
+    long long start = b * RANGE_BLOCK;
+    // The block count itself is not stored, so always scan from the block start
+    return fenwick_prefix(idx, b) + range_scan(arr + start, x - start);
+}
+
+/**
+ * 3s in arr[l..r) from the Fenwick tree, O(log n) plus the in-block scans
+ */
+long long range_count_fenwick(const range_index *idx, const int *arr, long long l, long long r) {
+    return fenwick_rank(idx, arr, r) - fenwick_rank(idx, arr, l);
+}
+
+/**
+ * arr[i] = value, keeping the Fenwick tree current (not thread-safe)
+ */
+void range_update(range_index *idx, int *arr, long long i, int value) {
+    long long delta = (value == 3) - (arr[i] == 3);
+    arr[i] = value;
+    if (delta != 0) {
+        for (long long b = i / RANGE_BLOCK + 1; b <= idx->nblocks; b += b & -b) {
+            idx->fenwick[b] += delta;
+        }
+    }
+}
+
+/**
+ * Answer a batch of queries with the prefix index. The 2 nq endpoints are
+ * packed as (position << 32 | endpoint number), LSD radix-sorted by
+ * position and ranked in that order, so the prefix lookups and in-block
+ * scans walk the array front to back and threads get contiguous runs of
+ * it; out[k] = rank(r_k) - rank(l_k) answers queries[k]. The packing needs
+ * size < RANGE_BATCH_MAX_SIZE and nq < RANGE_BATCH_MAX_QUERIES. Returns -1
+ * when they are exceeded or the sort buffers cannot be allocated.
+ */
+int range_count_batch(const range_index *idx, const int *arr, const range_query *queries, long long nq,
+                      long long *out) {
+    if (idx->size >= RANGE_BATCH_MAX_SIZE || nq >= RANGE_BATCH_MAX_QUERIES) {
+        return -1;
+    }
+    long long npoints = 2 * nq;
+    uint64_t *keys = (uint64_t *)malloc(npoints * sizeof(uint64_t));
+    uint64_t *tmp = (uint64_t *)malloc(npoints * sizeof(uint64_t));
+    long long *rank = (long long *)malloc(npoints * sizeof(long long));
+    const long long *point = (const long long *)queries;   // l_0, r_0, l_1, r_1, ...
+    if (keys == NULL || tmp == NULL || rank == NULL) {
+        free(keys);
+        free(tmp);
+        free(rank);
+        return -1;
+    }
+    
+    #pragma omp parallel for schedule(static)
+    for (long long p = 0; p < npoints; p++) {
+        keys[p] = (uint64_t)point[p] << 32 | (uint64_t)p;
+    }
+    
+    // One stable counting pass per RANGE_RADIX_BITS digit of the position;
+    // size < 2^32 keeps every shift below 64
+    for (int shift = 32; (idx->size >> (shift - 32)) > 0; shift += RANGE_RADIX_BITS) {
+        long long bucket[(1 << RANGE_RADIX_BITS) + 1] = {0};
+        for (long long p = 0; p < npoints; p++) {
+            bucket[((keys[p] >> shift) & ((1 << RANGE_RADIX_BITS) - 1)) + 1]++;
+        }
+        for (int d = 0; d < (1 << RANGE_RADIX_BITS); d++) {
+            bucket[d + 1] += bucket[d];
+        }
+        for (long long p = 0; p < npoints; p++) {
+            tmp[bucket[(keys[p] >> shift) & ((1 << RANGE_RADIX_BITS) - 1)]++] = keys[p];
+        }
+        uint64_t *swap = keys;
+        keys = tmp;
+        tmp = swap;
+    }
+    
+    #pragma omp parallel for schedule(static)
+    for (long long s = 0; s < npoints; s++) {
+        long long x = (long long)(keys[s] >> 32);
+        long long b = x / RANGE_BLOCK;
+        rank[keys[s] & 0xFFFFFFFFULL] = range_rank_from(idx, arr, x, idx->prefix[b],
+                                                        idx->prefix[b < idx->nblocks ? b + 1 : b]);
+    }
+    
+    #pragma omp parallel for schedule(static)
+    for (long long k = 0; k < nq; k++) {
+        out[k] = rank[2 * k + 1] - rank[2 * k];
+    }
+    
+    free(keys);
+    free(tmp);
+    free(rank);
+    return 0;
+}
+
+// Random queries with l uniform and r uniform in [l, size]
+static void generate_queries(range_query *queries, long long nq, long long size, uint64_t seed) {
+    #pragma omp parallel for schedule(static)
+    for (long long k = 0; k < nq; k++) {
+        uint64_t a = splitmix64(seed + 2 * (uint64_t)k);
+        uint64_t b = splitmix64(seed + 2 * (uint64_t)k + 1);
+        long long l = (long long)(a % (uint64_t)(size + 1));
+        queries[k].l = l;
+        queries[k].r = l + (long long)(b % (uint64_t)(size - l + 1));
+    }
+}
+
+typedef struct {
+    int *arr;
+    long long size;
+    range_index *idx;
+    range_query *queries;
+    long long nq;
+    long long *out;
+    int threads;
+} range_ctx;
+
+static double range_checksum(const long long *out, long long nq) {
+    double sum = 0.0;
+    for (long long k = 0; k < nq; k++) {
+        sum += (double)out[k];
+    }
+    return sum;
+}
+
+static double bench_range_build(void *c) {
+    range_ctx *x = (range_ctx *)c;
+    range_index_free(x->idx);
+    if (range_index_build(x->idx, x->arr, x->size) != 0) {
+        return -1.0;
+    }
+    return (double)x->idx->prefix[x->idx->nblocks];
+}
+
+static double bench_range_rescan(void *c) {
+    range_ctx *x = (range_ctx *)c;
+    for (long long k = 0; k < x->nq; k++) {
+        range_query q = x->queries[k];
+        x->out[k] = count3s_parallel_reduction(x->arr + q.l, q.r - q.l);
+    }
+    return range_checksum(x->out, x->nq);
+}
+
+static double bench_range_prefix(void *c) {
+    range_ctx *x = (range_ctx *)c;
+    #pragma omp parallel for schedule(static)
+    for (long long k = 0; k < x->nq; k++) {
+        x->out[k] = range_count(x->idx, x->arr, x->queries[k].l, x->queries[k].r);
+    }
+    return range_checksum(x->out, x->nq);
+}
+
+static double bench_range_batch(void *c) {
+    range_ctx *x = (range_ctx *)c;
+    if (range_count_batch(x->idx, x->arr, x->queries, x->nq, x->out) != 0) {
+        return -1.0;
+    }
+    return range_checksum(x->out, x->nq);
+}
+
+static double bench_range_fenwick(void *c) {
+    range_ctx *x = (range_ctx *)c;
+    #pragma omp parallel for schedule(static)
+    for (long long k = 0; k < x->nq; k++) {
+        x->out[k] = range_count_fenwick(x->idx, x->arr, x->queries[k].l, x->queries[k].r);
+    }
+    return range_checksum(x->out, x->nq);
+}
+
+// Point updates that flip elements between 3 and other digits, then back
+static double bench_range_update(void *c) {
+    range_ctx *x = (range_ctx *)c;
+    for (long long k = 0; k < x->nq; k++) {
+        long long i = x->queries[k].l < x->size ? x->queries[k].l : x->size - 1;
+        range_update(x->idx, x->arr, i, x->arr[i] == 3 ? 7 : 3);
+    }
+    for (long long k = x->nq - 1; k >= 0; k--) {
+        long long i = x->queries[k].l < x->size ? x->queries[k].l : x->size - 1;
+        range_update(x->idx, x->arr, i, x->arr[i] == 3 ? 7 : 3);
+    }
+    return (double)fenwick_prefix(x->idx, x->idx->nblocks);
+}
+
+/**
+ * Range mode: count3s --range [array_size] [num_threads] [num_queries] [density]
+ * Build time and memory of the index, then query throughput of the prefix
+ * index (unsorted and batched), the Fenwick tree, Fenwick point updates,
+ * and a rescan of every query range with the reduction variant. The batched
+ * variant limits array_size to below 2^32 and num_queries to below 2^31.
+ */
+int run_range(bench_config *cfg, int argc, char *argv[]) {
+    long long size = argc > 2 ? atoll(argv[2]) : DEFAULT_ARRAY_SIZE;
+    int num_threads = argc > 3 ? atoi(argv[3]) : DEFAULT_NUM_THREADS;
+    long long nq = argc > 4 ? (long long)atof(argv[4]) : RANGE_DEFAULT_QUERIES;
+    double density = argc > 5 ? atof(argv[5]) : DEFAULT_DENSITY;
+    
+    if (size <= 0 || num_threads <= 0 || nq <= 0 || density < 0.0 || density > 1.0) {
+        fprintf(stderr, "Usage: %s --range [array_size] [num_threads] [num_queries] [density_of_3s]\n", argv[0]);
+        return 1;
+    }
+    if (size >= RANGE_BATCH_MAX_SIZE || nq >= RANGE_BATCH_MAX_QUERIES) {
+        fprintf(stderr, "Error: the batched queries need array_size < 2^32 and num_queries < 2^31\n");
+        return 1;
+    }
+    omp_set_num_threads(num_threads);
+    cfg->threads = num_threads;
+    cfg->size = size;
+    
+    printf("=======================================================\n");
+    printf("Count3s - Range Count Index\n");
+    printf("=======================================================\n");
+    printf("Array size: %lld elements, %d threads, density of 3s %.4f\n", size, num_threads, density);
+    printf("Queries: %lld, block: %d elements, SIMD kernel: %s\n", nq, RANGE_BLOCK, select_count_kernel());
+    printf("=======================================================\n");
+    
+    int *arr = (int *)malloc(size * sizeof(int));
+    range_query *queries = (range_query *)malloc(nq * sizeof(range_query));
+    long long *out = (long long *)malloc(nq * sizeof(long long));
+    range_index idx = {0, 0, NULL, NULL};
+    if (arr == NULL || queries == NULL || out == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for array\n");
+        return 1;
+    }
+    initialize_array(arr, size, density);
+    generate_queries(queries, nq, size, splitmix64(DATA_SEED + 1));
+    long long rescan_nq = nq < RANGE_RESCAN_QUERIES ? nq : RANGE_RESCAN_QUERIES;
+    range_ctx ctx = {arr, size, &idx, queries, nq, out, num_threads};
+    
+    // Build; the total doubles as the check against a full count
+    cfg->work_ops = (double)size;
+    cfg->work_bytes = (double)size * sizeof(int);
+    double total = (double)count3s_parallel_reduction(arr, size);
+    bench_result build = bench_run(cfg, "Range index build", bench_range_build, &ctx, total, 0.0);
+    double index_bytes = 2.0 * (idx.nblocks + 1) * sizeof(long long);
+    
+    // Reference answers for the first queries by rescanning
+    ctx.nq = rescan_nq;
+    cfg->work_ops = cfg->work_bytes = NAN;
+    bench_result rescan = bench_run(cfg, "Range rescan", bench_range_rescan, &ctx, NAN, 0.0);
+    long long *expected = (long long *)malloc(rescan_nq * sizeof(long long));
+    if (build.value < 0.0 || expected == NULL) {
+        fprintf(stderr, "Error: Failed to allocate the range index or the reference answers\n");
+        range_index_free(&idx);
+        free(arr);
+        free(queries);
+        free(out);
+        return 1;
+    }
+    memcpy(expected, out, rescan_nq * sizeof(long long));
+    
+    ctx.nq = nq;
+    bench_result prefix = bench_run(cfg, "Range prefix", bench_range_prefix, &ctx, NAN, 0.0);
+    int ok = memcmp(out, expected, rescan_nq * sizeof(long long)) == 0;
+    bench_result batch = bench_run(cfg, "Range prefix batched", bench_range_batch, &ctx, prefix.value, 0.0);
+    bench_result fenwick = bench_run(cfg, "Range Fenwick", bench_range_fenwick, &ctx, prefix.value, 0.0);
+    bench_result update = bench_run(cfg, "Range Fenwick update", bench_range_update, &ctx, total, 0.0);
+    ok = ok && build.correct && batch.correct && fenwick.correct && update.correct;
+    
+    // Queries must still agree after the updates have been undone
+    bench_range_fenwick(&ctx);
+    ok = ok && memcmp(out, expected, rescan_nq * sizeof(long long)) == 0;
+    
+    double rescan_rate = rescan_nq / rescan.median;
+    printf("Index build: %.6f s (%.3e elements/s), %.0f bytes = %.3f%% of the array\n", build.median,
+           size / build.median, index_bytes, 100.0 * index_bytes / ((double)size * sizeof(int)));
+    printf("Rescan reference: %lld queries\n\n", rescan_nq);
+    printf("%-28s %12s %14s %12s\n", "Method", "Time (s)", "Queries/s", "vs rescan");
+    printf("-----------------------------------------------------------------------\n");
+    printf("%-28s %12.6f %14.3e %11.2fx\n", "Rescan (reduction)", rescan.median, rescan_rate, 1.0);
+    printf("%-28s %12.6f %14.3e %11.2fx\n", "Prefix index", prefix.median, nq / prefix.median,
+           nq / prefix.median / rescan_rate);
+    printf("%-28s %12.6f %14.3e %11.2fx\n", "Prefix index, sorted batch", batch.median, nq / batch.median,
+           nq / batch.median / rescan_rate);
+    printf("%-28s %12.6f %14.3e %11.2fx\n", "Fenwick tree", fenwick.median, nq / fenwick.median,
+           nq / fenwick.median / rescan_rate);
+    printf("%-28s %12.6f %14.3e %12s\n", "Fenwick point updates", update.median, 2.0 * nq / update.median, "-");
+    printf("-----------------------------------------------------------------------\n");
+    printf("Answers: %s\n", ok ? "(Correct)" : "(INCORRECT!)");
+    
+    range_index_free(&idx);
+    free(expected);
+    free(arr);
+    free(queries);
+    free(out);
+    return !ok;
+}
+
+typedef struct {
+    int *arr;
+    long long size;
+    long long gathers;
+} alloc_ctx;
+
+static double bench_alloc_count(void *c) {
+    alloc_ctx *x = (alloc_ctx *)c;
+    return (double)count3s_parallel_simd(x->arr, x->size);
+}
+
+// 3s at pseudo-random positions: one cache line, and mostly one TLB miss, per element
+static double bench_alloc_gather(void *c) {
+    alloc_ctx *x = (alloc_ctx *)c;
+    uint64_t key = splitmix64(DATA_SEED + 2);
+    long long count = 0;
+    
+    #pragma omp parallel for reduction(+:count) schedule(static)
+    for (long long i = 0; i < x->gathers; i++) {
+        count += x->arr[splitmix64(key + (uint64_t)i) % (uint64_t)x->size] == 3;
+    }
+    
+    return (double)count;
+}
+
+/**
+ * Allocation mode: count3s --alloc [array_size] [num_threads] [density]
+ * The same data in buffers from bufalloc.h under each page-size/NUMA
+ * policy, and in a plain malloc buffer: time to map and first-touch,
+ * the streaming count of variant 8 and a random gather whose cost is
+ * dominated by TLB and (on multi-socket machines) remote misses, with the
+ * huge-page coverage and node spread the kernel actually produced
+ */
+int run_alloc(bench_config *cfg, int argc, char *argv[]) {
+    long long size = argc > 2 ? atoll(argv[2]) : DEFAULT_ARRAY_SIZE;
+    int num_threads = argc > 3 ? atoi(argv[3]) : DEFAULT_NUM_THREADS;
+    double density = argc > 4 ? atof(argv[4]) : DEFAULT_DENSITY;
+    const buf_policy policies[] = {
+        {BUF_PAGES_SMALL, BUF_NUMA_SERIAL}, {BUF_PAGES_SMALL, BUF_NUMA_LOCAL},
+        {BUF_PAGES_THP, BUF_NUMA_SERIAL}, {BUF_PAGES_THP, BUF_NUMA_LOCAL},
+        {BUF_PAGES_THP, BUF_NUMA_INTERLEAVE}, {BUF_PAGES_HUGETLB, BUF_NUMA_LOCAL}};
+    int num_policies = (int)(sizeof(policies) / sizeof(policies[0]));
+    
+    if (size <= 0 || num_threads <= 0 || density < 0.0 || density > 1.0) {
+        fprintf(stderr, "Usage: %s --alloc [array_size] [num_threads] [density_of_3s]\n", argv[0]);
+        return 1;
+    }
+    omp_set_num_threads(num_threads);
+    cfg->threads = num_threads;
+    cfg->size = size;
+    size_t bytes = size * sizeof(int);
+    alloc_ctx ctx = {NULL, size, ALLOC_GATHERS};
+    
+    printf("=======================================================\n");
+    printf("Count3s - Buffer Allocation Policies\n");
+    printf("=======================================================\n");
+    printf("Array size: %lld elements (%.1f MB), %d threads, density of 3s %.4f\n", size, bytes / 1e6,
+           num_threads, density);
+    printf("NUMA nodes: %d, SIMD kernel: %s, random gathers: %lld\n", buf_numa_nodes(), select_count_kernel(),
+           ctx.gathers);
+    printf("=======================================================\n");
+    
+    double ref_count = NAN, ref_gather = NAN;
+    int failures = 0;
+    printf("%-18s %12s %12s %10s %12s %12s %10s  %s\n", "Policy", "Init (s)", "Count (s)", "GB/s",
+           "Gather (s)", "Mgathers/s", "Huge MB", "Nodes");
+    printf("-----------------------------------------------------------------------------------------------------\n");
+    for (int p = -1; p < num_policies; p++) {
+        char name[48], nodes[128], record[64];
+        buf_info info = {0, 1, 0.0};
+        double start = omp_get_wtime();
+        
+        // p = -1: plain malloc, pages placed by initialize_array's parallel first write
+        if (p < 0) {
+            snprintf(name, sizeof(name), "malloc");
+            ctx.arr = (int *)malloc(bytes);
+        } else {
+            buf_policy_name(policies[p], name, sizeof(name));
+            ctx.arr = (int *)buf_alloc(bytes, sizeof(int), policies[p], &info);
+        }
+        if (ctx.arr == NULL) {
+            printf("%-18s allocation failed\n", name);
+            continue;
+        }
+        initialize_array(ctx.arr, size, density);
+        double touch = omp_get_wtime() - start;
+        buf_stats stats = buf_inspect(ctx.arr, bytes);
+        if (p >= 0 && policies[p].pages == BUF_PAGES_HUGETLB && !info.hugetlb) {
+            strcat(name, "*");
+        }
+        if (p >= 0 && !info.numa_ok) {
+            strcat(name, "+");
+        }
+        
+        cfg->work_ops = (double)size;
+        cfg->work_bytes = (double)bytes;
+        snprintf(record, sizeof(record), "%s count", name);
+        bench_result count = bench_run(cfg, record, bench_alloc_count, &ctx, ref_count, 0.0);
+        cfg->work_ops = (double)ctx.gathers;
+        cfg->work_bytes = (double)ctx.gathers * PERF_LINE_BYTES;
+        snprintf(record, sizeof(record), "%s gather", name);
+        bench_result gather = bench_run(cfg, record, bench_alloc_gather, &ctx, ref_gather, 0.0);
+        ref_count = count.value;
+        ref_gather = gather.value;
+        failures += !count.correct || !gather.correct;
+        
+        printf("%-18s %12.6f %12.6f %10.2f %12.6f %12.2f %10.0f  %s%s\n", name, touch, count.median,
+               bytes / count.median * 1e-9, gather.median, ctx.gathers / gather.median * 1e-6,
+               stats.huge_bytes / 1e6, buf_nodes_text(&stats, nodes, sizeof(nodes)),
+               count.correct && gather.correct ? "" : " (INCORRECT!)");
+        
+        if (p < 0) {
+            free(ctx.arr);
+        } else {
+            buf_free(ctx.arr, bytes);
+        }
+    }
+    printf("-----------------------------------------------------------------------------------------------------\n");
+    printf("* no reserved huge pages (vm.nr_hugepages), fell back to thp; + mbind not permitted, kernel default\n");
+    
+    return failures != 0;
+}
+
+/**
+ * Contention suite counters. The existing variants 3-6 cover critical,
+ * atomic, reduction and packed private counters; these add the layouts a
+ * hot shared counter can take in other code.
+ * Cache-line padded private counters: same as variant 6 without false sharing
+ */
+typedef struct {
+    long long count;
+    char pad[COUNTER_LINE - sizeof(long long)];
+} padded_counter;
+
+// Counter lines of the padded and sharded variants, allocated once by
+// run_contention so the timed runs only clear them
+static padded_counter *contention_lines;
+
+long long count3s_parallel_padded(int *arr, long long size) {
+    long long count = 0;
+    int num_threads = omp_get_max_threads();
+    padded_counter *private_counts = contention_lines;
+    memset(private_counts, 0, num_threads * sizeof(padded_counter));
+    
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        
+        #pragma omp for
+        for (long long i = 0; i < size; i++) {
+            if (arr[i] == 3) {
+                private_counts[tid].count++;
+            }
+        }
+    }
+    
+    for (int i = 0; i < num_threads; i++) {
+        count += private_counts[i].count;
+    }
+    
+    return count;
+}
+
+/**
+ * Thread-local counter in a register, added to the shared total with one
+ * atomic per thread
+ */
+long long count3s_parallel_local_atomic(int *arr, long long size) {
+    long long count = 0;
+    
+    #pragma omp parallel
+    {
+        long long local = 0;
+        
+        #pragma omp for
+        for (long long i = 0; i < size; i++) {
+            if (arr[i] == 3) {
+                local++;
+            }
+        }
+        
+        #pragma omp atomic
+        count += local;
+    }
+    
+    return count;
+}
+
+/**
+ * Sharded counter: COUNTER_SHARDS padded shared counters, thread t
+ * increments shard t % COUNTER_SHARDS atomically and readers sum the
+ * shards, so contention per line drops by the shard count
+ */
+long long count3s_parallel_sharded(int *arr, long long size) {
+    padded_counter *shards = contention_lines;
+    memset(shards, 0, COUNTER_SHARDS * sizeof(padded_counter));
+    
+    #pragma omp parallel
+    {
+        long long *shard = &shards[omp_get_thread_num() % COUNTER_SHARDS].count;
+        
+        #pragma omp for
+        for (long long i = 0; i < size; i++) {
+            if (arr[i] == 3) {
+                #pragma omp atomic
+                (*shard)++;
+            }
+        }
+    }
+    
+    long long count = 0;
+    for (int s = 0; s < COUNTER_SHARDS; s++) {
+        count += shards[s].count;
+    }
+    return count;
+}
+
+static const count3s_variant contention_variants[] = {
+    {"critical", "Critical", count3s_parallel_critical, "one lock per hit"},
+    {"atomic", "Atomic", count3s_parallel_atomic, "one shared atomic per hit"},
+    {"reduction", "Reduction", count3s_parallel_reduction, "OpenMP reduction"},
+    {"private", "Private", count3s_parallel_private, "private counters packed in one line"},
+    {"padded", "Padded", count3s_parallel_padded, "private counters one line apart"},
+    {"local+atomic", "Local+atomic", count3s_parallel_local_atomic, "register counter, one atomic per thread"},
+    {"sharded", "Sharded", count3s_parallel_sharded, "atomic per hit on one of the shards"},
+};
+#define NUM_CONTENTION_VARIANTS (int)(sizeof(contention_variants) / sizeof(contention_variants[0]))
+
+// Default densities of 3s, from no hits (pure scan) to every element a hit
+static const double contention_densities[] = {0.0, 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 1.0};
+
+/**
+ * Contention mode: count3s --contention [thread_list] [density_list] [array_size]
+ * Every counter strategy at every density of 3s (0-100%) and thread
+ * count; prints one throughput table (million elements/s) per thread
+ * count, densities down and strategies across
+ */
+int run_contention(bench_config *cfg, int argc, char *argv[]) {
+    long long threads[BENCH_MAX_LIST];
+    double densities[BENCH_MAX_LIST];
+    int nthreads = 0, ndensities = (int)(sizeof(contention_densities) / sizeof(contention_densities[0]));
+    long long size = argc > 4 ? (long long)atof(argv[4]) : CONTENTION_SIZE;
+    long long procs = omp_get_num_procs();
+    
+    if (argc > 2) {
+        nthreads = bench_parse_list(argv[2], threads, BENCH_MAX_LIST, procs);
+    } else {
+        for (long long p = 1; p < procs && nthreads < BENCH_MAX_LIST - 1; p *= 2) {
+            threads[nthreads++] = p;
+        }
+        threads[nthreads++] = procs;
+    }
+    memcpy(densities, contention_densities, sizeof(contention_densities));
+    if (argc > 3) {
+        // Densities may be 0, so bench_parse_list (positive values) does not apply
+        const char *p = argv[3];
+        ndensities = 0;
+        while (*p != '\0' && ndensities < BENCH_MAX_LIST) {
+            char *end;
+            densities[ndensities] = strtod(p, &end);
+            if (end == p || densities[ndensities] < 0.0 || densities[ndensities] > 1.0 ||
+                (*end != ',' && *end != '\0')) {
+                ndensities = 0;
+                break;
+            }
+            ndensities++;
+            p = *end == ',' ? end + 1 : end;
+        }
+    }
+    if (nthreads == 0 || ndensities == 0 || size <= 0) {
+        fprintf(stderr, "Usage: %s --contention [thread_list, e.g. 1,2,4,max] [density_list, e.g. 0,0.1,1] "
+                "[array_size]\n", argv[0]);
+        return 1;
+    }
+    
+    printf("=======================================================\n");
+    printf("Count3s - Counter Contention Suite\n");
+    printf("=======================================================\n");
+    printf("Array size: %lld elements, %d densities, %d thread counts, %d shards\n", size, ndensities, nthreads,
+           COUNTER_SHARDS);
+    for (int m = 0; m < NUM_CONTENTION_VARIANTS; m++) {
+        printf("  %-14s %s\n", contention_variants[m].name, contention_variants[m].note);
+    }
+    printf("=======================================================\n");
+    
+    // One counter line per thread of the largest team, at least one per shard
+    long long lines = COUNTER_SHARDS;
+    for (int t = 0; t < nthreads; t++) {
+        lines = threads[t] > lines ? threads[t] : lines;
+    }
+    int *arr = (int *)malloc(size * sizeof(int));
+    double *rate = (double *)malloc((size_t)nthreads * ndensities * NUM_CONTENTION_VARIANTS * sizeof(double));
+    contention_lines = (padded_counter *)aligned_alloc(COUNTER_LINE, lines * sizeof(padded_counter));
+    if (arr == NULL || rate == NULL || contention_lines == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for array\n");
+        free(arr);
+        free(rate);
+        free(contention_lines);
+        return 1;
+    }
+    
+    // Densities outermost: the array is regenerated once per density
+    int failures = 0;
+    cfg->size = size;
+    cfg->work_ops = (double)size;
+    cfg->work_bytes = (double)size * sizeof(int);
+    for (int d = 0; d < ndensities; d++) {
+        omp_set_num_threads((int)threads[nthreads - 1]);
+        initialize_array(arr, size, densities[d]);
+        double expected = (double)count3s_sequential(arr, size);
+        for (int t = 0; t < nthreads; t++) {
+            omp_set_num_threads((int)threads[t]);
+            cfg->threads = (int)threads[t];
+            for (int m = 0; m < NUM_CONTENTION_VARIANTS; m++) {
+                char name[64];
+                count3s_ctx ctx = {arr, size, contention_variants[m].count, NULL, NULL, NULL, NULL};
+                snprintf(name, sizeof(name), "%s %.0f%% %lldT", contention_variants[m].name,
+                         100.0 * densities[d], threads[t]);
+                bench_result r = bench_run(cfg, name, bench_count3s, &ctx, expected, 0.0);
+                failures += !r.correct;
+                rate[((size_t)t * ndensities + d) * NUM_CONTENTION_VARIANTS + m] = size / r.median * 1e-6;
+            }
+        }
+    }
+    
+    for (int t = 0; t < nthreads; t++) {
+        printf("\n%lld thread%s, million elements/s\n%-8s", threads[t], threads[t] == 1 ? "" : "s", "3s");
+        for (int m = 0; m < NUM_CONTENTION_VARIANTS; m++) {
+            printf(" %13s", contention_variants[m].name);
+        }
+        printf("\n");
+        for (int d = 0; d < ndensities; d++) {
+            printf("%7.1f%%", 100.0 * densities[d]);
+            for (int m = 0; m < NUM_CONTENTION_VARIANTS; m++) {
+                printf(" %13.1f", rate[((size_t)t * ndensities + d) * NUM_CONTENTION_VARIANTS + m]);
+            }
+            printf("\n");
+        }
+        
+        // Slowest density for each strategy: what a hot counter costs in the worst case
+        printf("%-8s", "worst");
+        for (int m = 0; m < NUM_CONTENTION_VARIANTS; m++) {
+            double worst = INFINITY;
+            for (int d = 0; d < ndensities; d++) {
+                double v = rate[((size_t)t * ndensities + d) * NUM_CONTENTION_VARIANTS + m];
+                worst = v < worst ? v : worst;
+            }
+            printf(" %13.1f", worst);
+        }
+        printf("\n");
+    }
+    printf("\nAll counts %s\n", failures == 0 ? "correct" : "INCORRECT!");
+    
+    free(arr);
+    free(rate);
+    free(contention_lines);
+    contention_lines = NULL;
+    return failures != 0;
 }
@@ -1,18 +1,31 @@
+/*
+ * Compile: gcc -fopenmp -O2 cyclicpi.c -o cyclicpi -lm
+ * Run: ./cyclicpi [num_steps] [threads]
+ * Midpoint-rule pi, steps dealt out cyclically: thread t takes t, t + nthreads,
+ * ... and the per-thread partial sums are added at the end.
+ * Sweep: ./cyclicpi --sweep [thread_list] [step_list]   (e.g. 1,2,4,max 1e8,1e9)
+ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <string.h>
 #include <omp.h>
+#include "bench.h"
+#include "perfcounters.h"
+#include "pikernel.h"
 
 static long num_steps = 1500000000;
 double step;
 
-int main()
-{
-    step = 1.0 / (double)num_steps;
-
-    double start_time = omp_get_wtime();
+typedef struct {
+    double *partial;
+    int rcp;
+} pi_ctx;
 
+static double compute_pi_scalar(void *ctx)
+{
+    double *partial = ((pi_ctx *)ctx)->partial;
     int max_threads = omp_get_max_threads();
-    double *partial = malloc(sizeof(double) * max_threads);
 
     #pragma omp parallel
     {
@@ -34,12 +47,90 @@ int main()
     for (int i = 0; i < max_threads; i++)
         sum += partial[i];
 
-    double pi = step * sum;
+    return step * sum;
+}
+
+// Thread tid still takes steps tid, tid + nthreads, ...; the kernel strides over them
+static double compute_pi(void *ctx)
+{
+    double *partial = ((pi_ctx *)ctx)->partial;
+    int rcp = ((pi_ctx *)ctx)->rcp;
+    int max_threads = omp_get_max_threads();
+
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        long count = tid < num_steps ? (num_steps - tid + nthreads - 1) / nthreads : 0;
+
+        partial[tid] = pi_midpoint_sum(tid, count, nthreads, step, rcp);
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < max_threads; i++)
+        sum += partial[i];
+
+    return step * sum;
+}
+
+static double compute_pi_steps(void *ctx, long long steps)
+{
+    num_steps = steps;
+    step = 1.0 / (double)num_steps;
+    return compute_pi(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--sweep") != 0) {
+        num_steps = (long)atof(argv[1]);
+        if (argc > 2)
+            omp_set_num_threads(atoi(argv[2]));
+        if (num_steps < 1) {
+            printf("Usage: %s [num_steps] [threads]\n", argv[0]);
+            return 1;
+        }
+    }
+    step = 1.0 / (double)num_steps;
+
+    int max_threads = omp_get_max_threads();
+    bench_config cfg;
+    bench_init(&cfg, "cyclicpi");
+    cfg.threads = max_threads;
+    cfg.size = num_steps;
+
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+        long long threads[BENCH_MAX_LIST], sizes[BENCH_MAX_LIST];
+        int nthreads, nsizes;
+        if (!bench_parse_sweep(argc, argv, 2, num_steps, threads, &nthreads, sizes, &nsizes))
+            return 1;
+        int sweep_threads = (int)threads[nthreads - 1];
+        if (sweep_threads < omp_get_max_threads())
+            sweep_threads = omp_get_max_threads();
+        pi_ctx sweep_ctx = {malloc(sizeof(double) * sweep_threads), 0};
+        bench_sweep(&cfg, "cyclic simd", compute_pi_steps, &sweep_ctx, threads, nthreads, sizes, nsizes, bench_weak_linear);
+        free(sweep_ctx.partial);
+        bench_finish(&cfg);
+        return 0;
+    }
+
+    pi_ctx ctx = {malloc(sizeof(double) * max_threads), 0};
+
+    perf_counters pc;
+    perf_attach(&cfg, &pc);
+    cfg.work_ops = PI_OPS_PER_STEP * num_steps;
+    bench_result s = bench_run(&cfg, "cyclic", compute_pi_scalar, &ctx, M_PI, 1e-10);
+    bench_result r = bench_run(&cfg, "cyclic simd", compute_pi, &ctx, M_PI, 1e-10);
+    ctx.rcp = 1;
+    bench_result q = bench_run(&cfg, "cyclic simd rcp", compute_pi, &ctx, M_PI, 1e-10);
+    perf_detach(&pc);
 
-    printf("Approximation of Pi (cyclic): %.10f\n", pi);
+    printf("Approximation of Pi (cyclic): %.10f\n", r.value);
     printf("Threads used: %d\n", max_threads);
-    printf("Time taken: %f seconds\n", omp_get_wtime() - start_time);
+    printf("Time taken: %f seconds (scalar %f, reciprocal %f)\n", r.median, s.median, q.median);
+    printf("SIMD speedup over scalar: %.2fx, %.2fx with reciprocal\n", s.median / r.median, s.median / q.median);
 
-    free(partial);
-    return 0;
+    free(ctx.partial);
+    bench_finish(&cfg);
+    return cfg.failures != 0;
 }
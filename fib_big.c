@@ -0,0 +1,258 @@
+/*
+ * Arbitrary-precision Fibonacci numbers by fast doubling
+ *
+ * From F(k) and F(k+1):
+ *   F(2k)   = F(k) * (2 F(k+1) - F(k))
+ *   F(2k+1) = F(k)^2 + F(k+1)^2
+ * so F(n) takes log2(n) steps of three independent multiplications,
+ * walking the bits of n from the top. The three products of a step run as
+ * OpenMP tasks once the operands reach BN_TASK_LIMBS limbs, and each
+ * Karatsuba product splits into further tasks (see bignum.h).
+ *
+ * The result is validated against fib_serial (the recursive routine of
+ * fib_tasks.c) and an iterative 64-bit loop for small n, and the Karatsuba
+ * product against schoolbook multiplication on random operands. Reports
+ * digits per second and the speedup over one thread.
+ *
+ * Compile: gcc -fopenmp -O2 fib_big.c -o fib_big -lm
+ * Run: ./fib_big [n] [threads]    (default n = 10000000, about 2.1M digits)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "bench.h"
+#include "bignum.h"
+
+#define DEFAULT_N 10000000L
+#define RECURSIVE_CHECK_MAX 30    // fib_serial is exponential
+#define U64_CHECK_MAX 93          // F(93) is the last that fits in 64 bits
+#define CHECKSUM_MODULUS 1000000007ULL
+#define DOUBLE_DIGITS 15     // Significant decimal digits a double carries
+
+long fib_serial(long n)
+{
+    if (n < 2)
+        return n;
+    return fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+/**
+ * F(n) into result by fast doubling. Call inside a parallel region (from
+ * one thread) for the products to run as tasks.
+ */
+void fib_fast_doubling(bignum *result, unsigned long n) {
+    bignum a, b, t, c, a2, b2;
+    bn_init(&a);
+    bn_init(&b);
+    bn_init(&t);
+    bn_init(&c);
+    bn_init(&a2);
+    bn_init(&b2);
+    bn_set_u64(&a, 0);   // F(k), k = 0
+    bn_set_u64(&b, 1);   // F(k+1)
+
+    int bit = 63;
+    while (bit >= 0 && !((n >> bit) & 1)) {
+        bit--;
+    }
+    for (; bit >= 0; bit--) {
+        // t = 2 F(k+1) - F(k); c = F(2k); a2 + b2 = F(2k+1)
+        bn_shl1(&t, &b);
+        bn_sub(&t, &t, &a);
+        if (a.len >= BN_TASK_LIMBS) {
+            #pragma omp task shared(c, a, t)
+            bn_mul(&c, &a, &t);
+            #pragma omp task shared(a2, a)
+            bn_mul(&a2, &a, &a);
+            bn_mul(&b2, &b, &b);
+            #pragma omp taskwait
+        } else {
+            bn_mul(&c, &a, &t);
+            bn_mul(&a2, &a, &a);
+            bn_mul(&b2, &b, &b);
+        }
+        bn_add(&a2, &a2, &b2);
+
+        if ((n >> bit) & 1) {
+            // k -> 2k + 1: (F(2k+1), F(2k) + F(2k+1))
+            bn_copy(&a, &a2);
+            bn_add(&b, &c, &a2);
+        } else {
+            // k -> 2k: (F(2k), F(2k+1))
+            bn_copy(&a, &c);
+            bn_copy(&b, &a2);
+        }
+    }
+
+    bn_copy(result, &a);
+    bn_free(&a);
+    bn_free(&b);
+    bn_free(&t);
+    bn_free(&c);
+    bn_free(&a2);
+    bn_free(&b2);
+}
+
+typedef struct {
+    unsigned long n;
+    bignum result;
+} fib_ctx;
+
+// Returns F(n) mod CHECKSUM_MODULUS so runs can be compared
+static double bench_fib_big(void *c) {
+    fib_ctx *x = (fib_ctx *)c;
+    #pragma omp parallel
+    #pragma omp single
+    fib_fast_doubling(&x->result, x->n);
+    return (double)bn_mod_u64(&x->result, CHECKSUM_MODULUS);
+}
+
+static uint64_t next_random(uint64_t *state) {
+    uint64_t x = (*state += 0x9E3779B97F4A7C15ULL);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Validate against fib_serial and a 64-bit loop for small n, and the
+ * Karatsuba/task product against schoolbook on random operands.
+ * Returns the number of failures.
+ */
+int validate(void) {
+    int failures = 0;
+    bignum f;
+    bn_init(&f);
+
+    uint64_t prev = 0, cur = 1;   // F(k), F(k+1)
+    for (unsigned long k = 0; k <= U64_CHECK_MAX; k++) {
+        fib_fast_doubling(&f, k);
+        uint64_t got = f.len == 0 ? 0 : f.limb[0];
+        int bad = f.len > 1 || got != prev;
+        if (k <= RECURSIVE_CHECK_MAX) {
+            bad |= got != (uint64_t)fib_serial((long)k);
+        }
+        if (bad) {
+            printf("Mismatch at F(%lu)\n", k);
+            failures++;
+        }
+        uint64_t next = prev + cur;
+        prev = cur;
+        cur = next;
+    }
+
+    uint64_t state = 42;
+    size_t sizes[] = {BN_KARATSUBA_LIMBS + 1, 100, 777, BN_TASK_LIMBS + 5};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t n = sizes[s];
+        bignum a, b, r;
+        bn_init(&a);
+        bn_init(&b);
+        bn_init(&r);
+        bn_reserve(&a, n);
+        bn_reserve(&b, n);
+        for (size_t i = 0; i < n; i++) {
+            a.limb[i] = next_random(&state);
+            b.limb[i] = next_random(&state);
+        }
+        a.len = b.len = n;
+        bn_normalize(&a);
+        bn_normalize(&b);
+
+        #pragma omp parallel
+        #pragma omp single
+        bn_mul(&r, &a, &b);
+
+        uint64_t *expect = (uint64_t *)malloc(2 * n * sizeof(uint64_t));
+        bn_mul_schoolbook(expect, a.limb, b.limb, n);
+        size_t len = 2 * n;
+        while (len > 0 && expect[len - 1] == 0) {
+            len--;
+        }
+        if (len != r.len || memcmp(expect, r.limb, len * sizeof(uint64_t)) != 0) {
+            printf("Karatsuba product mismatch at %zu limbs\n", n);
+            failures++;
+        }
+        free(expect);
+        bn_free(&a);
+        bn_free(&b);
+        bn_free(&r);
+    }
+
+    bn_free(&f);
+    return failures;
+}
+
+int main(int argc, char **argv) {
+    long n = argc > 1 ? (long)atof(argv[1]) : DEFAULT_N;
+    if (argc > 2) {
+        omp_set_num_threads(atoi(argv[2]));
+    }
+    int threads = omp_get_max_threads();
+    if (n < 0) {
+        printf("Usage: %s [n] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    // Before any output: in csv/json mode the records own stdout
+    bench_config cfg;
+    bench_init(&cfg, "fib_big");
+    cfg.size = n;
+
+    int failures = validate();
+    printf("Validation (n <= %d, Karatsuba vs schoolbook): %s\n", U64_CHECK_MAX,
+           failures == 0 ? "passed" : "FAILED");
+
+    fib_ctx ctx = {(unsigned long)n, {NULL, 0, 0}};
+    double digits = 1.0;
+
+    omp_set_num_threads(1);
+    cfg.threads = 1;
+    bench_result one = bench_run(&cfg, "fast doubling 1 thread", bench_fib_big, &ctx, NAN, 0.0);
+    if (n > 0) {
+        // Digits of F(n) = floor(log10 F(n)) + 1
+        digits = floor(bn_log10(&ctx.result)) + 1.0;
+    }
+
+    bench_result many = one;
+    if (threads > 1) {
+        omp_set_num_threads(threads);
+        cfg.threads = threads;
+        char name[48];
+        snprintf(name, sizeof(name), "fast doubling %d threads", threads);
+        many = bench_run(&cfg, name, bench_fib_big, &ctx, one.value, 0.0);
+    }
+
+    // Leading digits from the logarithm, trailing digits from a remainder.
+    // The integer part of lg takes ceil(log10(lg)) of the double's digits
+    // and one more is kept as a guard, so only the rest are shown.
+    double lg = bn_log10(&ctx.result);
+    int lead_digits = DOUBLE_DIGITS - 1 - (lg > 1.0 ? (int)ceil(log10(lg)) : 0);
+    if (lead_digits > digits) {
+        lead_digits = (int)digits;
+    }
+    double lead = n == 0 ? 0.0 : floor(pow(10.0, lg - floor(lg) + lead_digits - 1));
+    uint64_t tail = bn_mod_u64(&ctx.result, 10000000000000000000ULL);
+
+    if (digits <= 19) {
+        printf("F(%ld) = %llu\n", n, (unsigned long long)tail);
+    } else {
+        printf("F(%ld) has %.0f digits: %.0f...%019llu\n", n, digits, lead, (unsigned long long)tail);
+    }
+    printf("%-10s %12s %16s %10s\n", "Threads", "Time (s)", "Digits/s", "Speedup");
+    printf("------------------------------------------------------\n");
+    printf("%-10d %12.6f %16.3e %9.2fx\n", 1, one.median, digits / one.median, 1.0);
+    if (threads > 1) {
+        printf("%-10d %12.6f %16.3e %9.2fx\n", threads, many.median, digits / many.median,
+               one.median / many.median);
+    }
+    if (!many.correct) {
+        printf("Warning: parallel result differs from the single-threaded one\n");
+    }
+
+    bn_free(&ctx.result);
+    bench_finish(&cfg);
+    return failures != 0 || cfg.failures != 0;
+}
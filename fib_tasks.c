@@ -1,7 +1,44 @@
+/*
+ * Compile: gcc -fopenmp -O2 fib_tasks.c -o fib_tasks -lm
+ * Run: ./fib_tasks [n] [cutoff | auto | depth | scan] [threads]
+ *   cutoff  numeric >= 2: tasks for n >= cutoff, serial below (default 20)
+ *   auto    measure task overhead and serial leaf cost, pick the cutoff
+ *   depth   spawn tasks only in the top log2(threads) + FIB_EXTRA_DEPTH levels
+ *   scan    every cutoff from FIB_SCAN_MIN to n - 1, plus depth and auto
+ * Every setting gets one extra instrumented run with per-thread counters:
+ * tasks created and executed, leaf (serial) time and time in taskwait.
+ */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <omp.h>
+#include "bench.h"
+
+#define FIB_MAX_N 92                 // F(93) overflows long
+#define FIB_MAX_THREADS 256
+#define FIB_EXTRA_DEPTH 4            // Depth mode: about 2^4 tasks per thread
+#define FIB_SCAN_MIN 2
+#define FIB_OVERHEAD_TARGET 0.02     // Auto: task overhead at most 2% of a leaf's work
+#define FIB_TASKS_PER_THREAD 16      // Auto: at least this many leaf tasks per thread
+#define FIB_PROBE_DEPTH 14           // Empty task tree for the overhead probe
+#define FIB_LEAF_PROBE 25
 
 int cutoff = 20;
+int depth_cutoff = 0;   // > 0: tasks only above this depth, cutoff unused
+int instrument = 0;     // Count and time into stats[] (separate runs)
+
+// Per-thread counters, padded to a cache line each
+typedef struct {
+    long long created;
+    long long executed;
+    long long leaves;
+    double leaf_time;
+    double taskwait_time;  // Includes tasks the thread ran while waiting
+    char pad[64 - 3 * sizeof(long long) - 2 * sizeof(double)];
+} __attribute__((aligned(64))) task_stats;
+
+static task_stats stats[FIB_MAX_THREADS];
 
 long fib_serial(long n)
 {
@@ -10,71 +47,266 @@ long fib_serial(long n)
     return fib_serial(n - 1) + fib_serial(n - 2);
 }
 
-long fib_parallel(long n)
+static long fib_leaf(long n)
+{
+    if (!instrument)
+        return fib_serial(n);
+
+    task_stats *s = &stats[omp_get_thread_num()];
+    double start = omp_get_wtime();
+    long r = fib_serial(n);
+    s->leaf_time += omp_get_wtime() - start;
+    s->leaves++;
+    return r;
+}
+
+long fib_parallel(long n, int depth)
 {
     long x, y;
 
-    if (n < cutoff)
+    if (depth_cutoff > 0 ? depth >= depth_cutoff || n < 2 : n < cutoff)
     {
-        return fib_serial(n);
+        return fib_leaf(n);
     }
 
-#pragma omp task shared(x) firstprivate(n)
+    if (instrument)
+        stats[omp_get_thread_num()].created += 2;
+
+#pragma omp task shared(x) firstprivate(n, depth)
     {
-        x = fib_parallel(n - 1);
+        if (instrument)
+            stats[omp_get_thread_num()].executed++;
+        x = fib_parallel(n - 1, depth + 1);
     }
 
-#pragma omp task shared(y) firstprivate(n)
+#pragma omp task shared(y) firstprivate(n, depth)
     {
-        y = fib_parallel(n - 2);
+        if (instrument)
+            stats[omp_get_thread_num()].executed++;
+        y = fib_parallel(n - 2, depth + 1);
     }
 
+    // Tied tasks resume on the same thread, so the slot stays valid
+    double start = instrument ? omp_get_wtime() : 0.0;
 #pragma omp taskwait
+    if (instrument)
+        stats[omp_get_thread_num()].taskwait_time += omp_get_wtime() - start;
     return x + y;
 }
 
-int main()
+static double bench_fib_serial(void *ctx)
 {
-    long n = 40;
+    return (double)fib_serial(*(long *)ctx);
+}
 
-    double serial_start = omp_get_wtime();
-    long serial_result = fib_serial(n);
-    double serial_time = omp_get_wtime() - serial_start;
+static double bench_fib_parallel(void *ctx)
+{
+    long n = *(long *)ctx;
+    long result;
 
-    fprintf(stderr, "Serial result for n=%ld: %ld\n", n, serial_result);
-    fprintf(stderr, "Serial time: %f seconds\n", serial_time);
+#pragma omp parallel
+    {
+#pragma omp single
+        {
+            result = fib_parallel(n, 0);
+        }
+    }
 
-    long parallel_result;
-    double parallel_start, parallel_time;
+    return (double)result;
+}
 
-    parallel_start = omp_get_wtime(
+// Leaf tasks the recursion creates for n with the current cutoff
+static double count_leaves(long n, int c)
+{
+    double leaves[FIB_MAX_N + 1];
+    for (long k = 0; k <= n; k++)
+        leaves[k] = k < c || k < 2 ? 1.0 : leaves[k - 1] + leaves[k - 2];
+    return leaves[n];
+}
 
-        
-    );
+// Empty binary task tree of the given depth, shaped like fib_parallel
+static void empty_tree(int depth)
+{
+    if (depth == 0)
+        return;
+#pragma omp task firstprivate(depth)
+    empty_tree(depth - 1);
+#pragma omp task firstprivate(depth)
+    empty_tree(depth - 1);
+#pragma omp taskwait
+}
 
+static double bench_empty_tree(void *ctx)
+{
+    (void)ctx;
 #pragma omp parallel
     {
 #pragma omp single
-        {
-            parallel_result = fib_parallel(n);
-        }
+        empty_tree(FIB_PROBE_DEPTH);
     }
+    return 0.0;
+}
 
-    parallel_time = omp_get_wtime() - parallel_start;
+static double bench_leaf_probe(void *ctx)
+{
+    (void)ctx;
+    return (double)fib_serial(FIB_LEAF_PROBE);
+}
 
-    fprintf(stderr, "Parallel result for n=%ld: %ld\n", n, parallel_result);
-    fprintf(stderr, "Parallel time: %f seconds\n", parallel_time);
+/*
+ * Pick the cutoff from two measurements:
+ *   o  CPU time per task (spawn, steal, taskwait) from an empty task tree
+ *   c  time per fib_serial call
+ * A leaf task below cutoff k does calls(k) = 2 F(k+1) - 1 calls, so the
+ * smallest k with o <= FIB_OVERHEAD_TARGET * calls(k) * c keeps overhead
+ * low; k is then lowered until there are FIB_TASKS_PER_THREAD leaf tasks
+ * per thread for load balance.
+ */
+int autotune_cutoff(bench_config *cfg, long n, int threads)
+{
+    double tree_tasks = pow(2.0, FIB_PROBE_DEPTH + 1) - 2.0;
+    double overhead = bench_median(cfg, bench_empty_tree, NULL) * threads / tree_tasks;
+    double leaf_calls = 2.0 * fib_serial(FIB_LEAF_PROBE + 1) - 1.0;
+    double call_cost = bench_median(cfg, bench_leaf_probe, NULL) / leaf_calls;
 
-    if (serial_result == parallel_result)
+    int k = 2;
+    while (k < n && overhead > FIB_OVERHEAD_TARGET * (2.0 * fib_serial(k + 1) - 1.0) * call_cost)
+        k++;
+    int by_overhead = k;
+    while (k > 2 && count_leaves(n, k) < (double)FIB_TASKS_PER_THREAD * threads)
+        k--;
+
+    fprintf(stderr, "Auto-tune: %.1f ns per task, %.2f ns per serial call; "
+            "cutoff %d for <= %.0f%% overhead, %d for >= %d leaf tasks per thread\n",
+            overhead * 1e9, call_cost * 1e9, by_overhead, FIB_OVERHEAD_TARGET * 100, k,
+            FIB_TASKS_PER_THREAD);
+    return k;
+}
+
+typedef struct {
+    char name[24];
+    double time;
+    long long created, executed_min, executed_max, leaves;
+    double leaf_time, taskwait_time, balance;
+} setting_row;
+
+// Timed runs without counters, then one instrumented run for the counters
+static setting_row run_setting(bench_config *cfg, const char *name, long n, long expected, int threads)
+{
+    setting_row row;
+    memset(&row, 0, sizeof(row));
+    snprintf(row.name, sizeof(row.name), "%s", name);
+    row.time = bench_run(cfg, name, bench_fib_parallel, &n, (double)expected, 0.0).median;
+
+    memset(stats, 0, sizeof(stats));
+    instrument = 1;
+    bench_fib_parallel(&n);
+    instrument = 0;
+
+    double max_leaf = 0.0;
+    row.executed_min = stats[0].executed;
+    for (int t = 0; t < threads; t++)
+    {
+        row.created += stats[t].created;
+        row.leaves += stats[t].leaves;
+        row.leaf_time += stats[t].leaf_time;
+        row.taskwait_time += stats[t].taskwait_time;
+        row.executed_min = stats[t].executed < row.executed_min ? stats[t].executed : row.executed_min;
+        row.executed_max = stats[t].executed > row.executed_max ? stats[t].executed : row.executed_max;
+        max_leaf = stats[t].leaf_time > max_leaf ? stats[t].leaf_time : max_leaf;
+    }
+    // Busiest thread's leaf work relative to the mean, 1.0 is perfect
+    row.balance = row.leaf_time > 0.0 ? max_leaf / (row.leaf_time / threads) : 1.0;
+    return row;
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 40;
+    const char *mode = argc > 2 ? argv[2] : "20";
+    if (argc > 3)
+        omp_set_num_threads(atoi(argv[3]));
+    int threads = omp_get_max_threads();
+    int scan = strcmp(mode, "scan") == 0;
+    int named = scan || strcmp(mode, "depth") == 0 || strcmp(mode, "auto") == 0;
+    if (!named)
+        cutoff = atoi(mode);
+
+    // A cutoff below 2 would let fib_parallel(1) spawn fib_parallel(-1)
+    if (n < 0 || n > FIB_MAX_N || threads > FIB_MAX_THREADS || (!named && cutoff < 2))
     {
-        fprintf(stderr, "Results match ✔️\n");
+        printf("Usage: %s [n <= %d] [cutoff >= 2 | auto | depth | scan] [threads <= %d]\n", argv[0],
+               FIB_MAX_N, FIB_MAX_THREADS);
+        return 1;
     }
-    else
+
+    bench_config cfg;
+    bench_init(&cfg, "fib_tasks");
+    cfg.threads = threads;
+    cfg.size = n;
+
+    bench_result serial = bench_run(&cfg, "serial", bench_fib_serial, &n, NAN, 0.0);
+    long serial_result = (long)serial.value;
+
+    fprintf(stderr, "Serial result for n=%ld: %ld\n", n, serial_result);
+    fprintf(stderr, "Serial time: %f seconds\n", serial.median);
+
+    int depth_levels = FIB_EXTRA_DEPTH;
+    for (int p = 1; p < threads; p *= 2)
+        depth_levels++;
+
+    setting_row rows[FIB_MAX_N + 3];
+    int nrows = 0;
+    char name[24];
+
+    if (scan)
+    {
+        for (int c = FIB_SCAN_MIN; c < n; c++)
+        {
+            cutoff = c;
+            snprintf(name, sizeof(name), "cutoff %d", c);
+            rows[nrows++] = run_setting(&cfg, name, n, serial_result, threads);
+        }
+    }
+    if (scan || strcmp(mode, "depth") == 0)
+    {
+        depth_cutoff = depth_levels;
+        snprintf(name, sizeof(name), "depth %d", depth_levels);
+        rows[nrows++] = run_setting(&cfg, name, n, serial_result, threads);
+        depth_cutoff = 0;
+    }
+    if (scan || strcmp(mode, "auto") == 0)
+    {
+        cutoff = autotune_cutoff(&cfg, n, threads);
+        snprintf(name, sizeof(name), "auto %d", cutoff);
+        rows[nrows++] = run_setting(&cfg, name, n, serial_result, threads);
+    }
+    if (!named)
+    {
+        snprintf(name, sizeof(name), "cutoff %d", cutoff);
+        rows[nrows++] = run_setting(&cfg, name, n, serial_result, threads);
+    }
+
+    // Overhead: share of the thread time not spent in leaf work against the serial run
+    fprintf(stderr, "\n%-12s %10s %8s %10s %15s %9s %11s %8s\n", "Setting", "Time (s)", "Speedup", "Tasks",
+            "Executed/thread", "Overhead", "Taskwait(s)", "Balance");
+    fprintf(stderr, "----------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < nrows; i++)
     {
-        fprintf(stderr, "Results DO NOT MATCH ❌\n");
+        setting_row *r = &rows[i];
+        char executed[32];
+        snprintf(executed, sizeof(executed), "%lld-%lld", r->executed_min, r->executed_max);
+        fprintf(stderr, "%-12s %10.6f %7.2fx %10lld %15s %8.1f%% %11.4f %8.2f\n", r->name, r->time,
+                serial.median / r->time, r->created, executed,
+                100.0 * (1.0 - serial.median / (threads * r->time)), r->taskwait_time, r->balance);
     }
+    fprintf(stderr, "Taskwait time includes tasks a thread ran while waiting; balance is the busiest\n"
+            "thread's leaf time over the mean (1.00 = even)\n");
 
-    printf("%f\n", parallel_time);
+    double parallel_median = rows[nrows - 1].time;
+    fprintf(stderr, "Parallel time: %f seconds\n", parallel_median);
+    printf("%f\n", parallel_median);
 
-    return 0;
+    bench_finish(&cfg);
+    return cfg.failures != 0;
 }
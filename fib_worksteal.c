@@ -0,0 +1,202 @@
+/*
+ * fib_parallel from fib_tasks.c on the work-stealing runtime of
+ * worksteal.h, head to head with the #pragma omp task version
+ *
+ * Both versions use the same cutoff and create the same tasks: one per
+ * call with n >= cutoff for each of the two subproblems in OpenMP, one per
+ * call in the runtime (the second subproblem runs on the spawning worker,
+ * work-first). Per thread count the table lists time, spawn rate
+ * (tasks/s), the runtime's steals, failed steal attempts and the share of
+ * spawned tasks that were popped back and run by their spawner.
+ *
+ * Compile: gcc -fopenmp -O2 -pthread fib_worksteal.c -o fib_worksteal -lm
+ * Run: ./fib_worksteal [n] [cutoff] [thread_list]   (default 35 15 1,2,4,...,max)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <omp.h>
+#include "bench.h"
+#include "worksteal.h"
+
+int cutoff = 15;
+
+long fib_serial(long n)
+{
+    if (n < 2)
+        return n;
+    return fib_serial(n - 1) + fib_serial(n - 2);
+}
+
+/* OpenMP version, as in fib_tasks.c */
+
+long fib_parallel(long n)
+{
+    long x, y;
+
+    if (n < cutoff)
+    {
+        return fib_serial(n);
+    }
+
+#pragma omp task shared(x) firstprivate(n)
+    {
+        x = fib_parallel(n - 1);
+    }
+
+#pragma omp task shared(y) firstprivate(n)
+    {
+        y = fib_parallel(n - 2);
+    }
+
+#pragma omp taskwait
+    return x + y;
+}
+
+static double bench_fib_omp(void *ctx)
+{
+    long n = *(long *)ctx;
+    long result;
+
+#pragma omp parallel
+    {
+#pragma omp single
+        {
+            result = fib_parallel(n);
+        }
+    }
+
+    return (double)result;
+}
+
+/* Work-stealing version: data[0] = n, data[1] = F(n) */
+
+static void fib_ws_task(ws_worker *w, ws_task *t);
+
+long fib_ws(ws_worker *w, long n)
+{
+    if (n < cutoff)
+    {
+        return fib_serial(n);
+    }
+
+    ws_task *t = ws_alloc(w);
+    t->fn = fib_ws_task;
+    t->data[0] = n - 1;
+    ws_spawn(w, t);
+
+    long y = fib_ws(w, n - 2);
+
+    ws_sync(w, t);
+    long x = t->data[1];
+    ws_release(w, t);
+    return x + y;
+}
+
+static void fib_ws_task(ws_worker *w, ws_task *t)
+{
+    t->data[1] = fib_ws(w, t->data[0]);
+}
+
+typedef struct
+{
+    ws_runtime *rt;
+    long n;
+} ws_ctx;
+
+static double bench_fib_ws(void *c)
+{
+    ws_ctx *x = (ws_ctx *)c;
+    ws_task root;
+    root.fn = fib_ws_task;
+    root.data[0] = x->n;
+    ws_runtime_run(x->rt, &root);
+    return (double)root.data[1];
+}
+
+// Tasks the OpenMP version creates: two per call with n >= cutoff
+static double count_omp_tasks(long n)
+{
+    double calls[128];
+    for (long k = 0; k <= n; k++)
+        calls[k] = k < cutoff || k < 2 ? 0.0 : 1.0 + calls[k - 1] + calls[k - 2];
+    return 2.0 * calls[n];
+}
+
+int main(int argc, char **argv)
+{
+    long n = argc > 1 ? atol(argv[1]) : 35;
+    cutoff = argc > 2 ? atoi(argv[2]) : cutoff;
+    long long threads[BENCH_MAX_LIST];
+    int nthreads;
+    if (argc > 3)
+    {
+        nthreads = bench_parse_list(argv[3], threads, BENCH_MAX_LIST, omp_get_num_procs());
+    }
+    else
+    {
+        nthreads = 0;
+        for (long long p = 1; p < omp_get_num_procs(); p *= 2)
+            threads[nthreads++] = p;
+        threads[nthreads++] = omp_get_num_procs();
+    }
+    if (n < 0 || n > 92 || cutoff < 2 || nthreads == 0)
+    {
+        printf("Usage: %s [n <= 92] [cutoff >= 2] [thread_list]\n", argv[0]);
+        return 1;
+    }
+
+    bench_config cfg;
+    bench_init(&cfg, "fib_worksteal");
+    cfg.size = n;
+
+    long expected = fib_serial(n);
+    double omp_tasks = count_omp_tasks(n);
+    printf("fib(%ld) = %ld, cutoff %d, %.0f tasks per run\n", n, expected, cutoff, omp_tasks);
+
+    double omp_time[BENCH_MAX_LIST], ws_time[BENCH_MAX_LIST];
+    ws_stats ws[BENCH_MAX_LIST];
+    for (int i = 0; i < nthreads; i++)
+    {
+        int p = (int)threads[i];
+        char name[48];
+        cfg.threads = p;
+
+        omp_set_num_threads(p);
+        snprintf(name, sizeof(name), "omp tasks %d", p);
+        omp_time[i] = bench_run(&cfg, name, bench_fib_omp, &n, (double)expected, 0.0).median;
+
+        ws_runtime rt;
+        if (ws_runtime_init(&rt, p) != 0)
+        {
+            fprintf(stderr, "Error: Failed to start the work-stealing runtime\n");
+            return 1;
+        }
+        ws_ctx ctx = {&rt, n};
+        snprintf(name, sizeof(name), "work stealing %d", p);
+        ws_time[i] = bench_run(&cfg, name, bench_fib_ws, &ctx, (double)expected, 0.0).median;
+
+        // Counters of one separate run
+        ws_runtime_reset_stats(&rt);
+        bench_fib_ws(&ctx);
+        ws[i] = ws_runtime_total_stats(&rt);
+        ws_runtime_destroy(&rt);
+    }
+
+    printf("\n%8s | %12s %14s | %12s %14s %10s %12s %8s\n", "Threads", "OpenMP (s)", "Tasks/s",
+           "Runtime (s)", "Tasks/s", "Steals", "Failed", "Inline");
+    printf("-------------------------------------------------------------------------------------------------\n");
+    for (int i = 0; i < nthreads; i++)
+    {
+        printf("%8lld | %12.6f %14.3e | %12.6f %14.3e %10lld %12lld %7.1f%%\n", threads[i], omp_time[i],
+               omp_tasks / omp_time[i], ws_time[i], ws[i].spawns / ws_time[i], ws[i].steals,
+               ws[i].failed_steals, ws[i].spawns > 0 ? 100.0 * ws[i].inline_pops / ws[i].spawns : 0.0);
+    }
+    printf("Speedup of the runtime over OpenMP tasks:");
+    for (int i = 0; i < nthreads; i++)
+        printf(" %lldT %.2fx", threads[i], omp_time[i] / ws_time[i]);
+    printf("\n");
+
+    bench_finish(&cfg);
+    return cfg.failures != 0;
+}
@@ -1,63 +1,922 @@
+/*
+ * Matrix multiplication C = A * B
+ *
+ * Two implementations are timed against each other:
+ * 1. Naive i-j-k triple loop (the original version, kept as reference)
+ * 2. Blocked GEMM: packed panels of A and B, L1/L2/L3 cache blocking,
+ *    a register-tiled MR x NR micro-kernel and OpenMP parallelism over
+ *    the macro-tiles of C
+ *
+ * All matrices are row-major with runtime sizes: A is M x K, B is K x N,
+ * C is M x N.
+ *
+ * Every variant declares its flops and compulsory bytes, so BENCH_COUNTERS=1
+ * also places it on the roofline.
+ *
+ * Compile: gcc -fopenmp -O3 -march=native matmul.c -o matmul -lm
+ * Run: ./matmul [N] [threads]          (square, default N = 700)
+ *      ./matmul M N K [threads]
+ *      ./matmul --sweep [thread_list] [N_list]   (e.g. 1,2,4,max 1024,4096)
+ *      ./matmul --strassen [N] [threads] [leaf]  (default N = 4096, leaf 256)
+ *      ./matmul --alloc [N] [threads]            (default N = 2048)
+ *
+ * Sweep mode allocates and initializes the largest matrices once and runs
+ * strong- and weak-scaling series of the blocked GEMM on square sizes;
+ * weak scaling grows N with the cube root of the thread count.
+ *
+ * Strassen mode times the Strassen-Winograd recursion (7 half-size
+ * products and 15 additions per level) against the blocked GEMM, reporting
+ * GFLOP/s-equivalent (2 N^3 / time) and the difference from the classical
+ * result. The top levels run their 7 products as OpenMP tasks, the levels
+ * below recurse serially with two temporaries each, and subproblems of at
+ * most leaf rows go to a serial version of the blocked kernel. N is padded
+ * with zeros to leaf' * 2^levels for the smallest leaf' <= leaf, and all
+ * temporaries come from one workspace arena allocated before the recursion;
+ * task levels are dropped while that arena would exceed free memory.
+ *
+ * The matrices of the default mode come from bufalloc.h (policy from
+ * BUF_PAGES / BUF_NUMA, default transparent huge pages with parallel first
+ * touch) and init_matrices runs in parallel over rows. Alloc mode times
+ * the blocked GEMM with A, B and C under each page-size/NUMA policy.
+ */
+
 #include <omp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <unistd.h>
+#include "bench.h"
+#include "perfcounters.h"
+#include "bufalloc.h"
 
-#define N 700
-#define THREADS 2
-int main(int argc, char **argv)
+#define DEFAULT_N 700
+
+// Register tile of the micro-kernel (MR rows of A x NR columns of B)
+#define MR 6
+#define NR 8
+
+// Cache blocking: MC x KC block of A stays in L2, KC x NR sliver of B in L1,
+// KC x NC panel of B in L3. MC must be a multiple of MR, NC of NR.
+#define MC 144
+#define KC 256
+#define NC 4096
+
+// Columns of C per parallel macro-tile (multiple of NR)
+#define NB 256
+
+// The naive loop is only timed when the problem is small enough to finish
+// in reasonable time; larger runs are verified on sampled entries instead.
+#define NAIVE_MAX_FLOP 2e10
+#define NUM_SAMPLES 1000
+
+// Strassen: default N and leaf size, task-parallel levels at most (each
+// task level holds 11 quarter-size temporaries per node)
+#define STRASSEN_N 4096
+#define STRASSEN_LEAF 256
+#define STRASSEN_MAX_TASK_LEVELS 2
+
+// Allocation mode: default N (three 32 MB matrices)
+#define ALLOC_N 2048
+
+typedef double v4d __attribute__((vector_size(32)));
+typedef double v4du __attribute__((vector_size(32), aligned(8)));
+
+// Without -march the 4-wide vectors would be split into SSE2 pairs and the
+// tile spilled; compile the kernel and packing for AVX2/AVX-512 as well and
+// pick the variant at load time
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define GEMM_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define GEMM_CLONES
+#endif
+
+void init_matrices(double *a, double *b, long m, long n, long k);
+int matmul_naive(const double *a, const double *b, double *c, long m, long n, long k);
+int matmul_blocked(const double *a, const double *b, double *c, long m, long n, long k);
+int matmul_strassen(const double *a, const double *b, double *c, long m, long n, long k);
+double max_rel_error(const double *c, const double *ref, long count);
+double sampled_rel_error(const double *a, const double *b, const double *c,
+                         long m, long n, long k, int samples);
+
+// Strassen recursion shape for n: levels, leaf' <= strassen_leaf and the padded size
+typedef struct {
+    int levels, task_levels;
+    long leaf, padded;
+    size_t workspace;     // Doubles
+} strassen_plan;
+
+static long strassen_leaf = STRASSEN_LEAF;
+static strassen_plan plan_strassen(long n, int threads);
+
+// Benchmark context: operands, output and the implementation under test
+typedef struct {
+    const double *a, *b;
+    double *c;
+    long m, n, k;
+    int (*multiply)(const double *, const double *, double *, long, long, long);
+    int failed;           // Set when a run could not allocate its buffers
+} matmul_ctx;
+
+static double bench_matmul(void *ctx)
 {
-    int i, j, k;
-    double sum = 0.0;
-    
-    // Allocate matrices on heap instead of stack to avoid segmentation fault
-    double (*a)[N] = malloc(N * N * sizeof(double));
-    double (*b)[N] = malloc(N * N * sizeof(double));
-    double (*c)[N] = malloc(N * N * sizeof(double));
-    
+    matmul_ctx *x = (matmul_ctx *)ctx;
+    x->failed |= x->multiply(x->a, x->b, x->c, x->m, x->n, x->k) != 0;
+    return 0.0;
+}
+
+/* Square N x N product on the leading part of the (largest) buffers */
+static double sweep_matmul(void *ctx, long long size)
+{
+    matmul_ctx *x = (matmul_ctx *)ctx;
+    x->failed |= x->multiply(x->a, x->b, x->c, size, size, size) != 0;
+    return 0.0;
+}
+
+/* GEMM work grows with N^3, so N scales with the cube root of p / pmax */
+static long long weak_size_cubic(long long size, int p, int pmax)
+{
+    return (long long)(size * cbrt((double)p / pmax) + 0.5);
+}
+
+static int run_sweep(int argc, char **argv)
+{
+    long long threads[BENCH_MAX_LIST], sizes[BENCH_MAX_LIST];
+    int nthreads, nsizes;
+    if (!bench_parse_sweep(argc, argv, 2, DEFAULT_N, threads, &nthreads, sizes, &nsizes))
+        return 1;
+
+    long max_n = sizes[nsizes - 1];
+    double *a = malloc(max_n * max_n * sizeof(double));
+    double *b = malloc(max_n * max_n * sizeof(double));
+    double *c = malloc(max_n * max_n * sizeof(double));
     if (a == NULL || b == NULL || c == NULL) {
         fprintf(stderr, "Memory allocation failed!\n");
         return 1;
     }
-    /* Init */
-    for (i = 0; i < N; ++i)
-    {
-        for (j = 0; j < N; ++j)
-        {
-            a[i][j] = 3.0 * i + j;
-            b[i][j] = 5.2 * i + 2.3 * j;
-            c[i][j] = 0.0;
+    init_matrices(a, b, max_n, max_n, max_n);
+
+    bench_config cfg;
+    bench_init(&cfg, "matmul-sweep");
+    printf("Matrix multiplication scaling sweep, largest N=%ld\n", max_n);
+    matmul_ctx ctx = {a, b, c, max_n, max_n, max_n, matmul_blocked, 0};
+    bench_sweep(&cfg, "blocked", sweep_matmul, &ctx, threads, nthreads, sizes, nsizes, weak_size_cubic);
+    bench_finish(&cfg);
+    if (ctx.failed)
+        fprintf(stderr, "Memory allocation failed!\n");
+
+    free(a);
+    free(b);
+    free(c);
+    return ctx.failed;
+}
+
+/* Release A, B and C of run_alloc; entries may be NULL */
+static void free_matrices(double *m[3], size_t bytes, int from_malloc)
+{
+    for (int i = 0; i < 3; i++) {
+        if (from_malloc)
+            free(m[i]);
+        else
+            buf_free(m[i], bytes);
+    }
+}
+
+/*
+ * A, B and C under each allocation policy of bufalloc.h and plain malloc:
+ * time to allocate and initialize, blocked GEMM rate and where the pages
+ * of A ended up
+ */
+static int run_alloc(int argc, char **argv)
+{
+    long n = argc > 2 ? atol(argv[2]) : ALLOC_N;
+    int threads = argc > 3 ? atoi(argv[3]) : omp_get_max_threads();
+    const buf_policy policies[] = {
+        {BUF_PAGES_SMALL, BUF_NUMA_SERIAL}, {BUF_PAGES_SMALL, BUF_NUMA_LOCAL},
+        {BUF_PAGES_THP, BUF_NUMA_SERIAL}, {BUF_PAGES_THP, BUF_NUMA_LOCAL},
+        {BUF_PAGES_THP, BUF_NUMA_INTERLEAVE}, {BUF_PAGES_HUGETLB, BUF_NUMA_LOCAL}};
+    int num_policies = (int)(sizeof(policies) / sizeof(policies[0]));
+    if (n <= 0 || threads <= 0) {
+        fprintf(stderr, "Usage: %s --alloc [N] [threads]\n", argv[0]);
+        return 1;
+    }
+    omp_set_num_threads(threads);
+    size_t bytes = n * n * sizeof(double);
+    double flop = 2.0 * n * n * n;
+    double tol = 2.0 * n * DBL_EPSILON;
+
+    bench_config cfg;
+    bench_init(&cfg, "matmul-alloc");
+    cfg.threads = threads;
+    cfg.size = n * n * n;
+    cfg.work_ops = flop;
+    cfg.work_bytes = 3.0 * bytes;
+    perf_counters pc;
+    perf_attach(&cfg, &pc);
+
+    printf("Matrix multiplication N=%ld with %d threads, %d NUMA nodes\n", n, threads, buf_numa_nodes());
+    printf("%-18s %12s %12s %10s %10s  %s\n", "Policy", "Init (s)", "GEMM (s)", "GFLOP/s", "Huge MB",
+           "Nodes of A");
+    printf("--------------------------------------------------------------------------------\n");
+    int failures = 0;
+    for (int p = -1; p < num_policies; p++) {
+        char name[48], nodes[128];
+        double *m[3];
+        buf_info info = {0, 1, 0.0};
+        double start = omp_get_wtime();
+
+        // p = -1: malloc, first touched by init_matrices and the GEMM itself
+        if (p < 0)
+            snprintf(name, sizeof(name), "malloc");
+        else
+            buf_policy_name(policies[p], name, sizeof(name));
+        for (int i = 0; i < 3; i++)
+            m[i] = p < 0 ? malloc(bytes) : buf_alloc(bytes, n * sizeof(double), policies[p], &info);
+        if (m[0] == NULL || m[1] == NULL || m[2] == NULL) {
+            fprintf(stderr, "Memory allocation failed!\n");
+            free_matrices(m, bytes, p < 0);
+            perf_detach(&pc);
+            bench_finish(&cfg);
+            return 1;
         }
+        init_matrices(m[0], m[1], n, n, n);
+        double init_time = omp_get_wtime() - start;
+        buf_stats stats = buf_inspect(m[0], bytes);
+        if (p >= 0 && policies[p].pages == BUF_PAGES_HUGETLB && !info.hugetlb)
+            strcat(name, "*");
+        if (p >= 0 && !info.numa_ok)
+            strcat(name, "+");
+
+        matmul_ctx ctx = {m[0], m[1], m[2], n, n, n, matmul_blocked, 0};
+        double gemm_time = bench_run(&cfg, name, bench_matmul, &ctx, NAN, 0.0).median;
+        double err = ctx.failed ? INFINITY : sampled_rel_error(m[0], m[1], m[2], n, n, n, NUM_SAMPLES);
+        failures += err > tol;
+        printf("%-18s %12.6f %12.6f %10.2f %10.0f  %s%s\n", name, init_time, gemm_time,
+               flop / gemm_time * 1e-9, stats.huge_bytes / 1e6, buf_nodes_text(&stats, nodes, sizeof(nodes)),
+               err <= tol ? "" : " (INCORRECT!)");
+
+        free_matrices(m, bytes, p < 0);
     }
-    omp_set_num_threads(THREADS);
-    
-    /* Matrixmultiplication with parallal for-loop*/
-    double start = omp_get_wtick();
-#pragma omp parallel for shared(a, b, c) private(i, j, k) schedule(static)
-    for (i = 0; i < N; ++i)
+    printf("--------------------------------------------------------------------------------\n");
+    printf("* no reserved huge pages (vm.nr_hugepages), fell back to thp; + mbind not permitted, kernel default\n");
+
+    perf_detach(&pc);
+    bench_finish(&cfg);
+    return failures != 0;
+}
+
+static int run_strassen(int argc, char **argv)
+{
+    long n = argc > 2 ? atol(argv[2]) : STRASSEN_N;
+    int threads = argc > 3 ? atoi(argv[3]) : omp_get_max_threads();
+    strassen_leaf = argc > 4 ? atol(argv[4]) : STRASSEN_LEAF;
+    if (n <= 0 || threads <= 0 || strassen_leaf < 1) {
+        fprintf(stderr, "Usage: %s --strassen [N] [threads] [leaf]\n", argv[0]);
+        return 1;
+    }
+    omp_set_num_threads(threads);
+
+    double *a = malloc(n * n * sizeof(double));
+    double *b = malloc(n * n * sizeof(double));
+    double *c = malloc(n * n * sizeof(double));
+    double *ref = malloc(n * n * sizeof(double));
+    if (a == NULL || b == NULL || c == NULL || ref == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return 1;
+    }
+    init_matrices(a, b, n, n, n);
+
+    bench_config cfg;
+    bench_init(&cfg, "matmul-strassen");
+    cfg.threads = threads;
+    cfg.size = n * n * n;
+    cfg.work_ops = 2.0 * n * n * n;
+    cfg.work_bytes = sizeof(double) * 3.0 * n * n;
+    double flop = 2.0 * n * n * n;
+
+    strassen_plan plan = plan_strassen(n, threads);
+    printf("Strassen-Winograd N=%ld with %d threads: %d levels (%d as tasks), leaf %ld, padded N=%ld\n",
+           n, threads, plan.levels, plan.task_levels, plan.leaf, plan.padded);
+    printf("Workspace arena: %.1f MB (operands %.1f MB)\n",
+           (plan.workspace + (plan.padded == n ? 0 : 3.0 * plan.padded * plan.padded)) * sizeof(double) / 1e6,
+           3.0 * n * n * sizeof(double) / 1e6);
+
+    // Classical blocked GEMM is the reference for the Strassen result
+    matmul_ctx blocked = {a, b, ref, n, n, n, matmul_blocked, 0};
+    double blocked_time = bench_run(&cfg, "blocked", bench_matmul, &blocked, NAN, 0.0).median;
+    if (blocked.failed) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return 1;
+    }
+    matmul_ctx strassen = {a, b, c, n, n, n, matmul_strassen, 0};
+    double strassen_time = bench_run(&cfg, "strassen", bench_matmul, &strassen, NAN, 0.0).median;
+    if (strassen.failed) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return 1;
+    }
+
+    // Strassen's error bound grows like (N / leaf)^log2(12) instead of N
+    double err = max_rel_error(c, ref, n * n);
+    double classical_err = sampled_rel_error(a, b, ref, n, n, n, NUM_SAMPLES);
+
+    printf("%-10s %12s %22s %12s\n", "Method", "Time (s)", "GFLOP/s-equivalent", "Max rel err");
+    printf("-----------------------------------------------------------\n");
+    printf("%-10s %12.6f %22.2f %12.3e\n", "blocked", blocked_time, flop / blocked_time * 1e-9, classical_err);
+    printf("%-10s %12.6f %22.2f %12.3e\n", "strassen", strassen_time, flop / strassen_time * 1e-9, err);
+    printf("Speedup over blocked: %.2fx; blocked error from %d sampled dot products, "
+           "Strassen error against blocked\n", blocked_time / strassen_time, NUM_SAMPLES);
+
+    free(a);
+    free(b);
+    free(c);
+    free(ref);
+    bench_finish(&cfg);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    long m = DEFAULT_N, n = DEFAULT_N, k = DEFAULT_N;
+    int threads = omp_get_max_threads();
+
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0)
+        return run_sweep(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--strassen") == 0)
+        return run_strassen(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--alloc") == 0)
+        return run_alloc(argc, argv);
+
+    if (argc == 2 || argc == 3) {
+        m = n = k = atol(argv[1]);
+        if (argc == 3)
+            threads = atoi(argv[2]);
+    } else if (argc >= 4) {
+        m = atol(argv[1]);
+        n = atol(argv[2]);
+        k = atol(argv[3]);
+        if (argc > 4)
+            threads = atoi(argv[4]);
+    }
+    if (m <= 0 || n <= 0 || k <= 0 || threads <= 0) {
+        fprintf(stderr, "Usage: %s [N] [threads] | %s M N K [threads]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    // Allocate matrices on heap instead of stack to avoid segmentation fault; each
+    // thread first-touches the rows it initializes (see bufalloc.h)
+    omp_set_num_threads(threads);
+    buf_policy policy = buf_policy_from_env();
+    double *a = buf_alloc(m * k * sizeof(double), k * sizeof(double), policy, NULL);
+    double *b = buf_alloc(k * n * sizeof(double), n * sizeof(double), policy, NULL);
+    double *c = buf_alloc(m * n * sizeof(double), n * sizeof(double), policy, NULL);
+    double *ref = buf_alloc(m * n * sizeof(double), n * sizeof(double), policy, NULL);
+
+    if (a == NULL || b == NULL || c == NULL || ref == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return 1;
+    }
+    init_matrices(a, b, m, n, k);
+
+    bench_config cfg;
+    bench_init(&cfg, "matmul");
+    cfg.threads = threads;
+    cfg.size = m * n * k;
+    perf_counters pc;
+    perf_attach(&cfg, &pc);
+    cfg.work_ops = 2.0 * m * n * k;
+    cfg.work_bytes = sizeof(double) * ((double)m * k + (double)k * n + (double)m * n);
+
+    double flop = 2.0 * m * n * k;
+    printf("Matrix multiplication M=%ld N=%ld K=%ld with %d threads\n", m, n, k, threads);
+
+    /* Naive triple loop (reference), a single timed run without warmup */
+    double naive_time = 0.0;
+    int have_ref = flop <= NAIVE_MAX_FLOP;
+    if (have_ref) {
+        matmul_ctx naive = {a, b, ref, m, n, k, matmul_naive, 0};
+        bench_config once = cfg;
+        once.warmup = 0;
+        once.reps = 1;
+        naive_time = bench_run(&once, "naive", bench_matmul, &naive, NAN, 0.0).median;
+        cfg.header_done = once.header_done;
+        printf("Naive:   %10.6f seconds  %8.2f GFLOP/s\n", naive_time, flop / naive_time * 1e-9);
+    } else {
+        printf("Naive:   skipped (%.1f GFLOP exceeds limit), verifying on %d samples\n",
+               flop * 1e-9, NUM_SAMPLES);
+    }
+
+    /* Blocked GEMM; warmup runs fault in the packing buffers */
+    matmul_ctx blocked = {a, b, c, m, n, k, matmul_blocked, 0};
+    double blocked_time = bench_run(&cfg, "blocked", bench_matmul, &blocked, NAN, 0.0).median;
+    if (blocked.failed) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        return 1;
+    }
+    printf("Blocked: %10.6f seconds  %8.2f GFLOP/s  (%.2f GFLOP/s per thread)\n",
+           blocked_time, flop / blocked_time * 1e-9, flop / blocked_time * 1e-9 / threads);
+    if (have_ref)
+        printf("Speedup over naive: %.2fx\n", naive_time / blocked_time);
+
+    double err = have_ref ? max_rel_error(c, ref, m * n)
+                          : sampled_rel_error(a, b, c, m, n, k, NUM_SAMPLES);
+    double tol = 2.0 * k * DBL_EPSILON;
+    printf("Max relative error: %.3e (%s)\n", err, err <= tol ? "Correct" : "INCORRECT!");
+
+    double sum = 0.0;
+    for (long i = 0; i < m * n; ++i)
+        sum += c[i];
+    printf("Result: %f\n", sum);
+
+    // Free allocated memory
+    buf_free(a, m * k * sizeof(double));
+    buf_free(b, k * n * sizeof(double));
+    buf_free(c, m * n * sizeof(double));
+    buf_free(ref, m * n * sizeof(double));
+
+    perf_detach(&pc);
+    bench_finish(&cfg);
+    return err <= tol ? 0 : 1;
+}
+
+/* Parallel over rows with the static schedule the allocator's first touch assumes */
+void init_matrices(double *a, double *b, long m, long n, long k)
+{
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < m; ++i)
+        for (long p = 0; p < k; ++p)
+            a[i * k + p] = 3.0 * i + p;
+#pragma omp parallel for schedule(static)
+    for (long p = 0; p < k; ++p)
+        for (long j = 0; j < n; ++j)
+            b[p * n + j] = 5.2 * p + 2.3 * j;
+}
+
+/* Matrixmultiplication with parallel for-loop (original i-j-k order) */
+int matmul_naive(const double *a, const double *b, double *c, long m, long n, long k)
+{
+    long i, j, p;
+#pragma omp parallel for shared(a, b, c) private(i, j, p) schedule(static)
+    for (i = 0; i < m; ++i)
     {
-        for (j = 0; j < N; ++j)
+        for (j = 0; j < n; ++j)
         {
-            for (k = 0; k < N; ++k)
+            double sum = 0.0;
+            for (p = 0; p < k; ++p)
             {
-                c[i][j] += a[i][k] * b[k][j];
+                sum += a[i * k + p] * b[p * n + j];
             }
+            c[i * n + j] = sum;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Pack an mc x kc block of A into MR-row slivers: for each sliver the MR
+ * values of column p are contiguous, rows past mc are zero-filled.
+ */
+GEMM_CLONES
+static void pack_a(const double *a, long lda, long mc, long kc, double *pa)
+{
+    for (long ir = 0; ir < mc; ir += MR) {
+        long rows = mc - ir < MR ? mc - ir : MR;
+        for (long p = 0; p < kc; ++p) {
+            for (long i = 0; i < rows; ++i)
+                pa[i] = a[(ir + i) * lda + p];
+            for (long i = rows; i < MR; ++i)
+                pa[i] = 0.0;
+            pa += MR;
         }
     }
-    double end = omp_get_wtime();
-    printf("Time taken for matrix multiplication with %d threads: %f seconds\n", THREADS, end - start);
-    for (i = 0; i < N; ++i)
+}
+
+/*
+ * Pack one kc x NR sliver of B: the NR values of row p are contiguous,
+ * columns past nr are zero-filled.
+ */
+GEMM_CLONES
+static void pack_b_sliver(const double *b, long ldb, long nr, long kc, double *pb)
+{
+    for (long p = 0; p < kc; ++p) {
+        for (long j = 0; j < nr; ++j)
+            pb[j] = b[p * ldb + j];
+        for (long j = nr; j < NR; ++j)
+            pb[j] = 0.0;
+        pb += NR;
+    }
+}
+
+/*
+ * Micro-kernel: C[0:mr, 0:nr] += Apanel * Bpanel over kc.
+ * The 6 x 8 tile of C lives in twelve 4-wide vector registers.
+ */
+GEMM_CLONES
+static void micro_kernel(long kc, const double *restrict pa, const double *restrict pb,
+                         double *c, long ldc, long mr, long nr)
+{
+    v4d c00 = {0}, c01 = {0}, c10 = {0}, c11 = {0}, c20 = {0}, c21 = {0};
+    v4d c30 = {0}, c31 = {0}, c40 = {0}, c41 = {0}, c50 = {0}, c51 = {0};
+
+    for (long p = 0; p < kc; ++p) {
+        v4d b0 = *(const v4d *)(pb);
+        v4d b1 = *(const v4d *)(pb + 4);
+        v4d a0 = {pa[0], pa[0], pa[0], pa[0]};
+        v4d a1 = {pa[1], pa[1], pa[1], pa[1]};
+        c00 += a0 * b0; c01 += a0 * b1;
+        c10 += a1 * b0; c11 += a1 * b1;
+        v4d a2 = {pa[2], pa[2], pa[2], pa[2]};
+        v4d a3 = {pa[3], pa[3], pa[3], pa[3]};
+        c20 += a2 * b0; c21 += a2 * b1;
+        c30 += a3 * b0; c31 += a3 * b1;
+        v4d a4 = {pa[4], pa[4], pa[4], pa[4]};
+        v4d a5 = {pa[5], pa[5], pa[5], pa[5]};
+        c40 += a4 * b0; c41 += a4 * b1;
+        c50 += a5 * b0; c51 += a5 * b1;
+        pa += MR;
+        pb += NR;
+    }
+
+    if (mr == MR && nr == NR) {
+        *(v4du *)(c + 0 * ldc) += c00; *(v4du *)(c + 0 * ldc + 4) += c01;
+        *(v4du *)(c + 1 * ldc) += c10; *(v4du *)(c + 1 * ldc + 4) += c11;
+        *(v4du *)(c + 2 * ldc) += c20; *(v4du *)(c + 2 * ldc + 4) += c21;
+        *(v4du *)(c + 3 * ldc) += c30; *(v4du *)(c + 3 * ldc + 4) += c31;
+        *(v4du *)(c + 4 * ldc) += c40; *(v4du *)(c + 4 * ldc + 4) += c41;
+        *(v4du *)(c + 5 * ldc) += c50; *(v4du *)(c + 5 * ldc + 4) += c51;
+        return;
+    }
+
+    // Edge tile: spill to a local buffer and add only the valid part
+    double tile[MR * NR] __attribute__((aligned(64)));
+    v4d *t = (v4d *)tile;
+    t[0] = c00; t[1] = c01; t[2] = c10; t[3] = c11; t[4] = c20; t[5] = c21;
+    t[6] = c30; t[7] = c31; t[8] = c40; t[9] = c41; t[10] = c50; t[11] = c51;
+    for (long i = 0; i < mr; ++i)
+        for (long j = 0; j < nr; ++j)
+            c[i * ldc + j] += tile[i * NR + j];
+}
+
+/*
+ * Blocked GEMM, C = A * B.
+ *
+ * Loop nest (outer to inner): jc over NC-wide panels of B, pc over KC-deep
+ * slices, then a parallel loop over MC x NB macro-tiles of C. Each thread
+ * packs its MC x KC block of A once per (ic, pc) and reuses it for all
+ * macro-tiles in that row; the packed B panel is shared by all threads.
+ */
+int matmul_blocked(const double *a, const double *b, double *c, long m, long n, long k)
+{
+    long nc_max = n < NC ? n : NC;
+    long kc_max = k < KC ? k : KC;
+    long pb_cols = (nc_max + NR - 1) / NR * NR;
+    double *pb = aligned_alloc(64, (size_t)kc_max * pb_cols * sizeof(double));
+    int failed = pb == NULL;
+
+    memset(c, 0, m * n * sizeof(double));
+
+#pragma omp parallel
     {
-        for (j = 0; j < N; ++j)
-        {
-            sum += c[i][j];
+        double *pa = aligned_alloc(64, (size_t)MC * kc_max * sizeof(double));
+        if (pa == NULL) {
+#pragma omp atomic write
+            failed = 1;
         }
+        // Every thread has to see the same verdict before the worksharing loops
+#pragma omp barrier
+
+        for (long jc = 0; jc < n && !failed; jc += NC) {
+            long nc = n - jc < NC ? n - jc : NC;
+            long slivers = (nc + NR - 1) / NR;
+
+            for (long pc = 0; pc < k; pc += KC) {
+                long kc = k - pc < KC ? k - pc : KC;
+
+                // Pack the shared B panel cooperatively
+#pragma omp for schedule(static)
+                for (long s = 0; s < slivers; ++s) {
+                    long nr = nc - s * NR < NR ? nc - s * NR : NR;
+                    pack_b_sliver(b + pc * n + jc + s * NR, n, nr, kc, pb + s * NR * kc);
+                }
+
+                long m_tiles = (m + MC - 1) / MC;
+                long n_tiles = (nc + NB - 1) / NB;
+                long packed_ic = -1;
+
+#pragma omp for schedule(static)
+                for (long t = 0; t < m_tiles * n_tiles; ++t) {
+                    long ic = (t / n_tiles) * MC;
+                    long jb = (t % n_tiles) * NB;
+                    long mc = m - ic < MC ? m - ic : MC;
+                    long nb = nc - jb < NB ? nc - jb : NB;
+
+                    if (packed_ic != ic) {
+                        pack_a(a + ic * k + pc, k, mc, kc, pa);
+                        packed_ic = ic;
+                    }
+
+                    for (long jr = 0; jr < nb; jr += NR) {
+                        long nr = nb - jr < NR ? nb - jr : NR;
+                        const double *bs = pb + (jb + jr) / NR * NR * kc;
+                        for (long ir = 0; ir < mc; ir += MR) {
+                            long mr = mc - ir < MR ? mc - ir : MR;
+                            micro_kernel(kc, pa + ir * kc, bs,
+                                         c + (ic + ir) * n + jc + jb + jr, n, mr, nr);
+                        }
+                    }
+                }
+            }
+        }
+
+        free(pa);
     }
-    printf("Result: %f\n", sum);
-    
-    // Free allocated memory
-    free(a);
-    free(b);
-    free(c);
-    
+
+    free(pb);
+    return failed ? -1 : 0;
+}
+
+/* Strassen-Winograd */
+
+// Workspace sizes are rounded to whole cache lines so every block stays 64-byte aligned
+static size_t round_line(size_t doubles)
+{
+    return (doubles + 7) & ~(size_t)7;
+}
+
+// Packing buffers of gemm_leaf for n x n operands
+static size_t leaf_workspace(long n)
+{
+    long kc = n < KC ? n : KC;
+    long nc = n < NC ? n : NC;
+    return round_line((size_t)MC * kc) + round_line((size_t)kc * ((nc + NR - 1) / NR * NR));
+}
+
+/*
+ * Doubles of workspace strassen_rec needs for size n: a task level keeps
+ * S1..S4, T1..T4, P1, P2 and P4 and gives each of its 7 children their own
+ * workspace; a serial level keeps two temporaries and reuses one child
+ * workspace for all 7 products.
+ */
+static size_t strassen_workspace(long n, int task_levels)
+{
+    if (n <= strassen_leaf)
+        return leaf_workspace(n);
+    long h = n / 2;
+    size_t quarter = round_line((size_t)h * h);
+    if (task_levels > 0)
+        return 11 * quarter + 7 * strassen_workspace(h, task_levels - 1);
+    return 2 * quarter + strassen_workspace(h, 0);
+}
+
+/* Serial blocked GEMM on strided n x n operands, C = A * B */
+static void gemm_leaf(const double *a, long lda, const double *b, long ldb, double *c, long ldc,
+                      long n, double *ws)
+{
+    long kc_max = n < KC ? n : KC;
+    double *pa = ws;
+    double *pb = ws + round_line((size_t)MC * kc_max);
+
+    for (long i = 0; i < n; ++i)
+        memset(c + i * ldc, 0, n * sizeof(double));
+
+    for (long jc = 0; jc < n; jc += NC) {
+        long nc = n - jc < NC ? n - jc : NC;
+        for (long pc = 0; pc < n; pc += KC) {
+            long kc = n - pc < KC ? n - pc : KC;
+            for (long jr = 0; jr < nc; jr += NR) {
+                long nr = nc - jr < NR ? nc - jr : NR;
+                pack_b_sliver(b + pc * ldb + jc + jr, ldb, nr, kc, pb + jr * kc);
+            }
+            for (long ic = 0; ic < n; ic += MC) {
+                long mc = n - ic < MC ? n - ic : MC;
+                pack_a(a + ic * lda + pc, lda, mc, kc, pa);
+                for (long jr = 0; jr < nc; jr += NR) {
+                    long nr = nc - jr < NR ? nc - jr : NR;
+                    for (long ir = 0; ir < mc; ir += MR) {
+                        long mr = mc - ir < MR ? mc - ir : MR;
+                        micro_kernel(kc, pa + ir * kc, pb + jr * kc, c + (ic + ir) * ldc + jc + jr, ldc,
+                                     mr, nr);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* C = A + sign * B on n x n blocks; C may alias A or B. Rows become tasks when par is set. */
+static void mat_combine(double *c, long ldc, const double *a, long lda, const double *b, long ldb,
+                        double sign, long n, int par)
+{
+    if (par) {
+#pragma omp taskloop grainsize(16)
+        for (long i = 0; i < n; ++i)
+            for (long j = 0; j < n; ++j)
+                c[i * ldc + j] = a[i * lda + j] + sign * b[i * ldb + j];
+    } else {
+        for (long i = 0; i < n; ++i)
+            for (long j = 0; j < n; ++j)
+                c[i * ldc + j] = a[i * lda + j] + sign * b[i * ldb + j];
+    }
+}
+
+/*
+ * C = A * B for n x n blocks, n = leaf' * 2^levels. Winograd's form:
+ *   S1 = A21 + A22   S2 = S1 - A11   S3 = A11 - A21   S4 = A12 - S2
+ *   T1 = B12 - B11   T2 = B22 - T1   T3 = B22 - B12   T4 = T2 - B21
+ *   P1 = A11 B11  P2 = A12 B21  P3 = S4 B22  P4 = A22 T4
+ *   P5 = S1 T1    P6 = S2 T2    P7 = S3 T3
+ *   U2 = P1 + P6  U3 = U2 + P7  U4 = U2 + P5
+ *   C11 = P1 + P2  C12 = U4 + P3  C21 = U3 - P4  C22 = U3 + P5
+ * The first task_levels levels run the products as tasks; below, the
+ * schedule of Boyer et al. (ISSAC 2009) needs only X and Y as temporaries.
+ */
+static void strassen_rec(const double *a, long lda, const double *b, long ldb, double *c, long ldc,
+                         long n, double *ws, int task_levels)
+{
+    if (n <= strassen_leaf) {
+        gemm_leaf(a, lda, b, ldb, c, ldc, n, ws);
+        return;
+    }
+
+    long h = n / 2;
+    const double *a11 = a, *a12 = a + h, *a21 = a + h * lda, *a22 = a + h * lda + h;
+    const double *b11 = b, *b12 = b + h, *b21 = b + h * ldb, *b22 = b + h * ldb + h;
+    double *c11 = c, *c12 = c + h, *c21 = c + h * ldc, *c22 = c + h * ldc + h;
+    size_t quarter = round_line((size_t)h * h);
+
+    if (task_levels > 0) {
+        double *s1 = ws, *s2 = s1 + quarter, *s3 = s2 + quarter, *s4 = s3 + quarter;
+        double *t1 = s4 + quarter, *t2 = t1 + quarter, *t3 = t2 + quarter, *t4 = t3 + quarter;
+        double *p1 = t4 + quarter, *p2 = p1 + quarter, *p4 = p2 + quarter;
+        double *child = p4 + quarter;
+        size_t child_ws = strassen_workspace(h, task_levels - 1);
+        int next = task_levels - 1;
+
+        mat_combine(s1, h, a21, lda, a22, lda, 1.0, h, 1);
+        mat_combine(s2, h, s1, h, a11, lda, -1.0, h, 1);
+        mat_combine(s3, h, a11, lda, a21, lda, -1.0, h, 1);
+        mat_combine(s4, h, a12, lda, s2, h, -1.0, h, 1);
+        mat_combine(t1, h, b12, ldb, b11, ldb, -1.0, h, 1);
+        mat_combine(t2, h, b22, ldb, t1, h, -1.0, h, 1);
+        mat_combine(t3, h, b22, ldb, b12, ldb, -1.0, h, 1);
+        mat_combine(t4, h, t2, h, b21, ldb, -1.0, h, 1);
+
+        // P3, P5, P6 and P7 go straight into the quadrants of C
+#pragma omp task
+        strassen_rec(a11, lda, b11, ldb, p1, h, h, child, next);
+#pragma omp task
+        strassen_rec(a12, lda, b21, ldb, p2, h, h, child + child_ws, next);
+#pragma omp task
+        strassen_rec(s4, h, b22, ldb, c11, ldc, h, child + 2 * child_ws, next);
+#pragma omp task
+        strassen_rec(a22, lda, t4, h, p4, h, h, child + 3 * child_ws, next);
+#pragma omp task
+        strassen_rec(s1, h, t1, h, c22, ldc, h, child + 4 * child_ws, next);
+#pragma omp task
+        strassen_rec(s2, h, t2, h, c12, ldc, h, child + 5 * child_ws, next);
+        strassen_rec(s3, h, t3, h, c21, ldc, h, child + 6 * child_ws, next);
+#pragma omp taskwait
+
+        mat_combine(c12, ldc, c12, ldc, p1, h, 1.0, h, 1);     // U2
+        mat_combine(c21, ldc, c21, ldc, c12, ldc, 1.0, h, 1);  // U3
+        mat_combine(c12, ldc, c12, ldc, c22, ldc, 1.0, h, 1);  // U4
+        mat_combine(c22, ldc, c22, ldc, c21, ldc, 1.0, h, 1);  // C22 = U3 + P5
+        mat_combine(c12, ldc, c12, ldc, c11, ldc, 1.0, h, 1);  // C12 = U4 + P3
+        mat_combine(c21, ldc, c21, ldc, p4, h, -1.0, h, 1);    // C21 = U3 - P4
+        mat_combine(c11, ldc, p1, h, p2, h, 1.0, h, 1);        // C11 = P1 + P2
+        return;
+    }
+
+    double *x = ws, *y = ws + quarter, *child = ws + 2 * quarter;
+    mat_combine(x, h, a11, lda, a21, lda, -1.0, h, 0);         // S3
+    mat_combine(y, h, b22, ldb, b12, ldb, -1.0, h, 0);         // T3
+    strassen_rec(x, h, y, h, c21, ldc, h, child, 0);           // P7
+    mat_combine(x, h, a21, lda, a22, lda, 1.0, h, 0);          // S1
+    mat_combine(y, h, b12, ldb, b11, ldb, -1.0, h, 0);         // T1
+    strassen_rec(x, h, y, h, c22, ldc, h, child, 0);           // P5
+    mat_combine(x, h, x, h, a11, lda, -1.0, h, 0);             // S2
+    mat_combine(y, h, b22, ldb, y, h, -1.0, h, 0);             // T2
+    strassen_rec(x, h, y, h, c12, ldc, h, child, 0);           // P6
+    mat_combine(x, h, a12, lda, x, h, -1.0, h, 0);             // S4
+    mat_combine(y, h, y, h, b21, ldb, -1.0, h, 0);             // T4
+    strassen_rec(x, h, b22, ldb, c11, ldc, h, child, 0);       // P3
+    strassen_rec(a11, lda, b11, ldb, x, h, h, child, 0);       // P1
+    mat_combine(c12, ldc, x, h, c12, ldc, 1.0, h, 0);          // U2
+    mat_combine(c21, ldc, c12, ldc, c21, ldc, 1.0, h, 0);      // U3
+    mat_combine(c12, ldc, c12, ldc, c22, ldc, 1.0, h, 0);      // U4
+    mat_combine(c22, ldc, c21, ldc, c22, ldc, 1.0, h, 0);      // C22 = U3 + P5
+    mat_combine(c12, ldc, c12, ldc, c11, ldc, 1.0, h, 0);      // C12 = U4 + P3
+    strassen_rec(a22, lda, y, h, c11, ldc, h, child, 0);       // P4
+    mat_combine(c21, ldc, c21, ldc, c11, ldc, -1.0, h, 0);     // C21 = U3 - P4
+    strassen_rec(a12, lda, b21, ldb, c11, ldc, h, child, 0);   // P2
+    mat_combine(c11, ldc, x, h, c11, ldc, 1.0, h, 0);          // C11 = P1 + P2
+}
+
+static strassen_plan plan_strassen(long n, int threads)
+{
+    strassen_plan p;
+    p.levels = 0;
+    p.leaf = n;
+    while (p.leaf > strassen_leaf) {
+        p.leaf = (p.leaf + 1) / 2;
+        p.levels++;
+    }
+    p.padded = p.leaf << p.levels;
+
+    // Enough levels for 7^levels >= threads products in flight
+    p.task_levels = 0;
+    for (long tasks = 1; tasks < threads && p.task_levels < p.levels &&
+                         p.task_levels < STRASSEN_MAX_TASK_LEVELS; tasks *= 7)
+        p.task_levels++;
+    p.workspace = strassen_workspace(p.padded, p.task_levels);
+
+    // Each task level multiplies the arena by about 7/4 (3.4x the operands
+    // at two levels); give levels back rather than outgrow free memory
+    long pages = sysconf(_SC_AVPHYS_PAGES), page = sysconf(_SC_PAGESIZE);
+    double avail = pages > 0 && page > 0 ? (double)pages * page : INFINITY;
+    double padded = p.padded == n ? 0.0 : 3.0 * p.padded * p.padded;
+    while (p.task_levels > 0 && (p.workspace + padded) * sizeof(double) > avail) {
+        p.task_levels--;
+        p.workspace = strassen_workspace(p.padded, p.task_levels);
+    }
+    return p;
+}
+
+/*
+ * Square C = A * B by Strassen-Winograd (m = n = k). Operands whose size is
+ * not leaf' * 2^levels are copied into zero-padded buffers first.
+ */
+int matmul_strassen(const double *a, const double *b, double *c, long m, long n, long k)
+{
+    (void)m;
+    (void)k;
+    strassen_plan plan = plan_strassen(n, omp_get_max_threads());
+    long np = plan.padded;
+    size_t padded_bytes = np == n ? 0 : 3 * (size_t)np * np * sizeof(double);
+    double *arena = aligned_alloc(64, plan.workspace * sizeof(double) + padded_bytes);
+    if (arena == NULL)
+        return -1;
+
+    const double *pa = a, *pb = b;
+    double *pc = c;
+    if (np != n) {
+        double *buf = arena + plan.workspace;
+        double *ap = buf, *bp = buf + (size_t)np * np;
+        pc = buf + 2 * (size_t)np * np;
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < np; ++i) {
+            memset(ap + i * np, 0, np * sizeof(double));
+            memset(bp + i * np, 0, np * sizeof(double));
+            if (i < n) {
+                memcpy(ap + i * np, a + i * n, n * sizeof(double));
+                memcpy(bp + i * np, b + i * n, n * sizeof(double));
+            }
+        }
+        pa = ap;
+        pb = bp;
+    }
+
+#pragma omp parallel
+#pragma omp single
+    strassen_rec(pa, np, pb, np, pc, np, np, arena, plan.task_levels);
+
+    if (np != n) {
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < n; ++i)
+            memcpy(c + i * n, pc + i * np, n * sizeof(double));
+    }
+    free(arena);
     return 0;
-}
\ No newline at end of file
+}
+
+double max_rel_error(const double *c, const double *ref, long count)
+{
+    double err = 0.0;
+    for (long i = 0; i < count; ++i) {
+        double scale = fabs(ref[i]) > 1.0 ? fabs(ref[i]) : 1.0;
+        double e = fabs(c[i] - ref[i]) / scale;
+        if (e > err)
+            err = e;
+    }
+    return err;
+}
+
+/* Compare randomly chosen entries of C against a direct dot product */
+double sampled_rel_error(const double *a, const double *b, const double *c,
+                         long m, long n, long k, int samples)
+{
+    double err = 0.0;
+    srand(42);
+    for (int s = 0; s < samples; ++s) {
+        long i = rand() % m;
+        long j = rand() % n;
+        double ref = 0.0;
+        for (long p = 0; p < k; ++p)
+            ref += a[i * k + p] * b[p * n + j];
+        double scale = fabs(ref) > 1.0 ? fabs(ref) : 1.0;
+        double e = fabs(c[i * n + j] - ref) / scale;
+        if (e > err)
+            err = e;
+    }
+    return err;
+}
@@ -0,0 +1,470 @@
+/*
+ * OpenMP runtime overheads in the style of the EPCC OpenMP microbenchmarks
+ *
+ * Where hello.c and exercise_three.c only start a parallel region, this
+ * program measures what each construct costs. Each test runs a construct
+ * innerreps times around a fixed delay (a dependent add loop of about
+ * delay_ns). A reference loop runs the same delays on one thread without
+ * the construct. The overhead of one instance is
+ *   (test time - reference time) / innerreps
+ * innerreps doubles until one test run takes TARGET_TEST_US, and the
+ * harness in bench.h repeats both loops (BENCH_REPS, default 5; EPCC uses
+ * 20). The ± column combines the 95% confidence intervals of the two.
+ *
+ * Constructs (per thread unless noted):
+ *   parallel          fork/join of a region containing one delay
+ *   for <schedule>    worksharing loop of ITERS_PER_THREAD delays per
+ *                     thread, for static, static 1, dynamic 1, dynamic 8
+ *                     and guided
+ *   barrier           delay, barrier
+ *   single            single containing the delay
+ *   critical          innerreps critical sections in total, split over
+ *                     the threads (against innerreps serial delays)
+ *   atomic            innerreps atomic adds in total (against serial adds)
+ *   reduction         parallel region with reduction(+) around one delay
+ *   task              each thread spawns innerreps tasks of one delay
+ *   task+taskwait     spawn one task, then taskwait
+ *
+ * Before the measurements each thread prints its OpenMP place, the CPU
+ * and NUMA node it runs on and the CPUs it may run on. Warnings flag
+ * threads stacked on one CPU and more threads than CPUs. OMP_PROC_BIND
+ * and OMP_PLACES are read once at startup, so --affinity re-runs the
+ * program under each setting in affinity_settings. Variant names carry
+ * the setting (e.g. "barrier 4T close/cores") whenever either is set.
+ *
+ * Compile: gcc -fopenmp -O2 omp_overhead.c -o omp_overhead -lm
+ * Run: ./omp_overhead [thread_list] [delay_ns]             (default 1,2,4,...,max 100)
+ *      ./omp_overhead --affinity [thread_list] [delay_ns]
+ *      OMP_PROC_BIND=close OMP_PLACES=cores ./omp_overhead 1,2,4,max
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <omp.h>
+#include "bench.h"
+
+#define DEFAULT_DELAY_NS 100.0
+#define TARGET_TEST_US 1000.0    // Minimum duration of one test run
+#define ITERS_PER_THREAD 32      // Loop iterations per thread in the for tests
+#define MAX_THREADS 256
+#define CPU_LIST_LEN 64
+
+// OMP_PROC_BIND / OMP_PLACES pairs for --affinity; NULL leaves a variable unset
+static const char *affinity_settings[][2] = {
+    {NULL, NULL}, {"false", NULL}, {"close", "cores"}, {"spread", "cores"}, {"close", "threads"}};
+#define NUM_AFFINITY_SETTINGS (int)(sizeof(affinity_settings) / sizeof(affinity_settings[0]))
+
+static int delay_length;   // Iterations of delay() for the requested delay
+static double atomic_sum;
+
+static void delay(int n)
+{
+    volatile double a = 0.0;
+    for (int i = 0; i < n; i++)
+        a += i;
+    if (a < 0)
+        printf("%f\n", a);
+}
+
+/* Iterations of delay() that take about ns nanoseconds */
+static int calibrate_delay(double ns)
+{
+    int n = 1 << 20;
+    double best = INFINITY;
+    for (int rep = 0; rep < 5; rep++) {
+        double start = omp_get_wtime();
+        delay(n);
+        double t = omp_get_wtime() - start;
+        best = t < best ? t : best;
+    }
+    int length = (int)(ns * 1e-9 / (best / n) + 0.5);
+    return length > 0 ? length : 1;
+}
+
+/* Tests: innerreps instances of the construct */
+
+enum {
+    T_PARALLEL, T_FOR_STATIC, T_FOR_STATIC1, T_FOR_DYNAMIC1, T_FOR_DYNAMIC8, T_FOR_GUIDED,
+    T_BARRIER, T_SINGLE, T_CRITICAL, T_ATOMIC, T_REDUCTION, T_TASK, T_TASKWAIT
+};
+
+// Reference loops: innerreps * ref_factor serial delays, or serial adds for atomic
+typedef struct {
+    const char *name;
+    int test;
+    int ref_factor;
+} construct;
+
+static const construct constructs[] = {
+    {"parallel", T_PARALLEL, 1},
+    {"for static", T_FOR_STATIC, ITERS_PER_THREAD},
+    {"for static 1", T_FOR_STATIC1, ITERS_PER_THREAD},
+    {"for dynamic 1", T_FOR_DYNAMIC1, ITERS_PER_THREAD},
+    {"for dynamic 8", T_FOR_DYNAMIC8, ITERS_PER_THREAD},
+    {"for guided", T_FOR_GUIDED, ITERS_PER_THREAD},
+    {"barrier", T_BARRIER, 1},
+    {"single", T_SINGLE, 1},
+    {"critical", T_CRITICAL, 1},
+    {"atomic", T_ATOMIC, 0},
+    {"reduction", T_REDUCTION, 1},
+    {"task", T_TASK, 1},
+    {"task+taskwait", T_TASKWAIT, 1},
+};
+#define NUM_CONSTRUCTS (int)(sizeof(constructs) / sizeof(constructs[0]))
+
+typedef struct {
+    const construct *c;
+    int threads;
+    long inner;
+} overhead_ctx;
+
+static double run_test(void *ctx)
+{
+    overhead_ctx *x = (overhead_ctx *)ctx;
+    long inner = x->inner;
+    int dl = delay_length;
+    double sum = 0.0;
+
+    switch (x->c->test) {
+    case T_PARALLEL:
+        for (long j = 0; j < inner; j++) {
+#pragma omp parallel
+            delay(dl);
+        }
+        break;
+    case T_FOR_STATIC:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp for schedule(static)
+            for (long i = 0; i < (long)x->threads * ITERS_PER_THREAD; i++)
+                delay(dl);
+        }
+        break;
+    case T_FOR_STATIC1:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp for schedule(static, 1)
+            for (long i = 0; i < (long)x->threads * ITERS_PER_THREAD; i++)
+                delay(dl);
+        }
+        break;
+    case T_FOR_DYNAMIC1:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp for schedule(dynamic, 1)
+            for (long i = 0; i < (long)x->threads * ITERS_PER_THREAD; i++)
+                delay(dl);
+        }
+        break;
+    case T_FOR_DYNAMIC8:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp for schedule(dynamic, 8)
+            for (long i = 0; i < (long)x->threads * ITERS_PER_THREAD; i++)
+                delay(dl);
+        }
+        break;
+    case T_FOR_GUIDED:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp for schedule(guided)
+            for (long i = 0; i < (long)x->threads * ITERS_PER_THREAD; i++)
+                delay(dl);
+        }
+        break;
+    case T_BARRIER:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+            delay(dl);
+#pragma omp barrier
+        }
+        break;
+    case T_SINGLE:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp single
+            delay(dl);
+        }
+        break;
+    case T_CRITICAL:
+#pragma omp parallel
+        for (long j = 0; j < inner / x->threads; j++) {
+#pragma omp critical
+            delay(dl);
+        }
+        break;
+    case T_ATOMIC:
+        atomic_sum = 0.0;
+#pragma omp parallel
+        for (long j = 0; j < inner / x->threads; j++) {
+#pragma omp atomic
+            atomic_sum += 1.0;
+        }
+        sum = atomic_sum;
+        break;
+    case T_REDUCTION:
+        for (long j = 0; j < inner; j++) {
+#pragma omp parallel reduction(+:sum)
+            {
+                delay(dl);
+                sum += 1.0;
+            }
+        }
+        break;
+    case T_TASK:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp task
+            delay(dl);
+        }
+        break;
+    case T_TASKWAIT:
+#pragma omp parallel
+        for (long j = 0; j < inner; j++) {
+#pragma omp task
+            delay(dl);
+#pragma omp taskwait
+        }
+        break;
+    }
+    return sum;
+}
+
+static double run_reference(void *ctx)
+{
+    overhead_ctx *x = (overhead_ctx *)ctx;
+    long reps = x->inner * x->c->ref_factor;
+
+    if (x->c->ref_factor == 0) {
+        // Serial adds the compiler must keep
+        volatile double *sum = &atomic_sum;
+        *sum = 0.0;
+        for (long j = 0; j < x->inner; j++)
+            *sum += 1.0;
+        return *sum;
+    }
+    for (long j = 0; j < reps; j++)
+        delay(delay_length);
+    return 0.0;
+}
+
+/* Per-thread binding: OpenMP place, current CPU and node, allowed CPUs */
+
+typedef struct {
+    int place;
+    unsigned cpu, node;
+    int allowed;            // Number of CPUs in the affinity mask
+    int first_allowed;
+    char cpus[CPU_LIST_LEN];
+} binding;
+
+// Affinity mask as a compact list, e.g. "0-3,8"
+static void cpu_list(const cpu_set_t *set, char *buf, size_t len)
+{
+    size_t pos = 0;
+    buf[0] = '\0';
+    for (int c = 0; c < CPU_SETSIZE && pos < len; c++) {
+        if (!CPU_ISSET(c, set))
+            continue;
+        int end = c;
+        while (end + 1 < CPU_SETSIZE && CPU_ISSET(end + 1, set))
+            end++;
+        if (end == c)
+            pos += snprintf(buf + pos, len - pos, "%s%d", pos ? "," : "", c);
+        else
+            pos += snprintf(buf + pos, len - pos, "%s%d-%d", pos ? "," : "", c, end);
+        c = end;
+    }
+}
+
+/*
+ * Print where each of threads threads runs and flag misconfigured
+ * affinity; returns the number of warnings
+ */
+static int print_bindings(int threads)
+{
+    binding b[MAX_THREADS];
+    cpu_set_t all;
+    CPU_ZERO(&all);
+
+#pragma omp parallel num_threads(threads)
+    {
+        int tid = omp_get_thread_num();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        sched_getaffinity(0, sizeof(set), &set);
+        b[tid].place = omp_get_place_num();
+        b[tid].cpu = b[tid].node = 0;
+        syscall(SYS_getcpu, &b[tid].cpu, &b[tid].node, NULL);
+        b[tid].allowed = CPU_COUNT(&set);
+        b[tid].first_allowed = -1;
+        for (int c = 0; c < CPU_SETSIZE && b[tid].first_allowed < 0; c++)
+            if (CPU_ISSET(c, &set))
+                b[tid].first_allowed = c;
+        cpu_list(&set, b[tid].cpus, CPU_LIST_LEN);
+#pragma omp critical
+        CPU_OR(&all, &all, &set);
+    }
+
+    printf("%8s %6s %5s %5s  %s\n", "Thread", "Place", "CPU", "Node", "Allowed CPUs");
+    for (int t = 0; t < threads; t++)
+        printf("%8d %6d %5u %5u  %s\n", t, b[t].place, b[t].cpu, b[t].node, b[t].cpus);
+
+    int warnings = 0;
+    int ncpus = CPU_COUNT(&all);
+    if (threads > ncpus) {
+        printf("Warning: %d threads share %d CPUs, overheads include time slicing\n", threads, ncpus);
+        warnings++;
+    }
+    for (int t = 1; t < threads && threads <= ncpus; t++) {
+        for (int u = 0; u < t; u++) {
+            if (b[t].allowed == 1 && b[u].allowed == 1 && b[t].first_allowed == b[u].first_allowed) {
+                printf("Warning: threads %d and %d are both bound to CPU %d while %d CPUs are available\n",
+                       u, t, b[t].first_allowed, ncpus);
+                warnings++;
+                u = t;
+                t = threads;   // One warning is enough to spot the problem
+            }
+        }
+    }
+    if (omp_get_proc_bind() != omp_proc_bind_false && threads > 1 && b[0].allowed == ncpus && ncpus > 1)
+        printf("Note: OMP_PROC_BIND is set but threads may run on every CPU (no OMP_PLACES?)\n");
+    return warnings;
+}
+
+/*
+ * Re-run this program once per OMP_PROC_BIND / OMP_PLACES setting. When
+ * the records do not simply go to stdout, the children append theirs to
+ * this process's record stream, after the one CSV header written here.
+ */
+static int run_affinity_sweep(bench_config *cfg, int argc, char **argv)
+{
+    int failures = 0;
+    char *args[4] = {argv[0], argc > 2 ? argv[2] : NULL, argc > 3 ? argv[3] : NULL, NULL};
+    char records[32] = "";
+
+    if (cfg->out != stdout) {
+        if (cfg->format == BENCH_CSV)
+            bench_csv_header(cfg);
+        snprintf(records, sizeof(records), "/dev/fd/%d", fileno(cfg->out));
+    }
+    for (int s = 0; s < NUM_AFFINITY_SETTINGS; s++) {
+        fflush(cfg->out);
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            const char *names[2] = {"OMP_PROC_BIND", "OMP_PLACES"};
+            for (int v = 0; v < 2; v++) {
+                if (affinity_settings[s][v] != NULL)
+                    setenv(names[v], affinity_settings[s][v], 1);
+                else
+                    unsetenv(names[v]);
+            }
+            if (records[0] != '\0') {
+                setenv("BENCH_OUTPUT", records, 1);
+                setenv("BENCH_APPEND", "1", 1);
+            }
+            execv("/proc/self/exe", args);
+            perror("execv");
+            _exit(127);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failures++;
+        printf("\n");
+    }
+    return failures != 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--affinity") == 0) {
+        bench_config cfg;
+        bench_init(&cfg, "omp_overhead");
+        int status = run_affinity_sweep(&cfg, argc, argv);
+        bench_finish(&cfg);
+        return status;
+    }
+
+    long long threads[BENCH_MAX_LIST];
+    int nthreads = 0;
+    int procs = omp_get_num_procs();
+    if (argc > 1) {
+        nthreads = bench_parse_list(argv[1], threads, BENCH_MAX_LIST, procs);
+    } else {
+        for (long long p = 1; p < procs; p *= 2)
+            threads[nthreads++] = p;
+        threads[nthreads++] = procs;
+    }
+    double delay_ns = argc > 2 ? atof(argv[2]) : DEFAULT_DELAY_NS;
+    if (nthreads == 0 || threads[nthreads - 1] > MAX_THREADS || delay_ns <= 0) {
+        printf("Usage: %s [--affinity] [thread_list, <= %d threads] [delay_ns]\n", argv[0], MAX_THREADS);
+        return 1;
+    }
+
+    bench_config cfg;
+    bench_init(&cfg, "omp_overhead");
+    delay_length = calibrate_delay(delay_ns);
+
+    const char *bind = getenv("OMP_PROC_BIND"), *places = getenv("OMP_PLACES");
+    char setting[48] = "";
+    if (bind != NULL || places != NULL)
+        snprintf(setting, sizeof(setting), " %s/%s", bind ? bind : "-", places ? places : "-");
+    printf("OMP_PROC_BIND=%s OMP_PLACES=%s (%d places), %d CPUs\n", bind ? bind : "(unset)",
+           places ? places : "(unset)", omp_get_num_places(), procs);
+    printf("Delay %.0f ns = %d iterations, test runs >= %.0f us, %d reps\n", delay_ns, delay_length,
+           TARGET_TEST_US, cfg.reps);
+
+    double overhead[NUM_CONSTRUCTS][BENCH_MAX_LIST], error[NUM_CONSTRUCTS][BENCH_MAX_LIST];
+    for (int i = 0; i < nthreads; i++) {
+        int p = (int)threads[i];
+        omp_set_num_threads(p);
+        cfg.threads = p;
+        printf("\n%d thread%s:\n", p, p == 1 ? "" : "s");
+        print_bindings(p);
+
+        for (int k = 0; k < NUM_CONSTRUCTS; k++) {
+            // innerreps stays a multiple of p for the tests that split it over threads
+            overhead_ctx ctx = {&constructs[k], p, p};
+            double start = omp_get_wtime();
+            run_test(&ctx);
+            while (omp_get_wtime() - start < TARGET_TEST_US * 1e-6) {
+                ctx.inner *= 2;
+                start = omp_get_wtime();
+                run_test(&ctx);
+            }
+            cfg.size = ctx.inner;
+
+            char name[112];
+            snprintf(name, sizeof(name), "%s %dT%s", constructs[k].name, p, setting);
+            bench_result test = bench_run(&cfg, name, run_test, &ctx, NAN, 0.0);
+            snprintf(name, sizeof(name), "%s %dT%s reference", constructs[k].name, p, setting);
+            bench_result ref = bench_run(&cfg, name, run_reference, &ctx, NAN, 0.0);
+            overhead[k][i] = (test.median - ref.median) / ctx.inner * 1e9;
+            error[k][i] = sqrt(test.ci95 * test.ci95 + ref.ci95 * ref.ci95) / ctx.inner * 1e9;
+        }
+    }
+
+    printf("\nOverhead per construct (ns, median +/- 95%% CI)\n%-16s", "Construct");
+    for (int i = 0; i < nthreads; i++) {
+        char head[24];
+        snprintf(head, sizeof(head), "%lldT", threads[i]);
+        printf(" %20s", head);
+    }
+    printf("\n");
+    for (int k = 0; k < NUM_CONSTRUCTS; k++) {
+        printf("%-16s", constructs[k].name);
+        for (int i = 0; i < nthreads; i++)
+            printf(" %11.1f +/- %5.1f", overhead[k][i], error[k][i]);
+        printf("\n");
+    }
+
+    bench_finish(&cfg);
+    return 0;
+}
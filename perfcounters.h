@@ -0,0 +1,275 @@
+/*
+ * perfcounters.h - Hardware performance counters for the benchmark harness
+ *
+ * With BENCH_COUNTERS=1 every region timed by bench_run() is wrapped with
+ * perf_event_open counters: cycles, instructions, last-level cache misses
+ * and branch misses. The counters are opened once per OpenMP thread,
+ * read after the region and summed over all threads (scaled when the
+ * kernel had to multiplex them). From these and the work the program
+ * declares in cfg->work_ops / cfg->work_bytes the report derives:
+ *   IPC                     instructions / cycles
+ *   nominal GB/s            declared bytes / time
+ *   DRAM GB/s (derived)     LLC misses * 64 bytes / time
+ *   arithmetic intensity    ops per byte (declared bytes, else derived)
+ *   roofline                attainable = min(peak ops, AI * peak GB/s)
+ *
+ * Peaks come from PERF_PEAK_GOPS and PERF_PEAK_GBS; without
+ * PERF_PEAK_GBS a short parallel read is timed once to estimate it.
+ *
+ * If counters are not permitted (perf_event_paranoid, containers, VMs
+ * without a PMU) a note is printed and benchmarks fall back to timing only.
+ * Idle OpenMP workers are counted too, so single-threaded variants include
+ * their spin-wait.
+ *
+ * Usage: perf_counters pc; bench_init(&cfg, ...); perf_attach(&cfg, &pc);
+ *        ... bench_run(...) ...; perf_detach(&pc);
+ */
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include "bench.h"
+#include <stdint.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PERF_MAX_THREADS 256
+#define PERF_NUM_EVENTS 4
+#define PERF_LINE_BYTES 64
+#define PERF_BW_PROBE_BYTES (256LL << 20)
+
+typedef struct {
+    int enabled;                          // BENCH_COUNTERS requested
+    int available;                        // At least cycles opened on every thread
+    int nthreads;
+    int fd[PERF_MAX_THREADS][PERF_NUM_EVENTS];
+    double peak_gops;                     // 0 when unknown
+    double peak_gbs;
+    char reason[128];
+} perf_counters;
+
+static const char *perf_event_names[PERF_NUM_EVENTS] = {"cycles", "instructions", "llc_misses", "branch_misses"};
+static const uint64_t perf_event_configs[PERF_NUM_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+static inline int perf_open_event(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // Calling thread, any CPU
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/*
+ * Estimate sustainable read bandwidth with one parallel pass over a
+ * buffer much larger than the caches
+ */
+static inline double perf_probe_bandwidth(void) {
+    long long n = PERF_BW_PROBE_BYTES / sizeof(double);
+    double *buf = (double *)malloc(PERF_BW_PROBE_BYTES);
+    if (buf == NULL) {
+        return 0.0;
+    }
+    double best = 0.0, sink = 0.0;
+
+#pragma omp parallel for schedule(static)
+    for (long long i = 0; i < n; i++) {
+        buf[i] = 1.0;
+    }
+    for (int rep = 0; rep < 3; rep++) {
+        double sum = 0.0;
+        double start = bench_now();
+#pragma omp parallel for simd schedule(static) reduction(+:sum)
+        for (long long i = 0; i < n; i++) {
+            sum += buf[i];
+        }
+        double gbs = PERF_BW_PROBE_BYTES / (bench_now() - start) * 1e-9;
+        best = gbs > best ? gbs : best;
+        sink += sum;
+    }
+
+    free(buf);
+    return sink > 0.0 ? best : 0.0;
+}
+
+static inline void perf_counters_begin(void *state) {
+    perf_counters *pc = (perf_counters *)state;
+    for (int t = 0; t < pc->nthreads; t++) {
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            if (pc->fd[t][e] >= 0) {
+                ioctl(pc->fd[t][e], PERF_EVENT_IOC_RESET, 0);
+                ioctl(pc->fd[t][e], PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+}
+
+/*
+ * Stop the counters, aggregate them over threads and report one record
+ * for the region that ran reps times in seconds total
+ */
+static inline void perf_counters_end(void *state, bench_config *cfg, const char *name,
+                                     double seconds, int reps) {
+    perf_counters *pc = (perf_counters *)state;
+    double total[PERF_NUM_EVENTS] = {0};
+    int have[PERF_NUM_EVENTS] = {0};
+
+    for (int t = 0; t < pc->nthreads; t++) {
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            uint64_t v[3];  // value, time enabled, time running
+            if (pc->fd[t][e] < 0) {
+                continue;
+            }
+            ioctl(pc->fd[t][e], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(pc->fd[t][e], v, sizeof(v)) != sizeof(v)) {
+                continue;
+            }
+            // Scale up when the PMU was multiplexed between events
+            total[e] += v[2] > 0 ? (double)v[0] * v[1] / v[2] : 0.0;
+            have[e] = 1;
+        }
+    }
+
+    // Per-repetition values
+    for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+        total[e] /= reps;
+    }
+    double time = seconds / reps;
+    double ipc = have[0] && have[1] && total[0] > 0 ? total[1] / total[0] : NAN;
+    double dram_bytes = have[2] ? total[2] * PERF_LINE_BYTES : NAN;
+    double bytes = cfg->work_bytes > 0 ? cfg->work_bytes : dram_bytes;
+    double nominal_gbs = cfg->work_bytes > 0 ? cfg->work_bytes / time * 1e-9 : NAN;
+    double dram_gbs = dram_bytes / time * 1e-9;
+    double gops = cfg->work_ops > 0 ? cfg->work_ops / time * 1e-9 : NAN;
+    double ai = cfg->work_ops > 0 && bytes > 0 ? cfg->work_ops / bytes : NAN;
+    double attainable = NAN;
+    if (!isnan(ai) && pc->peak_gbs > 0) {
+        attainable = ai * pc->peak_gbs;
+        if (pc->peak_gops > 0 && pc->peak_gops < attainable) {
+            attainable = pc->peak_gops;
+        }
+    }
+    double roofline = gops / attainable;
+
+    if (cfg->format == BENCH_CSV) {
+        bench_csv_header(cfg);
+        fprintf(cfg->out, "counters,%s,%s,,%d,%lld,,,,,,,,,,,,%.0f,%.0f,%.0f,%.0f,%.4f,%.4f,%.4f,%.4f,"
+                "%.6f,%.4f,%.4f\n", cfg->program, name, pc->nthreads, cfg->size,
+                total[0], total[1], total[2], total[3],
+                ipc, nominal_gbs, dram_gbs, gops, ai, attainable, roofline);
+    } else if (cfg->format == BENCH_JSON) {
+        fprintf(cfg->out, "{\"record\":\"counters\",\"program\":\"%s\",\"variant\":\"%s\","
+                "\"threads\":%d,\"size\":%lld", cfg->program, name, pc->nthreads, cfg->size);
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            fprintf(cfg->out, ",\"%s\":%.0f", perf_event_names[e], total[e]);
+        }
+        const char *keys[7] = {"ipc", "nominal_gbs", "dram_gbs", "gops", "ai_ops_per_byte",
+                               "attainable_gops", "roofline_fraction"};
+        double vals[7] = {ipc, nominal_gbs, dram_gbs, gops, ai, attainable, roofline};
+        for (int i = 0; i < 7; i++) {
+            // JSON has no NaN, unknown metrics become null
+            if (isnan(vals[i]) || isinf(vals[i])) {
+                fprintf(cfg->out, ",\"%s\":null", keys[i]);
+            } else {
+                fprintf(cfg->out, ",\"%s\":%.6g", keys[i], vals[i]);
+            }
+        }
+        fprintf(cfg->out, "}\n");
+    } else {
+        fprintf(cfg->out, "   [%s] IPC=%.2f LLC-miss=%.3g branch-miss=%.3g GB/s nominal=%.2f DRAM=%.2f\n",
+                name, ipc, total[2], total[3], nominal_gbs, dram_gbs);
+        if (!isnan(ai)) {
+            fprintf(cfg->out, "   [%s] roofline: AI=%.4f ops/B, %.2f Gops/s of %.2f attainable (%.0f%%)\n",
+                    name, ai, gops, attainable, roofline * 100);
+        }
+    }
+    fflush(cfg->out);
+}
+
+/*
+ * Open the counters on every OpenMP thread of the current team size and
+ * hook them into cfg. Does nothing unless BENCH_COUNTERS is set; prints a
+ * note and keeps timing only when the counters cannot be opened.
+ */
+static inline void perf_attach(bench_config *cfg, perf_counters *pc) {
+    memset(pc, 0, sizeof(*pc));
+    pc->enabled = bench_env_int("BENCH_COUNTERS", 0);
+    if (!pc->enabled) {
+        return;
+    }
+
+    pc->nthreads = omp_get_max_threads();
+    if (pc->nthreads > PERF_MAX_THREADS) {
+        pc->nthreads = PERF_MAX_THREADS;
+    }
+    for (int t = 0; t < PERF_MAX_THREADS; t++) {
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            pc->fd[t][e] = -1;
+        }
+    }
+
+    int failed = 0, first_errno = 0;
+#pragma omp parallel num_threads(pc->nthreads) reduction(+:failed)
+    {
+        int tid = omp_get_thread_num();
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            pc->fd[tid][e] = perf_open_event(perf_event_configs[e]);
+            if (pc->fd[tid][e] < 0 && e == 0) {
+                failed++;
+#pragma omp critical
+                first_errno = errno;
+            }
+        }
+    }
+
+    if (failed > 0) {
+        snprintf(pc->reason, sizeof(pc->reason), "perf_event_open: %s", strerror(first_errno));
+        fprintf(stderr, "Note: hardware counters unavailable (%s), timing only\n", pc->reason);
+        for (int t = 0; t < pc->nthreads; t++) {
+            for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+                if (pc->fd[t][e] >= 0) {
+                    close(pc->fd[t][e]);
+                }
+                pc->fd[t][e] = -1;
+            }
+        }
+        return;
+    }
+
+    pc->available = 1;
+    const char *gops = getenv("PERF_PEAK_GOPS");
+    const char *gbs = getenv("PERF_PEAK_GBS");
+    pc->peak_gops = gops != NULL ? atof(gops) : 0.0;
+    pc->peak_gbs = gbs != NULL ? atof(gbs) : perf_probe_bandwidth();
+    fprintf(stderr, "Counters: %d threads, peak %.2f GB/s%s, peak Gops/s %s\n", pc->nthreads,
+            pc->peak_gbs, gbs != NULL ? "" : " (probed)", gops != NULL ? gops : "unknown");
+
+    cfg->counters = pc;
+    cfg->counters_begin = perf_counters_begin;
+    cfg->counters_end = perf_counters_end;
+}
+
+static inline void perf_detach(perf_counters *pc) {
+    if (!pc->available) {
+        return;
+    }
+    for (int t = 0; t < pc->nthreads; t++) {
+        for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+            if (pc->fd[t][e] >= 0) {
+                close(pc->fd[t][e]);
+            }
+        }
+    }
+    pc->available = 0;
+}
+
+#endif /* PERFCOUNTERS_H */
@@ -1,24 +1,101 @@
+/*
+ * Compile: gcc -fopenmp -O2 pi.c -o pi -lm
+ * Run: ./pi [num_steps] [threads]
+ * Midpoint-rule pi with "parallel for reduction" over the steps (1e6 by default).
+ * Sweep: ./pi --sweep [thread_list] [step_list]   (e.g. 1,2,4,max 1e8,1e9)
+ */
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <string.h>
 #include <omp.h>
+#include "bench.h"
+#include "perfcounters.h"
+#include "pikernel.h"
 
 static long num_steps = 1000000;
 double step;
 
-int main()
+static double compute_pi_scalar(void *ctx)
 {
-    int i;
-    double x, pi, sum = 0.0;
-    step = 1.0 / (double)num_steps;
-    double start_time = omp_get_wtime();
+    (void)ctx;
+    long i;
+    double x, sum = 0.0;
     #pragma omp parallel for reduction(+:sum) private(x)
     for (i = 0; i < num_steps; i++)
     {
         x = (i + 0.5) * step;
         sum = sum + 4.0 / (1.0 + x * x);
     }
-    pi = step * sum;
-    printf(" Approximation of Pi : %.10f\n", pi);
-    printf(" Time taken: %f seconds\n", omp_get_wtime() - start_time);
-    return 0;
+    return step * sum;
+}
+
+// ctx points to the rcp flag of pi_midpoint_sum()
+static double compute_pi(void *ctx)
+{
+    int rcp = ctx != NULL && *(int *)ctx;
+    long blocks = (num_steps + PI_BLOCK - 1) / PI_BLOCK;
+    double sum = 0.0;
+    #pragma omp parallel for reduction(+:sum)
+    for (long b = 0; b < blocks; b++)
+    {
+        long first = b * PI_BLOCK;
+        long count = first + PI_BLOCK <= num_steps ? PI_BLOCK : num_steps - first;
+        sum = sum + pi_midpoint_sum(first, count, 1, step, rcp);
+    }
+    return step * sum;
+}
+
+static double compute_pi_steps(void *ctx, long long steps)
+{
+    num_steps = steps;
+    step = 1.0 / (double)num_steps;
+    return compute_pi(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--sweep") != 0)
+    {
+        num_steps = (long)atof(argv[1]);
+        if (argc > 2)
+            omp_set_num_threads(atoi(argv[2]));
+        if (num_steps < 1)
+        {
+            printf("Usage: %s [num_steps] [threads]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_config cfg;
+    bench_init(&cfg, "pi");
+    cfg.threads = omp_get_max_threads();
+    cfg.size = num_steps;
+
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+        long long threads[BENCH_MAX_LIST], sizes[BENCH_MAX_LIST];
+        int nthreads, nsizes;
+        if (!bench_parse_sweep(argc, argv, 2, num_steps, threads, &nthreads, sizes, &nsizes))
+            return 1;
+        bench_sweep(&cfg, "parallel for simd", compute_pi_steps, NULL, threads, nthreads, sizes, nsizes, bench_weak_linear);
+        bench_finish(&cfg);
+        return 0;
+    }
+
+    step = 1.0 / (double)num_steps;
+    perf_counters pc;
+    perf_attach(&cfg, &pc);
+    cfg.work_ops = PI_OPS_PER_STEP * num_steps;
+    int div = 0, rcp = 1;
+    bench_result s = bench_run(&cfg, "parallel for", compute_pi_scalar, NULL, M_PI, 1e-10);
+    bench_result r = bench_run(&cfg, "parallel for simd", compute_pi, &div, M_PI, 1e-10);
+    bench_result q = bench_run(&cfg, "parallel for simd rcp", compute_pi, &rcp, M_PI, 1e-10);
+    perf_detach(&pc);
+    printf(" Approximation of Pi : %.10f\n", r.value);
+    printf(" Steps: %ld, threads: %d\n", num_steps, omp_get_max_threads());
+    printf(" Time taken: %f seconds (scalar %f, reciprocal %f)\n", r.median, s.median, q.median);
+    printf(" SIMD speedup over scalar: %.2fx, %.2fx with reciprocal\n", s.median / r.median, s.median / q.median);
+
+    bench_finish(&cfg);
+    return cfg.failures != 0;
 }
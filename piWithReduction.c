@@ -1,15 +1,25 @@
+/*
+ * Compile: gcc -fopenmp -O2 piWithReduction.c -o piWithReduction -lm
+ * Run: ./piWithReduction [num_steps] [threads]
+ * Midpoint-rule pi with "parallel for reduction" over 1.5e9 steps by default.
+ * Sweep: ./piWithReduction --sweep [thread_list] [step_list]   (e.g. 1,2,4,max 1e8,1e9)
+ */
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
 #include <omp.h>
+#include "bench.h"
+#include "perfcounters.h"
+#include "pikernel.h"
 
 static long num_steps = 1500000000;
 double step;
 
-int main()
+static double compute_pi_scalar(void *ctx)
 {
+    (void)ctx;
     double sum = 0.0;
-    step = 1.0 / (double)num_steps;
-
-    double start_time = omp_get_wtime();
 
 #pragma omp parallel for reduction(+ : sum)
     for (long i = 0; i < num_steps; i++)
@@ -18,10 +28,78 @@ int main()
         sum += 4.0 / (1.0 + x * x);
     }
 
-    double pi = step * sum;
-    double time_taken = omp_get_wtime() - start_time;
+    return step * sum;
+}
+
+// ctx points to the rcp flag of pi_midpoint_sum()
+static double compute_pi(void *ctx)
+{
+    int rcp = ctx != NULL && *(int *)ctx;
+    long blocks = (num_steps + PI_BLOCK - 1) / PI_BLOCK;
+    double sum = 0.0;
+
+#pragma omp parallel for reduction(+ : sum)
+    for (long b = 0; b < blocks; b++)
+    {
+        long first = b * PI_BLOCK;
+        long count = first + PI_BLOCK <= num_steps ? PI_BLOCK : num_steps - first;
+        sum += pi_midpoint_sum(first, count, 1, step, rcp);
+    }
+
+    return step * sum;
+}
+
+static double compute_pi_steps(void *ctx, long long steps)
+{
+    num_steps = steps;
+    step = 1.0 / (double)num_steps;
+    return compute_pi(ctx);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--sweep") != 0)
+    {
+        num_steps = (long)atof(argv[1]);
+        if (argc > 2)
+            omp_set_num_threads(atoi(argv[2]));
+        if (num_steps < 1)
+        {
+            printf("Usage: %s [num_steps] [threads]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    bench_config cfg;
+    bench_init(&cfg, "piWithReduction");
+    cfg.threads = omp_get_max_threads();
+    cfg.size = num_steps;
+
+    if (argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+        long long threads[BENCH_MAX_LIST], sizes[BENCH_MAX_LIST];
+        int nthreads, nsizes;
+        if (!bench_parse_sweep(argc, argv, 2, num_steps, threads, &nthreads, sizes, &nsizes))
+            return 1;
+        bench_sweep(&cfg, "reduction simd", compute_pi_steps, NULL, threads, nthreads, sizes, nsizes, bench_weak_linear);
+        bench_finish(&cfg);
+        return 0;
+    }
+
+    step = 1.0 / (double)num_steps;
+
+    perf_counters pc;
+    perf_attach(&cfg, &pc);
+    cfg.work_ops = PI_OPS_PER_STEP * num_steps;
+    int div = 0, rcp = 1;
+    bench_result s = bench_run(&cfg, "reduction", compute_pi_scalar, NULL, M_PI, 1e-10);
+    bench_result r = bench_run(&cfg, "reduction simd", compute_pi, &div, M_PI, 1e-10);
+    bench_result q = bench_run(&cfg, "reduction simd rcp", compute_pi, &rcp, M_PI, 1e-10);
+    perf_detach(&pc);
 
-    printf("%f\n", time_taken);
+    printf("Approximation of Pi: %.10f (%s)\n", r.value, r.correct && q.correct ? "Correct" : "INCORRECT!");
+    printf("SIMD speedup over scalar: %.2fx, %.2fx with reciprocal\n", s.median / r.median, s.median / q.median);
+    printf("%f\n", r.median);
 
-    return 0;
+    bench_finish(&cfg);
+    return cfg.failures != 0;
 }
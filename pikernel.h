@@ -0,0 +1,127 @@
+/*
+ * pikernel.h - Vectorized midpoint-rule kernel for pi = integral of 4/(1+x^2)
+ *
+ * pi_midpoint_sum() sums f(x_i) = 4/(1+x_i^2), x_i = (i + 0.5) * step, over
+ * the indices i = first + j * stride, j in [0, count). The loop keeps
+ * PI_ACCUMULATORS independent 8-wide vector accumulators so consecutive
+ * adds do not wait on each other, and advances the x vectors by adding a
+ * constant instead of converting the index every step. x is recomputed
+ * exactly from the index at the start of every PI_BLOCK steps, so the
+ * incremental update cannot drift, and each block sum is added to the
+ * running total separately (two-level summation).
+ *
+ * With rcp set the division is replaced by a reciprocal computed with
+ * multiplies and adds only (see PI_RECIP), accurate to rounding.
+ *
+ * On x86-64 the kernel is cloned for AVX2/FMA and AVX-512 and picked at
+ * load time, so plain -O2 builds still use the wide units.
+ *
+ * Used by pi.c, blockpi.c, cyclicpi.c and piWithReduction.c. Each runs
+ * three variants: its original scalar loop, the kernel dividing and the
+ * kernel with the reciprocal ("rcp"). The loop does no memory traffic, so
+ * with BENCH_COUNTERS=1 only PI_OPS_PER_STEP is declared as work.
+ */
+
+#ifndef PIKERNEL_H
+#define PIKERNEL_H
+
+#define PI_LANES 8
+#define PI_ACCUMULATORS 4
+#define PI_BLOCK 4096    // Steps between exact recomputation of x, multiple of 32
+
+// Per step of the original scalar loop: add, multiply, multiply-add, add, divide, add
+#define PI_OPS_PER_STEP 6.0
+
+typedef double pi_vec __attribute__((vector_size(PI_LANES * sizeof(double))));
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define PI_KERNEL_CLONES __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default")))
+#else
+#define PI_KERNEL_CLONES
+#endif
+
+/*
+ * 1/d for d in [1, 2] without a divide: the linear estimate 24/17 - 8/17 d
+ * (relative error <= 1/17) refined by four Newton steps r' = r (2 - d r),
+ * which square the error each time. Only multiplies and adds, so it runs
+ * on the FMA units instead of the much slower vector divider.
+ */
+#define PI_RECIP(r, d)                                \
+    do {                                              \
+        (r) = 24.0 / 17.0 - (8.0 / 17.0) * (d);       \
+        (r) = (r) * (2.0 - (d) * (r));                \
+        (r) = (r) * (2.0 - (d) * (r));                \
+        (r) = (r) * (2.0 - (d) * (r));                \
+        (r) = (r) * (2.0 - (d) * (r));                \
+    } while (0)
+
+// acc += 4/(1+x^2); macros rather than functions keep wide vectors out of the ABI
+#define PI_TERM(acc, x, rcp)                          \
+    do {                                              \
+        pi_vec d_ = 1.0 + (x) * (x);                  \
+        if (rcp) {                                    \
+            pi_vec r_;                                \
+            PI_RECIP(r_, d_);                         \
+            (acc) += 4.0 * r_;                        \
+        } else {                                      \
+            (acc) += 4.0 / d_;                        \
+        }                                             \
+    } while (0)
+
+/*
+ * One block of PI_BLOCK steps whose first x is x_first, steps dx apart.
+ * rcp is a compile-time constant at both call sites.
+ */
+static inline __attribute__((always_inline)) double pi_block_sum(double x_first, double dx, int rcp) {
+    const pi_vec lane = {0, 1, 2, 3, 4, 5, 6, 7};
+    pi_vec x0 = x_first + lane * dx;
+    pi_vec x1 = x0 + PI_LANES * dx;
+    pi_vec x2 = x0 + 2 * PI_LANES * dx;
+    pi_vec x3 = x0 + 3 * PI_LANES * dx;
+    // Named rather than an array so they stay in registers at -O2
+    pi_vec acc0 = {0}, acc1 = {0}, acc2 = {0}, acc3 = {0};
+    const double advance = PI_ACCUMULATORS * PI_LANES * dx;
+
+    for (int k = 0; k < PI_BLOCK; k += PI_ACCUMULATORS * PI_LANES) {
+        PI_TERM(acc0, x0, rcp);
+        PI_TERM(acc1, x1, rcp);
+        PI_TERM(acc2, x2, rcp);
+        PI_TERM(acc3, x3, rcp);
+        x0 += advance;
+        x1 += advance;
+        x2 += advance;
+        x3 += advance;
+    }
+
+    pi_vec v = (acc0 + acc1) + (acc2 + acc3);
+    double sum = 0.0;
+    for (int l = 0; l < PI_LANES; l++) {
+        sum += v[l];
+    }
+    return sum;
+}
+
+/*
+ * Sum of 4/(1+x^2) at x = (first + j * stride + 0.5) * step, j in [0, count)
+ * Multiply by step for the integral.
+ */
+PI_KERNEL_CLONES
+static double pi_midpoint_sum(long long first, long long count, long long stride, double step, int rcp) {
+    const double dx = (double)stride * step;
+    double total = 0.0;
+    long long j = 0;
+
+    for (; j + PI_BLOCK <= count; j += PI_BLOCK) {
+        double x_first = ((double)(first + j * stride) + 0.5) * step;
+        total += rcp ? pi_block_sum(x_first, dx, 1) : pi_block_sum(x_first, dx, 0);
+    }
+
+    double tail = 0.0;
+    for (; j < count; j++) {
+        double x = ((double)(first + j * stride) + 0.5) * step;
+        tail += 4.0 / (1.0 + x * x);
+    }
+    return total + tail;
+}
+
+#endif /* PIKERNEL_H */
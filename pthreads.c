@@ -1,59 +1,594 @@
+/*
+ * Leibniz series for pi on a persistent pthread worker pool
+ *
+ * pi = 4 * sum_i (-1)^i / (2i + 1). The series is summed with 64-bit
+ * indices by a branch-free vector kernel with compensated accumulation,
+ * and three modes are compared for a target error:
+ *   direct      plain partial sum, error ~ 1/N, so N ~ 1/target terms
+ *   richardson  short partial sum plus the Euler-number expansion of the
+ *               remainder, error ~ E_2K / N^(2K+1)
+ *   euler       Euler transform of the alternating series, error ~ 2^-n
+ *
+ * The pool creates its workers once, pins each to its own core and hands
+ * out jobs through a generation counter: workers spin briefly and then
+ * sleep on a futex until the next job is published. The calling thread
+ * runs part 0 of every job itself. Each worker writes its result to a
+ * cache-line-padded slot, so neighbouring results never share a line.
+ *
+ * Besides computing pi, the program measures per-job dispatch latency
+ * (empty jobs) and throughput for repeated small jobs on the pool, with a
+ * fresh pthread_create/pthread_join per job and with an OpenMP parallel
+ * region.
+ *
+ * Compile: gcc -O2 -fopenmp -pthread pthreads.c -o pthreads -lm
+ *          (no -ffast-math: it would optimize the compensation away)
+ * Run: ./pthreads <target-error | iterations> [threads]
+ *      A value >= 1 is an iteration count N, read as target error 1/N.
+ *      Threads default to OMP_NUM_THREADS, else the number of online CPUs.
+ */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <omp.h>
+#include "bench.h"
 
-#define NUM_THREADS 4
+#define CACHE_LINE 64
+#define POOL_SPIN 4000        // Polls before a waiting thread sleeps on the futex
+#define LATENCY_JOBS 10000    // Empty jobs per latency measurement
+#define CREATE_JOBS 500       // Create/join is much slower, fewer repetitions
+#define SMALL_JOB_ITERATIONS 100000
+#define DIRECT_MAX_TERMS 10000000000LL  // Direct mode is skipped beyond this
+#define MIN_TARGET 1e-15                // Below this rounding dominates
+#define RICHARDSON_TERMS 6              // Correction terms E_0 .. E_10
+#define EULER_MAX_TERMS 64
 
-int total_iterations;
-double partial_sums[NUM_THREADS];
+typedef double v4d __attribute__((vector_size(32)));
 
-void *calculate_part(void *arg) {
-    int thread_id = *(int *)arg;
-    int start = (total_iterations / NUM_THREADS) * thread_id;
-    int end = (thread_id == NUM_THREADS - 1) ? total_iterations : start + (total_iterations / NUM_THREADS);
-    
-    double sum = 0.0;
-    for (int i = start; i < end; i++) {
-        if (i % 2 == 0)
-            sum += 1.0 / (2 * i + 1);
-        else
-            sum -= 1.0 / (2 * i + 1);
+// One result per worker, padded to a full cache line to avoid false sharing
+typedef struct {
+    double value;
+    char pad[CACHE_LINE - sizeof(double)];
+} __attribute__((aligned(CACHE_LINE))) padded_slot;
+
+// A job is run once by every worker: worker id in [0, nworkers)
+typedef void (*pool_job_fn)(void *arg, int worker, int nworkers);
+
+typedef struct {
+    int nthreads;
+    pthread_t *threads;
+    padded_slot *results;
+    pool_job_fn job;
+    void *arg;
+    int shutdown;
+    int spin;            // Polls before sleeping, 0 when oversubscribed
+    cpu_set_t affinity;  // Caller's mask before pool_init pinned it
+    void *args;          // Per-worker start arguments, owned by the pool
+    // Futex words, each on its own line
+    _Alignas(CACHE_LINE) atomic_int generation;  // Bumped once per published job
+    atomic_int sleepers;                         // Workers blocked on generation
+    _Alignas(CACHE_LINE) atomic_int remaining;   // Workers still running the job
+    atomic_int caller_waiting;                   // Caller blocked on remaining
+} thread_pool;
+
+typedef struct {
+    thread_pool *pool;
+    int id;
+    int cpu;             // CPU to pin to, -1 to leave the mask alone
+} worker_arg;
+
+// Pi job: the series range split evenly over the workers
+typedef struct {
+    long long iterations;
+    padded_slot *results;
+} pi_job;
+
+static long futex_wait(atomic_int *addr, int expected) {
+    return syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static long futex_wake(atomic_int *addr, int count) {
+    return syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// The index-th CPU in allowed (wrapping around), -1 if the set is empty
+static int nth_cpu(const cpu_set_t *allowed, int index) {
+    if (CPU_COUNT(allowed) == 0) {
+        return -1;
     }
-    
-    partial_sums[thread_id] = sum;
+    int target = index % CPU_COUNT(allowed);
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, allowed) && target-- == 0) {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+static void pin_to_cpu(int cpu) {
+    cpu_set_t one;
+    if (cpu < 0) {
+        return;
+    }
+    CPU_ZERO(&one);
+    CPU_SET(cpu, &one);
+    pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+}
+
+// Neumaier summation: also exact when the addend is larger than the sum
+static inline void neumaier_add(double *sum, double *comp, double x) {
+    double t = *sum + x;
+    if (fabs(*sum) >= fabs(x)) {
+        *comp += (*sum - t) + x;
+    } else {
+        *comp += (x - t) + *sum;
+    }
+    *sum = t;
+}
+
+/*
+ * Sum the Leibniz terms [start, end) of sum (-1)^i / (2i + 1)
+ *
+ * Terms are taken in pairs, 1/(4k+1) - 1/(4k+3) = 2/((4k+1)(4k+3)), so
+ * every summand is positive and one division covers two terms. The loop
+ * has no branch: eight pairs per iteration in two vectors, the
+ * denominators advanced by adding a constant, and a Kahan-compensated
+ * accumulator per lane.
+ */
+double calculate_part(long long start, long long end) {
+    double sum = 0.0, comp = 0.0;
+    if (start >= end) {
+        return 0.0;
+    }
+    // Peel an odd first term and an unpaired last term
+    if (start & 1) {
+        neumaier_add(&sum, &comp, -1.0 / (2.0 * start + 1.0));
+        start++;
+    }
+    if ((end - start) & 1) {
+        end--;
+        neumaier_add(&sum, &comp, 1.0 / (2.0 * end + 1.0));
+    }
+
+    long long k = start / 2, kend = end / 2;
+    double x = 4.0 * k + 1.0;
+    v4d x0 = {x, x + 4.0, x + 8.0, x + 12.0};
+    v4d x1 = x0 + 16.0;
+    v4d s0 = {0}, s1 = {0}, c0 = {0}, c1 = {0};
+    for (; k + 8 <= kend; k += 8) {
+        v4d y0 = 2.0 / (x0 * (x0 + 2.0)) - c0;
+        v4d y1 = 2.0 / (x1 * (x1 + 2.0)) - c1;
+        v4d t0 = s0 + y0;
+        v4d t1 = s1 + y1;
+        c0 = (t0 - s0) - y0;
+        c1 = (t1 - s1) - y1;
+        s0 = t0;
+        s1 = t1;
+        x0 += 32.0;
+        x1 += 32.0;
+    }
+    for (int lane = 0; lane < 4; lane++) {
+        neumaier_add(&sum, &comp, s0[lane]);
+        neumaier_add(&sum, &comp, s1[lane]);
+        comp -= c0[lane] + c1[lane];
+    }
+    for (; k < kend; k++) {
+        x = 4.0 * k + 1.0;
+        neumaier_add(&sum, &comp, 2.0 / (x * (x + 2.0)));
+    }
+    return sum + comp;
+}
+
+static void pi_job_run(void *arg, int worker, int nworkers) {
+    pi_job *job = (pi_job *)arg;
+    long long chunk = job->iterations / nworkers;
+    long long start = chunk * worker;
+    long long end = (worker == nworkers - 1) ? job->iterations : start + chunk;
+    job->results[worker].value = calculate_part(start, end);
+}
+
+// Euler numbers E_0, E_2, ..., E_12
+static const double euler_numbers[RICHARDSON_TERMS + 1] = {1, -1, 5, -61, 1385, -50521, 2702765};
+
+/*
+ * Remainder of the Leibniz sum for pi after n terms
+ *   pi - 4 S_n ~ (-1)^n 2 sum_m E_2m / (2n)^(2m+1)
+ * truncated after RICHARDSON_TERMS terms
+ */
+static double leibniz_remainder(long long n) {
+    double h = 1.0 / (2.0 * n), h2 = h * h, r = 0.0;
+    for (int m = RICHARDSON_TERMS - 1; m >= 0; m--) {
+        r = r * h2 + euler_numbers[m];
+    }
+    return (n & 1 ? -2.0 : 2.0) * h * r;
+}
+
+// Terms so that the first omitted correction is below a quarter of target
+static long long richardson_terms(double target) {
+    double e = fabs(euler_numbers[RICHARDSON_TERMS]);
+    long long n = (long long)ceil(0.5 * pow(8.0 * e / target, 1.0 / (2 * RICHARDSON_TERMS + 1)));
+    return n < 2 ? 2 : n;
+}
+
+/*
+ * Euler transform of sum (-1)^k a_k with a_k = 1/(2k+1):
+ *   sum_j (-1)^j D^j a_0 / 2^(j+1)
+ * using terms forward differences of the first terms terms
+ */
+static double euler_transform_pi(int terms) {
+    double a[EULER_MAX_TERMS];
+    double sum = 0.0, comp = 0.0, scale = 0.5;
+    for (int k = 0; k < terms; k++) {
+        a[k] = 1.0 / (2.0 * k + 1.0);
+    }
+    for (int j = 0; j < terms; j++) {
+        neumaier_add(&sum, &comp, (j & 1 ? -scale : scale) * a[0]);
+        for (int k = 0; k < terms - j - 1; k++) {
+            a[k] = a[k + 1] - a[k];
+        }
+        scale *= 0.5;
+    }
+    return 4.0 * (sum + comp);
+}
+
+// The transformed terms shrink roughly like 2^-j
+static int euler_terms(double target) {
+    int n = (int)ceil(log2(4.0 / target)) + 2;
+    return n > EULER_MAX_TERMS ? EULER_MAX_TERMS : n;
+}
+
+static void *pool_worker(void *arg) {
+    thread_pool *pool = ((worker_arg *)arg)->pool;
+    int id = ((worker_arg *)arg)->id;
+    int seen = 0;
+    pin_to_cpu(((worker_arg *)arg)->cpu);
+
+    for (;;) {
+        int gen, spins = 0;
+        while ((gen = atomic_load(&pool->generation)) == seen) {
+            if (++spins < pool->spin) {
+                cpu_relax();
+                continue;
+            }
+            // Announce the sleep before checking generation again in the kernel;
+            // pool_run bumps generation before reading sleepers
+            atomic_fetch_add(&pool->sleepers, 1);
+            futex_wait(&pool->generation, seen);
+            atomic_fetch_sub(&pool->sleepers, 1);
+            spins = 0;
+        }
+        seen = gen;
+        if (pool->shutdown) {
+            return NULL;
+        }
+
+        pool->job(pool->arg, id, pool->nthreads);
+
+        if (atomic_fetch_sub(&pool->remaining, 1) == 1 && atomic_load(&pool->caller_waiting)) {
+            futex_wake(&pool->remaining, 1);
+        }
+    }
+}
+
+/*
+ * Create nthreads - 1 pinned workers; the caller becomes worker 0
+ * Workers are spread over the CPUs the caller may run on when it is called;
+ * pool_unpin_caller gives that mask back to the caller. Returns 0 on success
+ */
+int pool_init(thread_pool *pool, int nthreads) {
+    memset(pool, 0, sizeof(*pool));
+    pool->nthreads = nthreads;
+    // Taken before any pinning: threads created later inherit the caller's mask
+    int known = sched_getaffinity(0, sizeof(pool->affinity), &pool->affinity) == 0;
+    int cpus = known ? CPU_COUNT(&pool->affinity) : 1;
+    // Spinning only pays off when every worker has a core of its own
+    pool->spin = nthreads <= cpus ? POOL_SPIN : 0;
+    pool->threads = malloc(sizeof(pthread_t) * nthreads);
+    pool->results = aligned_alloc(CACHE_LINE, sizeof(padded_slot) * nthreads);
+    worker_arg *args = malloc(sizeof(worker_arg) * nthreads);
+    if (pool->threads == NULL || pool->results == NULL || args == NULL) {
+        return -1;
+    }
+
+    for (int i = 1; i < nthreads; i++) {
+        args[i].pool = pool;
+        args[i].id = i;
+        args[i].cpu = known ? nth_cpu(&pool->affinity, i) : -1;
+        if (pthread_create(&pool->threads[i], NULL, pool_worker, &args[i]) != 0) {
+            return -1;
+        }
+    }
+    pool->args = args;
+    if (known) {
+        pin_to_cpu(nth_cpu(&pool->affinity, 0));
+    }
+    return 0;
+}
+
+/* Give the caller back the mask it had before pool_init pinned it */
+void pool_unpin_caller(thread_pool *pool) {
+    if (CPU_COUNT(&pool->affinity) > 0) {
+        pthread_setaffinity_np(pthread_self(), sizeof(pool->affinity), &pool->affinity);
+    }
+}
+
+/* Run job on every worker and return when all of them have finished */
+void pool_run(thread_pool *pool, pool_job_fn job, void *arg) {
+    pool->job = job;
+    pool->arg = arg;
+    atomic_store(&pool->remaining, pool->nthreads - 1);
+    atomic_fetch_add(&pool->generation, 1);
+    if (atomic_load(&pool->sleepers) > 0) {
+        futex_wake(&pool->generation, INT_MAX);
+    }
+
+    job(arg, 0, pool->nthreads);
+
+    int left, spins = 0;
+    while ((left = atomic_load(&pool->remaining)) != 0) {
+        if (++spins < pool->spin) {
+            cpu_relax();
+            continue;
+        }
+        atomic_store(&pool->caller_waiting, 1);
+        futex_wait(&pool->remaining, left);
+        atomic_store(&pool->caller_waiting, 0);
+        spins = 0;
+    }
+}
+
+void pool_destroy(thread_pool *pool) {
+    pool->shutdown = 1;
+    atomic_fetch_add(&pool->generation, 1);
+    futex_wake(&pool->generation, INT_MAX);
+    for (int i = 1; i < pool->nthreads; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    free(pool->threads);
+    free(pool->results);
+    free(pool->args);
+}
+
+/* Dispatch alternatives for the same job, each running it on n threads */
+
+typedef struct {
+    pool_job_fn job;
+    void *arg;
+    int worker;
+    int nworkers;
+} create_arg;
+
+static void *create_start(void *p) {
+    create_arg *a = (create_arg *)p;
+    a->job(a->arg, a->worker, a->nworkers);
     return NULL;
 }
 
+// Fresh threads for every job, as the original program did
+static void create_join_run(int nthreads, pool_job_fn job, void *arg) {
+    pthread_t threads[nthreads];
+    create_arg args[nthreads];
+    for (int i = 1; i < nthreads; i++) {
+        args[i] = (create_arg){job, arg, i, nthreads};
+        pthread_create(&threads[i], NULL, create_start, &args[i]);
+    }
+    job(arg, 0, nthreads);
+    for (int i = 1; i < nthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static void openmp_run(int nthreads, pool_job_fn job, void *arg) {
+    #pragma omp parallel num_threads(nthreads)
+    job(arg, omp_get_thread_num(), nthreads);
+}
+
+enum { DISPATCH_POOL, DISPATCH_CREATE, DISPATCH_OPENMP };
+static const char *dispatch_names[3] = {"pool", "create/join", "openmp"};
+
+// Benchmark context: jobs of a given size dispatched repeatedly
+typedef struct {
+    thread_pool *pool;
+    int mechanism;
+    int jobs;
+    pi_job job;
+} dispatch_ctx;
+
+static void empty_job(void *arg, int worker, int nworkers) {
+    (void)arg;
+    (void)worker;
+    (void)nworkers;
+}
+
+static double sum_results(padded_slot *results, int n) {
+    double pi = 0.0, comp = 0.0;
+    for (int i = 0; i < n; i++) {
+        neumaier_add(&pi, &comp, results[i].value);
+    }
+    return (pi + comp) * 4.0;
+}
+
+static double bench_dispatch(void *c) {
+    dispatch_ctx *x = (dispatch_ctx *)c;
+    pool_job_fn fn = x->job.iterations > 0 ? pi_job_run : empty_job;
+    int n = x->pool->nthreads;
+
+    for (int j = 0; j < x->jobs; j++) {
+        if (x->mechanism == DISPATCH_POOL) {
+            pool_run(x->pool, fn, &x->job);
+        } else if (x->mechanism == DISPATCH_CREATE) {
+            create_join_run(n, fn, &x->job);
+        } else {
+            openmp_run(n, fn, &x->job);
+        }
+    }
+    return x->job.iterations > 0 ? sum_results(x->job.results, n) : 0.0;
+}
+
+enum { MODE_DIRECT, MODE_RICHARDSON, MODE_EULER };
+static const char *mode_names[3] = {"direct", "richardson", "euler"};
+
+typedef struct {
+    thread_pool *pool;
+    int mode;
+    pi_job job;          // Terms for the series modes
+} series_ctx;
+
+static double compute_pi(void *ctx) {
+    series_ctx *x = (series_ctx *)ctx;
+    if (x->mode == MODE_EULER) {
+        return euler_transform_pi((int)x->job.iterations);
+    }
+    pool_run(x->pool, pi_job_run, &x->job);
+    double pi = sum_results(x->job.results, x->pool->nthreads);
+    return x->mode == MODE_RICHARDSON ? pi + leibniz_remainder(x->job.iterations) : pi;
+}
+
+static long long mode_terms(int mode, double target) {
+    if (mode == MODE_DIRECT) {
+        // Error ~ 1/N, with a margin for rounding
+        return (long long)ceil(1.0 / (0.9 * target));
+    }
+    return mode == MODE_RICHARDSON ? richardson_terms(target) : euler_terms(target);
+}
+
 int main(int argc, char **argv) {
     if (argc < 2) {
-        printf("Usage: %s <iterations>\n", argv[0]);
+        printf("Usage: %s <target-error | iterations> [threads]\n", argv[0]);
         return 1;
     }
     
-    total_iterations = atoi(argv[1]);
-    printf("Calculating pi with %d iterations using %d threads...\n", total_iterations, NUM_THREADS);
+    double target = atof(argv[1]);
+    if (target >= 1.0) {
+        target = 1.0 / target;
+    }
+    int num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("OMP_NUM_THREADS");
+    if (argc > 2) {
+        num_threads = atoi(argv[2]);
+    } else if (env != NULL && atoi(env) > 0) {
+        num_threads = atoi(env);
+    }
+    if (!(target > 0.0) || num_threads < 1) {
+        printf("Usage: %s <target-error | iterations> [threads]\n", argv[0]);
+        return 1;
+    }
     
-    pthread_t threads[NUM_THREADS];
-    int thread_ids[NUM_THREADS];
+    // Before any output: in csv/json mode the records own stdout
+    bench_config cfg;
+    bench_init(&cfg, "pthreads");
+    cfg.threads = num_threads;
+    if (target < MIN_TARGET) {
+        printf("Note: target %.1e is below the rounding floor, using %.1e\n", target, MIN_TARGET);
+        target = MIN_TARGET;
+    }
+    printf("Calculating pi to an error of %.1e using %d threads...\n", target, num_threads);
     
-    // Create threads
-    for (int i = 0; i < NUM_THREADS; i++) {
-        thread_ids[i] = i;
-        pthread_create(&threads[i], NULL, calculate_part, &thread_ids[i]);
+    thread_pool pool;
+    if (pool_init(&pool, num_threads) != 0) {
+        fprintf(stderr, "Error: Failed to start the thread pool\n");
+        return 1;
     }
     
-    // Wait for threads to finish
-    for (int i = 0; i < NUM_THREADS; i++) {
-        pthread_join(threads[i], NULL);
+    // Error vs. time: every mode at each decade down to the target
+    typedef struct { double target; long long terms; double time, error; } mode_row;
+    mode_row rows[3][16];
+    int nrows = 0;
+    series_ctx sctx = {&pool, MODE_DIRECT, {0, pool.results}};
+    for (int decade = 2; nrows < 16; decade++) {
+        double row_target = pow(10.0, -decade) < 1.5 * target ? target : pow(10.0, -decade);
+        for (int m = 0; m < 3; m++) {
+            char name[48];
+            mode_row *row = &rows[m][nrows];
+            row->target = row_target;
+            row->terms = mode_terms(m, row_target);
+            if (m == MODE_DIRECT && row->terms > DIRECT_MAX_TERMS) {
+                row->time = row->error = NAN;
+                continue;
+            }
+            sctx.mode = m;
+            sctx.job.iterations = row->terms;
+            cfg.size = row->terms;
+            snprintf(name, sizeof(name), "%s %.0e", mode_names[m], row_target);
+            bench_result r = bench_run(&cfg, name, compute_pi, &sctx, M_PI, row_target);
+            row->time = r.median;
+            row->error = fabs(r.value - M_PI);
+        }
+        nrows++;
+        if (row_target == target) {
+            break;
+        }
     }
     
-    // Add up all partial results
-    double pi = 0.0;
-    for (int i = 0; i < NUM_THREADS; i++) {
-        pi += partial_sums[i];
+    printf("\n%-11s %9s %14s %14s %11s %7s\n", "Mode", "Target", "Terms", "Time (s)", "Error", "Met");
+    printf("----------------------------------------------------------------------\n");
+    for (int m = 0; m < 3; m++) {
+        for (int i = 0; i < nrows; i++) {
+            mode_row *row = &rows[m][i];
+            if (isnan(row->time)) {
+                printf("%-11s %9.1e %14lld %14s %11s %7s\n", mode_names[m], row->target, row->terms,
+                       "skipped", "-", "-");
+                continue;
+            }
+            printf("%-11s %9.1e %14lld %14.6f %11.2e %7s\n", mode_names[m], row->target, row->terms,
+                   row->time, row->error, row->error <= row->target ? "yes" : "no");
+        }
+    }
+    printf("Direct mode is skipped above %lld terms\n", DIRECT_MAX_TERMS);
+    printf("Direct throughput at the largest run: ");
+    for (int i = nrows - 1; i >= 0; i--) {
+        if (!isnan(rows[MODE_DIRECT][i].time)) {
+            printf("%.3f Gterms/s\n", rows[MODE_DIRECT][i].terms / rows[MODE_DIRECT][i].time * 1e-9);
+            break;
+        }
     }
-    pi *= 4.0;
     
-    printf("π ≈ %.15f\n", pi);
-    return 0;
+    dispatch_ctx ctx = {&pool, DISPATCH_POOL, 1, {0, pool.results}};
+    
+    // Dispatch latency (empty jobs) and small-job throughput per mechanism
+    double latency[3], throughput[3];
+    for (int m = 0; m < 3; m++) {
+        char name[48];
+        if (m == DISPATCH_CREATE) {
+            // Fresh threads and the OpenMP team inherit the caller's mask
+            pool_unpin_caller(&pool);
+        }
+        ctx.mechanism = m;
+        ctx.jobs = m == DISPATCH_CREATE ? CREATE_JOBS : LATENCY_JOBS;
+        
+        ctx.job.iterations = 0;
+        cfg.size = ctx.jobs;
+        snprintf(name, sizeof(name), "%s empty jobs", dispatch_names[m]);
+        latency[m] = bench_run(&cfg, name, bench_dispatch, &ctx, NAN, 0.0).median / ctx.jobs;
+        
+        ctx.jobs /= 10;
+        ctx.job.iterations = SMALL_JOB_ITERATIONS;
+        cfg.size = ctx.jobs;
+        snprintf(name, sizeof(name), "%s small jobs", dispatch_names[m]);
+        throughput[m] = ctx.jobs / bench_run(&cfg, name, bench_dispatch, &ctx, NAN, 0.0).median;
+    }
+    
+    printf("\n%-14s %22s %26s\n", "Mechanism", "Dispatch latency (us)", "Small jobs per second");
+    printf("----------------------------------------------------------------\n");
+    for (int m = 0; m < 3; m++) {
+        printf("%-14s %22.3f %26.0f\n", dispatch_names[m], latency[m] * 1e6, throughput[m]);
+    }
+    printf("Small job: %d series terms split over %d threads\n", SMALL_JOB_ITERATIONS, num_threads);
+    
+    pool_destroy(&pool);
+    bench_finish(&cfg);
+    return cfg.failures != 0;
 }
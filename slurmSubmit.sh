@@ -18,13 +18,20 @@
 
 export OMP_NUM_THREADS=8
 #cd /path/to/bin
-sum=0
 
-for i in {1..20}; do
-    t=$(./sum_taskloop)
-    echo "Run $i: $t"
-    sum=$(echo "$sum + $t" | bc -l)
-done
+# The benchmark harness (bench.h) repeats and summarizes the runs itself;
+# records go to stdout as CSV, human-readable output to the .err file.
+export BENCH_WARMUP=1
+export BENCH_REPS=20
+export BENCH_FORMAT=csv
 
-avg=$(echo "$sum / 20" | bc -l)
-echo "Average: $avg"
\ No newline at end of file
+./sum_taskloop
+
+# Scaling curves in one allocation instead of one job per thread count:
+#./count3s --sweep 1,2,4,8 1e8
+
+# Distributed SUMMA across nodes (raise --nodes, one rank per socket or node):
+#srun --ntasks=4 --cpus-per-task=$OMP_NUM_THREADS ./summa 8192 256
+
+# OpenMP construct overheads on this node type, under each binding setting:
+#./omp_overhead --affinity 1,2,4,8
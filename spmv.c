@@ -0,0 +1,699 @@
+/*
+ * Sparse matrix-vector (SpMV, y = A x) and matrix-multivector (SpMM,
+ * Y = A X with k right-hand sides) products in CSR and SELL-C-sigma,
+ * against the dense path at several densities
+ *
+ * Variants:
+ *   dense      the matrix stored densely, parallel row loop (as matmul.c)
+ *   csr rows   CSR, schedule(static) over rows: equal row counts per thread
+ *   csr nnz    CSR, contiguous row ranges with equal nonzero counts per thread
+ *   sell       SELL-C-sigma (SPMV_C rows per chunk, sorted by length within
+ *              windows of SPMV_SIGMA rows), chunks split by stored entries;
+ *              SpMV only
+ *
+ * Matrices come from a synthetic generator or a Matrix Market file:
+ *   banded     full band around the diagonal, half-width density * n / 2
+ *   powerlaw   row lengths proportional to 1 / (i + 1)^SPMV_ALPHA with mean
+ *              density * n, random columns; the heaviest rows come first,
+ *              as in degree-ordered graphs
+ * Reported: GFLOP/s (2 nnz per right-hand side; the dense path counts its
+ * 2 n^2 as well) and effective GB/s from the minimal traffic of each format
+ * (values, indices, row pointers, one pass over x and y).
+ *
+ * Compile: gcc -fopenmp -O3 -march=native spmv.c -o spmv -lm
+ * Run: ./spmv [n] [density_list] [banded|powerlaw] [k] [threads]
+ *        (default 4096 0.001,0.01,0.05,0.2 powerlaw 8)
+ *      ./spmv --mtx file.mtx [k] [threads]
+ */
+
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include "bench.h"
+
+#define DEFAULT_N 4096
+#define DEFAULT_DENSITIES "0.001,0.01,0.05,0.2"
+#define DEFAULT_K 8
+#define MAX_DENSITIES 16
+#define SPMV_C 8                 // Rows per SELL chunk (one 512-bit vector of doubles)
+#define SPMV_SIGMA 256           // Sorting window of SELL-C-sigma
+#define SPMV_ALPHA 0.8           // Power-law exponent of the row lengths
+#define DENSE_MAX_ENTRIES (1L << 26)   // Dense comparison up to 512 MB
+#define SPMV_SEED 42
+
+typedef struct {
+    long rows, cols;
+    long nnz;
+    long *row_ptr;      // rows + 1
+    int *col;
+    double *val;
+} csr_matrix;
+
+typedef struct {
+    long rows, chunks;
+    long stored;        // Entries including padding
+    long *chunk_ptr;    // chunks + 1 offsets into col/val
+    int *chunk_len;     // Width of each chunk
+    int *perm;          // Original row of each sorted slot
+    int *col;
+    double *val;        // Column-major within a chunk: val[ptr + j * SPMV_C + r]
+} sell_matrix;
+
+enum { VAR_DENSE, VAR_CSR_ROWS, VAR_CSR_NNZ, VAR_SELL, VARIANTS };
+static const char *variant_names[VARIANTS] = {"dense", "csr rows", "csr nnz", "sell"};
+
+static uint64_t splitmix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static void csr_alloc(csr_matrix *a, long rows, long cols, long nnz)
+{
+    a->rows = rows;
+    a->cols = cols;
+    a->nnz = nnz;
+    a->row_ptr = calloc(rows + 1, sizeof(long));
+    a->col = malloc((nnz > 0 ? nnz : 1) * sizeof(int));
+    a->val = malloc((nnz > 0 ? nnz : 1) * sizeof(double));
+    if (a->row_ptr == NULL || a->col == NULL || a->val == NULL) {
+        fprintf(stderr, "Memory allocation failed!\n");
+        exit(1);
+    }
+}
+
+static void csr_free(csr_matrix *a)
+{
+    free(a->row_ptr);
+    free(a->col);
+    free(a->val);
+}
+
+// Value of entry (i, j): bounded and different per entry, so errors show
+static double entry_value(long i, long j)
+{
+    return 1.0 + (double)((i * 7 + j * 13) % 17) / 17.0;
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+/* Synthetic matrices */
+
+static void generate_banded(csr_matrix *a, long n, double density)
+{
+    long half = (long)(density * n / 2.0);
+    long nnz = 0;
+    for (long i = 0; i < n; ++i)
+        nnz += (i + half < n - 1 ? i + half : n - 1) - (i - half > 0 ? i - half : 0) + 1;
+    csr_alloc(a, n, n, nnz);
+
+    long pos = 0;
+    for (long i = 0; i < n; ++i) {
+        a->row_ptr[i] = pos;
+        for (long j = i - half > 0 ? i - half : 0; j <= i + half && j < n; ++j) {
+            a->col[pos] = (int)j;
+            a->val[pos++] = entry_value(i, j);
+        }
+    }
+    a->row_ptr[n] = pos;
+}
+
+/*
+ * Row i gets about mean * w_i / mean(w) entries with w_i = (i + 1)^-alpha,
+ * at least one and at most n; duplicate random columns are merged, so the
+ * heaviest rows end up slightly below their target.
+ */
+static void generate_powerlaw(csr_matrix *a, long n, double density)
+{
+    double mean = density * n;
+    double wsum = 0.0;
+    for (long i = 0; i < n; ++i)
+        wsum += pow(i + 1.0, -SPMV_ALPHA);
+
+    long *len = malloc(n * sizeof(long));
+    long total = 0;
+    for (long i = 0; i < n; ++i) {
+        long l = (long)(mean * n * pow(i + 1.0, -SPMV_ALPHA) / wsum + 0.5);
+        len[i] = l < 1 ? 1 : (l > n ? n : l);
+        total += len[i];
+    }
+    csr_alloc(a, n, n, total);
+
+    long pos = 0;
+    for (long i = 0; i < n; ++i) {
+        a->row_ptr[i] = pos;
+        int *cols = a->col + pos;
+        if (len[i] * 2 > n) {
+            // Dense row: keep each column with probability len / n
+            long kept = 0;
+            for (long j = 0; j < n && kept < len[i]; ++j) {
+                uint64_t r = splitmix64(SPMV_SEED ^ ((uint64_t)i * n + j));
+                if ((r >> 11) * 0x1.0p-53 * n < len[i])
+                    cols[kept++] = (int)j;
+            }
+            len[i] = kept;
+        } else {
+            for (long e = 0; e < len[i]; ++e)
+                cols[e] = (int)(splitmix64(SPMV_SEED ^ ((uint64_t)i << 32 ^ e)) % n);
+            qsort(cols, len[i], sizeof(int), cmp_int);
+            long kept = 0;
+            for (long e = 0; e < len[i]; ++e)
+                if (kept == 0 || cols[e] != cols[kept - 1])
+                    cols[kept++] = cols[e];
+            len[i] = kept;
+        }
+        for (long e = 0; e < len[i]; ++e)
+            a->val[pos + e] = entry_value(i, cols[e]);
+        pos += len[i];
+    }
+    a->row_ptr[n] = pos;
+    a->nnz = pos;
+    free(len);
+}
+
+/*
+ * Matrix Market loader: coordinate format, real, integer or pattern
+ * (values 1), general, symmetric or skew-symmetric. Returns 0 on success.
+ */
+static int load_matrix_market(const char *path, csr_matrix *a)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+
+    char line[1024], object[64], format[64], field[64], symmetry[64];
+    if (fgets(line, sizeof(line), f) == NULL ||
+        sscanf(line, "%%%%MatrixMarket %63s %63s %63s %63s", object, format, field, symmetry) != 4) {
+        fprintf(stderr, "%s: missing %%%%MatrixMarket header\n", path);
+        fclose(f);
+        return -1;
+    }
+    for (char *p = line; *p; ++p)
+        *p = (char)tolower((unsigned char)*p);
+    sscanf(line, "%%%%matrixmarket %63s %63s %63s %63s", object, format, field, symmetry);
+    int pattern = strcmp(field, "pattern") == 0;
+    int symmetric = strcmp(symmetry, "symmetric") == 0;
+    int skew = strcmp(symmetry, "skew-symmetric") == 0;
+    if (strcmp(object, "matrix") != 0 || strcmp(format, "coordinate") != 0 ||
+        (!pattern && strcmp(field, "real") != 0 && strcmp(field, "integer") != 0) ||
+        (!symmetric && !skew && strcmp(symmetry, "general") != 0)) {
+        fprintf(stderr, "%s: only coordinate real/integer/pattern general/symmetric matrices are supported\n",
+                path);
+        fclose(f);
+        return -1;
+    }
+
+    long rows, cols, entries;
+    do {
+        if (fgets(line, sizeof(line), f) == NULL) {
+            fclose(f);
+            return -1;
+        }
+    } while (line[0] == '%');
+    if (sscanf(line, "%ld %ld %ld", &rows, &cols, &entries) != 3 || rows <= 0 || cols <= 0 || entries < 0) {
+        fprintf(stderr, "%s: bad size line\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    // Coordinates first, then a counting sort by row
+    long cap = (symmetric || skew) ? 2 * entries : entries;
+    long *ei = malloc((cap > 0 ? cap : 1) * sizeof(long));
+    int *ej = malloc((cap > 0 ? cap : 1) * sizeof(int));
+    double *ev = malloc((cap > 0 ? cap : 1) * sizeof(double));
+    long count = 0;
+    for (long e = 0; e < entries; ++e) {
+        long i, j;
+        double v = 1.0;
+        if (fscanf(f, "%ld %ld", &i, &j) != 2 || (!pattern && fscanf(f, "%lf", &v) != 1) ||
+            i < 1 || i > rows || j < 1 || j > cols) {
+            fprintf(stderr, "%s: bad entry %ld\n", path, e + 1);
+            free(ei);
+            free(ej);
+            free(ev);
+            fclose(f);
+            return -1;
+        }
+        ei[count] = i - 1;
+        ej[count] = (int)(j - 1);
+        ev[count++] = v;
+        if ((symmetric || skew) && i != j) {
+            ei[count] = j - 1;
+            ej[count] = (int)(i - 1);
+            ev[count++] = skew ? -v : v;
+        }
+    }
+    fclose(f);
+
+    csr_alloc(a, rows, cols, count);
+    for (long e = 0; e < count; ++e)
+        a->row_ptr[ei[e] + 1]++;
+    for (long i = 0; i < rows; ++i)
+        a->row_ptr[i + 1] += a->row_ptr[i];
+    long *next = malloc(rows * sizeof(long));
+    memcpy(next, a->row_ptr, rows * sizeof(long));
+    for (long e = 0; e < count; ++e) {
+        long p = next[ei[e]]++;
+        a->col[p] = ej[e];
+        a->val[p] = ev[e];
+    }
+
+    // Sort each row by column (insertion sort, rows are short)
+    for (long i = 0; i < rows; ++i) {
+        for (long p = a->row_ptr[i] + 1; p < a->row_ptr[i + 1]; ++p) {
+            int c = a->col[p];
+            double v = a->val[p];
+            long q = p;
+            while (q > a->row_ptr[i] && a->col[q - 1] > c) {
+                a->col[q] = a->col[q - 1];
+                a->val[q] = a->val[q - 1];
+                q--;
+            }
+            a->col[q] = c;
+            a->val[q] = v;
+        }
+    }
+    free(next);
+    free(ei);
+    free(ej);
+    free(ev);
+    return 0;
+}
+
+/* Partitioning */
+
+/*
+ * Split [0, n) into parts contiguous ranges of near-equal weight given the
+ * prefix sums ptr[0..n]: bounds[t] is the first index of part t, found by
+ * binary search for t * total / parts.
+ */
+static void balanced_bounds(const long *ptr, long n, int parts, long *bounds)
+{
+    long total = ptr[n];
+    bounds[0] = 0;
+    for (int t = 1; t < parts; ++t) {
+        long target = (long)((double)total * t / parts);
+        long lo = bounds[t - 1], hi = n;
+        while (lo < hi) {
+            long mid = (lo + hi) / 2;
+            if (ptr[mid] < target)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        bounds[t] = lo;
+    }
+    bounds[parts] = n;
+}
+
+/* SELL-C-sigma */
+
+static void sell_build(sell_matrix *s, const csr_matrix *a)
+{
+    long n = a->rows;
+    s->rows = n;
+    s->chunks = (n + SPMV_C - 1) / SPMV_C;
+    s->perm = malloc(s->chunks * SPMV_C * sizeof(int));
+    s->chunk_len = malloc(s->chunks * sizeof(int));
+    s->chunk_ptr = malloc((s->chunks + 1) * sizeof(long));
+
+    // Sort rows by decreasing length within each sigma window (stable)
+    for (long w0 = 0; w0 < n; w0 += SPMV_SIGMA) {
+        long w1 = w0 + SPMV_SIGMA < n ? w0 + SPMV_SIGMA : n;
+        for (long i = w0; i < w1; ++i) {
+            long len = a->row_ptr[i + 1] - a->row_ptr[i];
+            long q = i;
+            while (q > w0 && a->row_ptr[s->perm[q - 1] + 1] - a->row_ptr[s->perm[q - 1]] < len) {
+                s->perm[q] = s->perm[q - 1];
+                q--;
+            }
+            s->perm[q] = (int)i;
+        }
+    }
+    for (long i = n; i < s->chunks * SPMV_C; ++i)
+        s->perm[i] = -1;     // Padding rows of the last chunk
+
+    s->chunk_ptr[0] = 0;
+    for (long c = 0; c < s->chunks; ++c) {
+        long width = 0;
+        for (int r = 0; r < SPMV_C; ++r) {
+            int row = s->perm[c * SPMV_C + r];
+            long len = row < 0 ? 0 : a->row_ptr[row + 1] - a->row_ptr[row];
+            width = len > width ? len : width;
+        }
+        s->chunk_len[c] = (int)width;
+        s->chunk_ptr[c + 1] = s->chunk_ptr[c] + width * SPMV_C;
+    }
+    s->stored = s->chunk_ptr[s->chunks];
+    s->col = malloc((s->stored > 0 ? s->stored : 1) * sizeof(int));
+    s->val = malloc((s->stored > 0 ? s->stored : 1) * sizeof(double));
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (long c = 0; c < s->chunks; ++c) {
+        for (int r = 0; r < SPMV_C; ++r) {
+            int row = s->perm[c * SPMV_C + r];
+            long begin = row < 0 ? 0 : a->row_ptr[row], len = row < 0 ? 0 : a->row_ptr[row + 1] - begin;
+            for (long j = 0; j < s->chunk_len[c]; ++j) {
+                long slot = s->chunk_ptr[c] + j * SPMV_C + r;
+                // Padding points at column 0 with a zero value
+                s->col[slot] = j < len ? a->col[begin + j] : 0;
+                s->val[slot] = j < len ? a->val[begin + j] : 0.0;
+            }
+        }
+    }
+}
+
+static void sell_free(sell_matrix *s)
+{
+    free(s->perm);
+    free(s->chunk_len);
+    free(s->chunk_ptr);
+    free(s->col);
+    free(s->val);
+}
+
+/* Kernels */
+
+static void spmv_csr_range(const csr_matrix *a, const double *x, double *y, long r0, long r1)
+{
+    for (long i = r0; i < r1; ++i) {
+        double sum = 0.0;
+        for (long p = a->row_ptr[i]; p < a->row_ptr[i + 1]; ++p)
+            sum += a->val[p] * x[a->col[p]];
+        y[i] = sum;
+    }
+}
+
+static void spmm_csr_range(const csr_matrix *a, const double *x, double *y, int k, long r0, long r1)
+{
+    for (long i = r0; i < r1; ++i) {
+        double *yi = y + i * k;
+        for (int j = 0; j < k; ++j)
+            yi[j] = 0.0;
+        for (long p = a->row_ptr[i]; p < a->row_ptr[i + 1]; ++p) {
+            double v = a->val[p];
+            const double *xr = x + (long)a->col[p] * k;
+            for (int j = 0; j < k; ++j)
+                yi[j] += v * xr[j];
+        }
+    }
+}
+
+static void spmv_sell_range(const sell_matrix *s, const double *x, double *y, long c0, long c1)
+{
+    for (long c = c0; c < c1; ++c) {
+        double sum[SPMV_C] = {0.0};
+        const int *col = s->col + s->chunk_ptr[c];
+        const double *val = s->val + s->chunk_ptr[c];
+        for (long j = 0; j < s->chunk_len[c]; ++j)
+            for (int r = 0; r < SPMV_C; ++r)
+                sum[r] += val[j * SPMV_C + r] * x[col[j * SPMV_C + r]];
+        for (int r = 0; r < SPMV_C; ++r) {
+            int row = s->perm[c * SPMV_C + r];
+            if (row >= 0)
+                y[row] = sum[r];
+        }
+    }
+}
+
+typedef struct {
+    const csr_matrix *a;
+    const sell_matrix *s;
+    const double *dense;   // rows x cols, NULL when too large
+    const double *x;
+    double *y;
+    int k;                 // Right-hand sides: 1 for SpMV
+    int variant;
+    long *bounds;          // Row (csr nnz) or chunk (sell) ranges, parts + 1 entries
+    int parts;             // Ranges in bounds, one per thread
+} spmv_ctx;
+
+// One product of the selected variant; returns the sum of the result
+static double run_product(void *c)
+{
+    spmv_ctx *x = (spmv_ctx *)c;
+    const csr_matrix *a = x->a;
+    int k = x->k;
+
+    switch (x->variant) {
+    case VAR_DENSE:
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < a->rows; ++i) {
+            const double *ai = x->dense + i * a->cols;
+            double *yi = x->y + i * k;
+            if (k == 1) {
+                double sum = 0.0;
+#pragma omp simd reduction(+ : sum)
+                for (long p = 0; p < a->cols; ++p)
+                    sum += ai[p] * x->x[p];
+                yi[0] = sum;
+                continue;
+            }
+            for (int j = 0; j < k; ++j)
+                yi[j] = 0.0;
+            for (long p = 0; p < a->cols; ++p)
+                for (int j = 0; j < k; ++j)
+                    yi[j] += ai[p] * x->x[p * k + j];
+        }
+        break;
+    case VAR_CSR_ROWS:
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < a->rows; ++i) {
+            if (k == 1)
+                spmv_csr_range(a, x->x, x->y, i, i + 1);
+            else
+                spmm_csr_range(a, x->x, x->y, k, i, i + 1);
+        }
+        break;
+    // The team can be smaller than requested; every part is still covered
+    case VAR_CSR_NNZ:
+#pragma omp parallel num_threads(x->parts)
+        {
+            int nthr = omp_get_num_threads();
+            for (int t = omp_get_thread_num(); t < x->parts; t += nthr) {
+                if (k == 1)
+                    spmv_csr_range(a, x->x, x->y, x->bounds[t], x->bounds[t + 1]);
+                else
+                    spmm_csr_range(a, x->x, x->y, k, x->bounds[t], x->bounds[t + 1]);
+            }
+        }
+        break;
+    case VAR_SELL:
+#pragma omp parallel num_threads(x->parts)
+        {
+            int nthr = omp_get_num_threads();
+            for (int t = omp_get_thread_num(); t < x->parts; t += nthr)
+                spmv_sell_range(x->s, x->x, x->y, x->bounds[t], x->bounds[t + 1]);
+        }
+        break;
+    }
+
+    double sum = 0.0;
+    for (long i = 0; i < a->rows * k; ++i)
+        sum += x->y[i];
+    return sum;
+}
+
+// Minimal bytes one product moves in each format
+static double product_bytes(const csr_matrix *a, const sell_matrix *s, int variant, int k)
+{
+    double vectors = 8.0 * k * (a->cols + a->rows);
+    switch (variant) {
+    case VAR_DENSE:
+        return 8.0 * a->rows * a->cols + vectors;
+    case VAR_SELL:
+        return 12.0 * s->stored + 12.0 * s->chunks + 4.0 * s->chunks * SPMV_C + vectors;
+    default:
+        return 12.0 * a->nnz + 8.0 * (a->rows + 1) + vectors;
+    }
+}
+
+/*
+ * Time every variant for SpMV and SpMM on one matrix and print a row per
+ * variant; results are checked against the serial CSR product.
+ */
+static int benchmark_matrix(bench_config *cfg, const csr_matrix *a, const char *label, int k, int threads)
+{
+    long dense_entries = a->rows * a->cols;
+    double *dense = NULL;
+    int dense_failed = 0;
+    if (dense_entries <= DENSE_MAX_ENTRIES) {
+        dense = calloc(dense_entries, sizeof(double));
+        dense_failed = dense == NULL;
+    }
+    if (dense != NULL) {
+        for (long i = 0; i < a->rows; ++i)
+            for (long p = a->row_ptr[i]; p < a->row_ptr[i + 1]; ++p)
+                dense[i * a->cols + a->col[p]] += a->val[p];
+    }
+
+    sell_matrix s;
+    sell_build(&s, a);
+
+    long *row_bounds = malloc((threads + 1) * sizeof(long));
+    long *chunk_bounds = malloc((threads + 1) * sizeof(long));
+    balanced_bounds(a->row_ptr, a->rows, threads, row_bounds);
+    balanced_bounds(s.chunk_ptr, s.chunks, threads, chunk_bounds);
+
+    double *x = malloc(a->cols * k * sizeof(double));
+    double *y = malloc(a->rows * k * sizeof(double));
+    double *ref = malloc(a->rows * k * sizeof(double));
+    for (long i = 0; i < a->cols * k; ++i)
+        x[i] = 1.0 + (double)(i % 11) / 11.0;
+
+    int failures = 0;
+    printf("\n%s: %ld x %ld, nnz %ld (density %.4f, %.1f per row), SELL padding %.1f%%\n", label, a->rows,
+           a->cols, a->nnz, (double)a->nnz / ((double)a->rows * a->cols), (double)a->nnz / a->rows,
+           a->nnz > 0 ? 100.0 * (s.stored - a->nnz) / a->nnz : 0.0);
+    if (dense_failed)
+        printf("Dense path skipped, %.0f MB could not be allocated\n", 8.0 * dense_entries / 1e6);
+    printf("%-10s %4s %12s %10s %10s %12s %10s\n", "Variant", "k", "Time (s)", "GFLOP/s", "GB/s", "vs dense",
+           "Max err");
+    printf("--------------------------------------------------------------------------\n");
+
+    int widths[2] = {1, k};
+    for (int w = 0; w < 2; ++w) {
+        int kk = widths[w];
+        if (w == 1 && k == 1)
+            break;
+
+        // Serial CSR reference
+        if (kk == 1)
+            spmv_csr_range(a, x, ref, 0, a->rows);
+        else
+            spmm_csr_range(a, x, ref, kk, 0, a->rows);
+        double ref_sum = 0.0, ref_max = 0.0;
+        for (long i = 0; i < a->rows * kk; ++i) {
+            ref_sum += ref[i];
+            ref_max = fabs(ref[i]) > ref_max ? fabs(ref[i]) : ref_max;
+        }
+
+        double dense_time = NAN;
+        for (int v = 0; v < VARIANTS; ++v) {
+            if ((v == VAR_DENSE && dense == NULL) || (v == VAR_SELL && kk != 1))
+                continue;
+            spmv_ctx ctx = {a, &s, dense, x, y, kk, v, v == VAR_SELL ? chunk_bounds : row_bounds, threads};
+            char name[48];
+            snprintf(name, sizeof(name), "%s %s k=%d", label, variant_names[v], kk);
+            cfg->work_ops = 2.0 * kk * (v == VAR_DENSE ? (double)dense_entries : (double)a->nnz);
+            cfg->work_bytes = product_bytes(a, &s, v, kk);
+            bench_result r = bench_run(cfg, name, run_product, &ctx, ref_sum,
+                                       1e-12 * (fabs(ref_sum) + 1.0) * sqrt((double)a->rows * kk));
+
+            double err = 0.0;
+            for (long i = 0; i < a->rows * kk; ++i)
+                err = fabs(y[i] - ref[i]) > err ? fabs(y[i] - ref[i]) : err;
+            err /= ref_max > 1.0 ? ref_max : 1.0;
+            failures += err > 1e-12;
+            if (v == VAR_DENSE)
+                dense_time = r.median;
+
+            char speedup[16] = "-";
+            if (!isnan(dense_time))
+                snprintf(speedup, sizeof(speedup), "%.2fx", dense_time / r.median);
+            printf("%-10s %4d %12.6f %10.2f %10.2f %12s %10.2e\n", variant_names[v], kk, r.median,
+                   cfg->work_ops / r.median * 1e-9, cfg->work_bytes / r.median * 1e-9, speedup, err);
+        }
+    }
+    cfg->work_ops = cfg->work_bytes = 0.0;
+
+    free(x);
+    free(y);
+    free(ref);
+    free(row_bounds);
+    free(chunk_bounds);
+    free(dense);
+    sell_free(&s);
+    return failures;
+}
+
+static int parse_densities(const char *arg, double *values, int max)
+{
+    int n = 0;
+    const char *p = arg;
+    while (*p != '\0' && n < max) {
+        char *end;
+        values[n] = strtod(p, &end);
+        if (end == p || values[n] <= 0.0 || values[n] > 1.0 || (*end != ',' && *end != '\0'))
+            return 0;
+        n++;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    bench_config cfg;
+    int failures = 0;
+
+    if (argc > 1 && strcmp(argv[1], "--mtx") == 0) {
+        int k = argc > 3 ? atoi(argv[3]) : DEFAULT_K;
+        if (argc > 4)
+            omp_set_num_threads(atoi(argv[4]));
+        csr_matrix a;
+        if (argc < 3 || k < 1 || load_matrix_market(argv[2], &a) != 0) {
+            fprintf(stderr, "Usage: %s --mtx file.mtx [k] [threads]\n", argv[0]);
+            return 1;
+        }
+        int threads = omp_get_max_threads();
+        bench_init(&cfg, "spmv");
+        cfg.threads = threads;
+        cfg.size = a.nnz;
+        printf("Sparse products with %d threads\n", threads);
+        failures = benchmark_matrix(&cfg, &a, argv[2], k, threads);
+        csr_free(&a);
+        bench_finish(&cfg);
+        return failures != 0;
+    }
+
+    long n = argc > 1 ? atol(argv[1]) : DEFAULT_N;
+    double densities[MAX_DENSITIES];
+    int ndens = parse_densities(argc > 2 ? argv[2] : DEFAULT_DENSITIES, densities, MAX_DENSITIES);
+    const char *pattern = argc > 3 ? argv[3] : "powerlaw";
+    int k = argc > 4 ? atoi(argv[4]) : DEFAULT_K;
+    if (argc > 5)
+        omp_set_num_threads(atoi(argv[5]));
+    int banded = strcmp(pattern, "banded") == 0;
+    if (n <= 0 || n > 0x7fffffffL || ndens == 0 || k < 1 || (!banded && strcmp(pattern, "powerlaw") != 0)) {
+        fprintf(stderr, "Usage: %s [n] [density_list] [banded|powerlaw] [k] [threads] | %s --mtx file.mtx [k] "
+                "[threads]\n", argv[0], argv[0]);
+        return 1;
+    }
+    int threads = omp_get_max_threads();
+
+    bench_init(&cfg, "spmv");
+    cfg.threads = threads;
+    cfg.size = n;
+    printf("Sparse products, %s pattern, n=%ld, %d threads%s\n", pattern, n, threads,
+           n * n > DENSE_MAX_ENTRIES ? " (dense path skipped, matrix too large)" : "");
+
+    for (int d = 0; d < ndens; ++d) {
+        csr_matrix a;
+        if (banded)
+            generate_banded(&a, n, densities[d]);
+        else
+            generate_powerlaw(&a, n, densities[d]);
+        char label[48];
+        snprintf(label, sizeof(label), "%s %g", pattern, densities[d]);
+        failures += benchmark_matrix(&cfg, &a, label, k, threads);
+        csr_free(&a);
+    }
+
+    if (failures)
+        printf("\n%d variant(s) differ from the serial CSR product!\n", failures);
+    bench_finish(&cfg);
+    return failures != 0;
+}
@@ -0,0 +1,360 @@
+/*
+ * Parallel sum driver with selectable loop-scheduling strategies
+ *
+ * Sums a midpoint-rule pi integrand whose per-iteration cost can be made
+ * non-uniform: iteration i integrates its own step with cost(i) sub-points,
+ * so the result is pi for every cost profile while the work per iteration
+ * varies by up to the imbalance factor. Profiles:
+ *   0 uniform   every iteration costs 1
+ *   1 ramp      cost grows linearly from 1 to factor over the range
+ *   2 hotspots  SUM_HOT_FRACTION of SUM_REGIONS regions (chosen by seed) cost factor
+ *
+ * Strategies:
+ *   0 block     schedule(static), one contiguous block per thread (blockpi.c)
+ *   1 cyclic    schedule(static, grain), round-robin chunks (cyclicpi.c with grain 1)
+ *   2 dynamic   schedule(dynamic, grain)
+ *   3 guided    schedule(guided, grain), grain is the minimum chunk
+ *   4 taskloop  omp taskloop grainsize(grain) with a task reduction
+ *   5 queue     manual chunk queue: threads claim grain iterations with an atomic
+ *   6 all       every strategy, each with its tuned grain
+ *
+ * With grain 0 the autotuner times SUM_GRAINS candidate grain sizes per
+ * strategy on a calibration problem 1/SUM_CALIBRATION_DIVISOR the size with the
+ * same cost profile and keeps the fastest for the given thread count.
+ *
+ * Compile: make   (gcc -fopenmp -O2 sum_taskloop.c -o sum_taskloop -lm)
+ * Run: ./sum_taskloop [strategy] [threads] [seed] [grain] [factor] [profile]
+ *                     [size_1e7] [verify] [show_tuning]
+ *      defaults: 6 (all), OMP_NUM_THREADS, 42, 0 (autotune), 10, 2, 1, 1, 1
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <omp.h>
+#include "bench.h"
+
+#define SUM_STRATEGIES 6
+#define SUM_REGIONS 1024              // Hotspot granularity over the iteration range
+#define SUM_HOT_FRACTION 0.1
+#define SUM_CALIBRATION_DIVISOR 16
+#define SUM_CALIBRATION_REPS 3
+
+enum { SUM_BLOCK, SUM_CYCLIC, SUM_DYNAMIC, SUM_GUIDED, SUM_TASKLOOP, SUM_QUEUE, SUM_ALL };
+enum { PROFILE_UNIFORM, PROFILE_RAMP, PROFILE_HOTSPOTS };
+
+static const char *strategy_names[SUM_STRATEGIES] = {"block", "cyclic", "dynamic", "guided", "taskloop",
+                                                     "queue"};
+static const char *profile_names[3] = {"uniform", "ramp", "hotspots"};
+
+// Candidate grain sizes for the autotuner
+static const long sum_grains[] = {1, 4, 16, 64, 256, 1024, 4096, 16384};
+#define SUM_GRAINS ((int)(sizeof(sum_grains) / sizeof(sum_grains[0])))
+
+typedef struct {
+    long n;
+    double step;
+    int profile;
+    int factor;
+    unsigned long long seed;
+    unsigned char *hot;            // SUM_REGIONS flags for the hotspot profile
+} sum_problem;
+
+typedef struct {
+    sum_problem *problem;
+    int strategy;
+    long grain;
+} sum_ctx;
+
+static unsigned long long splitmix64(unsigned long long x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Set up a problem of n iterations. The cost profile depends only on the
+ * relative position i/n, so a smaller calibration problem has the same shape.
+ * Returns -1 if the region table cannot be allocated.
+ */
+int problem_init(sum_problem *p, long n, int profile, int factor, unsigned long long seed) {
+    p->n = n;
+    p->step = 1.0 / (double)n;
+    p->profile = profile;
+    p->factor = factor < 1 ? 1 : factor;
+    p->seed = seed;
+    p->hot = malloc(SUM_REGIONS);
+    if (p->hot == NULL) {
+        return -1;
+    }
+    for (int r = 0; r < SUM_REGIONS; r++) {
+        p->hot[r] = (splitmix64(seed * SUM_REGIONS + r) >> 11) * 0x1.0p-53 < SUM_HOT_FRACTION;
+    }
+    return 0;
+}
+
+static inline int iteration_cost(const sum_problem *p, long i) {
+    switch (p->profile) {
+    case PROFILE_RAMP:
+        return 1 + (int)((p->factor - 1) * (double)i / p->n);
+    case PROFILE_HOTSPOTS:
+        return p->hot[i * SUM_REGIONS / p->n] ? p->factor : 1;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * Iteration i: midpoint rule over [i*step, (i+1)*step] with cost(i)
+ * sub-points, scaled to the contribution of one full-weight step
+ */
+static inline double integrand(const sum_problem *p, long i) {
+    int cost = iteration_cost(p, i);
+    double h = p->step / cost;
+    double x = i * p->step + 0.5 * h;
+    double sum = 0.0;
+    for (int k = 0; k < cost; k++) {
+        sum += 4.0 / (1.0 + x * x);
+        x += h;
+    }
+    return sum / cost;
+}
+
+static double sum_range(const sum_problem *p, long first, long last) {
+    double sum = 0.0;
+    for (long i = first; i < last; i++) {
+        sum += integrand(p, i);
+    }
+    return sum;
+}
+
+double sum_serial(const sum_problem *p) {
+    return sum_range(p, 0, p->n) * p->step;
+}
+
+/**
+ * Strategy 0: static block
+ */
+double sum_block(const sum_problem *p) {
+    double sum = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+:sum)
+    for (long i = 0; i < p->n; i++) {
+        sum += integrand(p, i);
+    }
+    return sum * p->step;
+}
+
+/**
+ * Strategy 1: static cyclic with chunk grain
+ */
+double sum_cyclic(const sum_problem *p, long grain) {
+    double sum = 0.0;
+    #pragma omp parallel for schedule(static, grain) reduction(+:sum)
+    for (long i = 0; i < p->n; i++) {
+        sum += integrand(p, i);
+    }
+    return sum * p->step;
+}
+
+/**
+ * Strategy 2: dynamic with chunk grain
+ */
+double sum_dynamic(const sum_problem *p, long grain) {
+    double sum = 0.0;
+    #pragma omp parallel for schedule(dynamic, grain) reduction(+:sum)
+    for (long i = 0; i < p->n; i++) {
+        sum += integrand(p, i);
+    }
+    return sum * p->step;
+}
+
+/**
+ * Strategy 3: guided with minimum chunk grain
+ */
+double sum_guided(const sum_problem *p, long grain) {
+    double sum = 0.0;
+    #pragma omp parallel for schedule(guided, grain) reduction(+:sum)
+    for (long i = 0; i < p->n; i++) {
+        sum += integrand(p, i);
+    }
+    return sum * p->step;
+}
+
+/**
+ * Strategy 4: taskloop created by one thread, grain iterations per task
+ */
+double sum_taskloop(const sum_problem *p, long grain) {
+    double sum = 0.0;
+    #pragma omp parallel
+    #pragma omp single
+    #pragma omp taskloop grainsize(grain) reduction(+:sum)
+    for (long i = 0; i < p->n; i++) {
+        sum += integrand(p, i);
+    }
+    return sum * p->step;
+}
+
+/**
+ * Strategy 5: manual queue, each thread claims the next grain iterations
+ * from a shared counter until the range is exhausted
+ */
+double sum_queue(const sum_problem *p, long grain) {
+    double sum = 0.0;
+    long next = 0;
+    #pragma omp parallel reduction(+:sum)
+    {
+        for (;;) {
+            long first;
+            #pragma omp atomic capture
+            { first = next; next += grain; }
+            if (first >= p->n) {
+                break;
+            }
+            long last = first + grain < p->n ? first + grain : p->n;
+            sum += sum_range(p, first, last);
+        }
+    }
+    return sum * p->step;
+}
+
+static double run_strategy(void *c) {
+    sum_ctx *x = (sum_ctx *)c;
+    switch (x->strategy) {
+    case SUM_BLOCK:
+        return sum_block(x->problem);
+    case SUM_CYCLIC:
+        return sum_cyclic(x->problem, x->grain);
+    case SUM_DYNAMIC:
+        return sum_dynamic(x->problem, x->grain);
+    case SUM_GUIDED:
+        return sum_guided(x->problem, x->grain);
+    case SUM_TASKLOOP:
+        return sum_taskloop(x->problem, x->grain);
+    default:
+        return sum_queue(x->problem, x->grain);
+    }
+}
+
+/**
+ * Autotune the grain of one strategy on the calibration problem: the
+ * median of SUM_CALIBRATION_REPS runs per candidate, fastest wins.
+ * Block has no grain. Candidates that leave fewer chunks than threads
+ * are skipped.
+ */
+long autotune_grain(sum_problem *calib, int strategy, int threads, int show) {
+    if (strategy == SUM_BLOCK) {
+        return 0;
+    }
+    bench_config quiet;
+    memset(&quiet, 0, sizeof(quiet));
+    quiet.warmup = 1;
+    quiet.reps = SUM_CALIBRATION_REPS;
+
+    long best_grain = sum_grains[0];
+    double best_time = INFINITY;
+    for (int g = 0; g < SUM_GRAINS; g++) {
+        if (g > 0 && sum_grains[g] * threads > calib->n) {
+            break;
+        }
+        sum_ctx ctx = {calib, strategy, sum_grains[g]};
+        double time = bench_median(&quiet, run_strategy, &ctx);
+        if (show) {
+            printf("   tune %-8s grain %6ld: %.6f s\n", strategy_names[strategy], sum_grains[g], time);
+        }
+        if (time < best_time) {
+            best_time = time;
+            best_grain = sum_grains[g];
+        }
+    }
+    return best_grain;
+}
+
+int main(int argc, char **argv) {
+    int strategy = argc > 1 ? atoi(argv[1]) : SUM_ALL;
+    int threads = argc > 2 ? atoi(argv[2]) : omp_get_max_threads();
+    unsigned long long seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 42;
+    long grain = argc > 4 ? atol(argv[4]) : 0;
+    int factor = argc > 5 ? atoi(argv[5]) : 10;
+    int profile = argc > 6 ? atoi(argv[6]) : PROFILE_HOTSPOTS;
+    long n = (long)((argc > 7 ? atof(argv[7]) : 1.0) * 1e7);
+    int verify = argc > 8 ? atoi(argv[8]) : 1;
+    int show_tuning = argc > 9 ? atoi(argv[9]) : 1;
+
+    if (strategy < 0 || strategy > SUM_ALL || threads < 1 || grain < 0 || factor < 1 ||
+        profile < 0 || profile > PROFILE_HOTSPOTS || n < 1) {
+        printf("Usage: %s [strategy 0-6] [threads] [seed] [grain, 0 = autotune] [factor] "
+               "[profile 0-2] [size_1e7] [verify] [show_tuning]\n", argv[0]);
+        return 1;
+    }
+    omp_set_num_threads(threads);
+
+    sum_problem problem, calib;
+    calib.hot = NULL;
+    if (problem_init(&problem, n, profile, factor, seed) != 0 ||
+        problem_init(&calib, n / SUM_CALIBRATION_DIVISOR > threads ? n / SUM_CALIBRATION_DIVISOR : n,
+                     profile, factor, seed) != 0) {
+        fprintf(stderr, "Error: Failed to allocate the region table\n");
+        free(problem.hot);
+        free(calib.hot);
+        return 1;
+    }
+
+    // Before any output: in csv/json mode the records own stdout
+    bench_config cfg;
+    bench_init(&cfg, "sum_taskloop");
+    cfg.threads = threads;
+    cfg.size = n;
+
+    printf("Parallel sum: %ld iterations, %d threads, profile %s, imbalance factor %d, seed %llu\n",
+           n, threads, profile_names[profile], problem.factor, seed);
+
+    double reference = NAN;
+    if (verify) {
+        double start = omp_get_wtime();
+        reference = sum_serial(&problem);
+        printf("Serial reference: %.12f in %.6f s (error vs pi %.2e)\n", reference, omp_get_wtime() - start,
+               fabs(reference - M_PI));
+    }
+
+    int first = strategy == SUM_ALL ? 0 : strategy;
+    int last = strategy == SUM_ALL ? SUM_STRATEGIES - 1 : strategy;
+    long grains[SUM_STRATEGIES];
+    double times[SUM_STRATEGIES];
+    int correct[SUM_STRATEGIES];
+
+    for (int s = first; s <= last; s++) {
+        grains[s] = grain > 0 || s == SUM_BLOCK ? grain : autotune_grain(&calib, s, threads, show_tuning);
+        if (s == SUM_BLOCK) {
+            grains[s] = 0;
+        }
+        sum_ctx ctx = {&problem, s, grains[s]};
+        // Summation order differs between strategies
+        bench_result r = bench_run(&cfg, strategy_names[s], run_strategy, &ctx, reference, 1e-9);
+        times[s] = r.median;
+        correct[s] = !r.checked || r.correct;
+    }
+
+    printf("\n%-10s %8s %12s %12s %8s\n", "Strategy", "Grain", "Time (s)", "vs block", "Check");
+    printf("--------------------------------------------------------\n");
+    for (int s = first; s <= last; s++) {
+        char vs_block[16] = "-";
+        if (first == SUM_BLOCK) {
+            snprintf(vs_block, sizeof(vs_block), "%.2fx", times[SUM_BLOCK] / times[s]);
+        }
+        char grain_text[16] = "-";
+        if (s != SUM_BLOCK) {
+            snprintf(grain_text, sizeof(grain_text), "%ld", grains[s]);
+        }
+        printf("%-10s %8s %12.6f %12s %8s\n", strategy_names[s], grain_text, times[s], vs_block,
+               verify ? (correct[s] ? "ok" : "WRONG") : "-");
+    }
+    if (grain == 0 && strategy != SUM_BLOCK) {
+        printf("Grains tuned on %ld iterations (1/%d of the problem)\n", calib.n, SUM_CALIBRATION_DIVISOR);
+    }
+
+    free(problem.hot);
+    free(calib.hot);
+    bench_finish(&cfg);
+    return cfg.failures != 0;
+}
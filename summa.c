@@ -0,0 +1,410 @@
+/*
+ * Distributed matrix multiplication C = A * B with SUMMA (MPI + OpenMP)
+ *
+ * The P ranks form a Pr x Pc grid (MPI_Dims_create). A, B and C are N x N,
+ * row-major and block-distributed: rank (r, c) owns rows r of Pr and
+ * columns c of Pc of each matrix. The k dimension is cut into panels that
+ * never straddle a block boundary; for every panel the rank column owning
+ * those columns of A broadcasts them along its grid row, the rank row
+ * owning those rows of B broadcasts them along its grid column, and every
+ * rank adds the panel product to its block of C with OpenMP threads.
+ *
+ * Two variants are timed:
+ *   blocking  MPI_Bcast of a panel, then its local GEMM
+ *   overlap   MPI_Ibcast of panel t + 1 is in flight while panel t is
+ *             multiplied (double-buffered); the local GEMM runs in row
+ *             chunks with MPI_Testall in between to drive progress
+ * Each rank times its local GEMM (compute) and the time it waits for
+ * panels (communication); rank 0 prints both per rank for each variant.
+ *
+ * Every rank checks its block of C against the serial triple loop on the
+ * same operands (all entries up to SUMMA_VERIFY_FULL, sampled above).
+ *
+ * Compile: mpicc -fopenmp -O3 -march=native summa.c -o summa -lm
+ * Run: mpirun -np 4 ./summa [N] [panel] [threads]   (default 2048 128 OMP)
+ * Only rank 0 reports; each repetition is bracketed by barriers, so it
+ * measures the slowest rank.
+ */
+
+#include <mpi.h>
+#include <omp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "bench.h"
+
+#define DEFAULT_N 2048
+#define DEFAULT_PANEL 128
+#define SUMMA_PROGRESS_CHUNKS 8     // MPI_Testall calls per local panel GEMM
+#define SUMMA_VERIFY_FULL 1024      // Check every entry of C up to this N
+#define NUM_SAMPLES 1000            // Entries checked per rank above it
+
+typedef struct {
+    long k0, width;
+    int a_owner;    // Grid column holding these columns of A
+    int b_owner;    // Grid row holding these rows of B
+} panel;
+
+typedef struct {
+    int rank, nranks, row, col, prows, pcols;
+    MPI_Comm row_comm, col_comm;     // Ranks in my grid row / grid column
+    long n;
+    long m0, mloc;                   // My rows of A and C
+    long n0, nloc;                   // My columns of B and C
+    long ka0, kaloc;                 // My columns of A
+    long kb0, kbloc;                 // My rows of B
+    double *a, *b, *c;               // Local blocks
+    panel *panels;
+    int npanels;
+    long max_width;
+    double *abuf[2], *bbuf[2];       // Received panels, double-buffered
+    int overlap;                     // Variant under test
+    double compute_time, comm_time;  // Accumulated by summa()
+} summa_ctx;
+
+// First index of block i when n is split into p near-equal blocks
+static long block_start(int i, int p, long n)
+{
+    return (long)((long long)i * n / p);
+}
+
+// Same operands as matmul.c, from global indices
+static double a_value(long i, long p)
+{
+    return 3.0 * i + p;
+}
+
+static double b_value(long p, long j)
+{
+    return 5.2 * p + 2.3 * j;
+}
+
+/*
+ * Panels of at most width columns, cut at every block boundary of the k
+ * dimension of A (split over Pc) and of B (split over Pr)
+ */
+static int make_panels(summa_ctx *s, long width)
+{
+    int cap = 16, count = 0;
+    s->panels = malloc(cap * sizeof(panel));
+    s->max_width = 0;
+    int ac = 0, br = 0;
+    long k = 0;
+
+    while (k < s->n) {
+        while (block_start(ac + 1, s->pcols, s->n) <= k)
+            ac++;
+        while (block_start(br + 1, s->prows, s->n) <= k)
+            br++;
+        long end = block_start(ac + 1, s->pcols, s->n);
+        long b_end = block_start(br + 1, s->prows, s->n);
+        end = b_end < end ? b_end : end;
+        end = k + width < end ? k + width : end;
+
+        if (count == cap) {
+            cap *= 2;
+            s->panels = realloc(s->panels, cap * sizeof(panel));
+        }
+        s->panels[count].k0 = k;
+        s->panels[count].width = end - k;
+        s->panels[count].a_owner = ac;
+        s->panels[count].b_owner = br;
+        s->max_width = end - k > s->max_width ? end - k : s->max_width;
+        count++;
+        k = end;
+    }
+    s->npanels = count;
+    return count;
+}
+
+// Copy columns [k0, k0 + w) of the local A block into a contiguous mloc x w panel
+static void pack_a_panel(const summa_ctx *s, long k0, long w, double *dst)
+{
+    const double *src = s->a + (k0 - s->ka0);
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < s->mloc; ++i)
+        memcpy(dst + i * w, src + i * s->kaloc, w * sizeof(double));
+}
+
+// C[rows i0..i1) += Ap (mloc x w) * Bp (w x nloc)
+static void panel_gemm(summa_ctx *s, const double *ap, const double *bp, long w, long i0, long i1)
+{
+    long nloc = s->nloc;
+#pragma omp parallel for schedule(static)
+    for (long i = i0; i < i1; ++i) {
+        double *ci = s->c + i * nloc;
+        for (long p = 0; p < w; ++p) {
+            double aip = ap[i * w + p];
+            const double *bpj = bp + p * nloc;
+            for (long j = 0; j < nloc; ++j)
+                ci[j] += aip * bpj[j];
+        }
+    }
+}
+
+// Start (or, blocking, complete) the broadcasts of panel t into buffer slot
+static void post_panel(summa_ctx *s, int t, int slot, MPI_Request req[2])
+{
+    panel *pn = &s->panels[t];
+    double *ap = s->abuf[slot];
+    double *bp = s->bbuf[slot];
+    if (s->col == pn->a_owner)
+        pack_a_panel(s, pn->k0, pn->width, ap);
+    // The owner of the B rows sends them in place, they are contiguous
+    if (s->row == pn->b_owner)
+        bp = s->b + (pn->k0 - s->kb0) * s->nloc;
+
+    int acount = (int)(s->mloc * pn->width), bcount = (int)(pn->width * s->nloc);
+    if (s->overlap) {
+        MPI_Ibcast(ap, acount, MPI_DOUBLE, pn->a_owner, s->row_comm, &req[0]);
+        MPI_Ibcast(bp, bcount, MPI_DOUBLE, pn->b_owner, s->col_comm, &req[1]);
+    } else {
+        MPI_Bcast(ap, acount, MPI_DOUBLE, pn->a_owner, s->row_comm);
+        MPI_Bcast(bp, bcount, MPI_DOUBLE, pn->b_owner, s->col_comm);
+    }
+}
+
+static const double *b_panel(summa_ctx *s, int t, int slot)
+{
+    panel *pn = &s->panels[t];
+    return s->row == pn->b_owner ? s->b + (pn->k0 - s->kb0) * s->nloc : s->bbuf[slot];
+}
+
+/* One distributed multiply; adds the time of its phases to compute_time and comm_time */
+static void summa(summa_ctx *s)
+{
+    memset(s->c, 0, s->mloc * s->nloc * sizeof(double));
+    MPI_Request req[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    MPI_Request next[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    double start;
+
+    if (s->overlap) {
+        start = MPI_Wtime();
+        post_panel(s, 0, 0, req);
+        s->comm_time += MPI_Wtime() - start;
+    }
+
+    for (int t = 0; t < s->npanels; ++t) {
+        int slot = t % 2;
+        long w = s->panels[t].width;
+
+        start = MPI_Wtime();
+        if (s->overlap) {
+            MPI_Waitall(2, req, MPI_STATUSES_IGNORE);
+            if (t + 1 < s->npanels)
+                post_panel(s, t + 1, 1 - slot, next);
+        } else {
+            post_panel(s, t, slot, req);
+        }
+        s->comm_time += MPI_Wtime() - start;
+
+        const double *ap = s->abuf[slot], *bp = b_panel(s, t, slot);
+        long chunk = (s->mloc + SUMMA_PROGRESS_CHUNKS - 1) / SUMMA_PROGRESS_CHUNKS;
+        for (long i0 = 0; i0 < s->mloc; i0 += chunk) {
+            start = MPI_Wtime();
+            panel_gemm(s, ap, bp, w, i0, i0 + chunk < s->mloc ? i0 + chunk : s->mloc);
+            s->compute_time += MPI_Wtime() - start;
+            if (s->overlap && t + 1 < s->npanels) {
+                int done;
+                start = MPI_Wtime();
+                MPI_Testall(2, next, &done, MPI_STATUSES_IGNORE);
+                s->comm_time += MPI_Wtime() - start;
+            }
+        }
+        req[0] = next[0];
+        req[1] = next[1];
+        next[0] = next[1] = MPI_REQUEST_NULL;
+    }
+}
+
+// Barrier-bracketed run for the harness; returns the global sum of C
+static double bench_summa(void *ctx)
+{
+    summa_ctx *s = (summa_ctx *)ctx;
+    MPI_Barrier(MPI_COMM_WORLD);
+    summa(s);
+    double local = 0.0, total = 0.0;
+    for (long i = 0; i < s->mloc * s->nloc; ++i)
+        local += s->c[i];
+    MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return total;
+}
+
+/* Max relative error of my block of C against the serial dot products, over all ranks */
+static double verify(const summa_ctx *s)
+{
+    double err = 0.0;
+    long entries = s->mloc * s->nloc;
+    int full = s->n <= SUMMA_VERIFY_FULL;
+    long checks = full ? entries : (entries < NUM_SAMPLES ? entries : NUM_SAMPLES);
+    srand(42 + s->rank);
+
+    for (long e = 0; e < checks; ++e) {
+        long idx = full ? e : rand() % entries;
+        long i = idx / s->nloc, j = idx % s->nloc;
+        double ref = 0.0;
+        for (long p = 0; p < s->n; ++p)
+            ref += a_value(s->m0 + i, p) * b_value(p, s->n0 + j);
+        double scale = fabs(ref) > 1.0 ? fabs(ref) : 1.0;
+        double e_rel = fabs(s->c[idx] - ref) / scale;
+        err = e_rel > err ? e_rel : err;
+    }
+
+    double global = 0.0;
+    MPI_Allreduce(&err, &global, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return global;
+}
+
+/* One instrumented run; rank 0 prints compute and communication time per rank */
+static void report_ranks(summa_ctx *s, const char *name)
+{
+    s->compute_time = s->comm_time = 0.0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start = MPI_Wtime();
+    summa(s);
+    double mine[3] = {s->compute_time, s->comm_time, MPI_Wtime() - start};
+
+    double *all = s->rank == 0 ? malloc(3 * s->nranks * sizeof(double)) : NULL;
+    MPI_Gather(mine, 3, MPI_DOUBLE, all, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    if (s->rank == 0) {
+        printf("\n%s: time per rank of one run\n", name);
+        printf("%6s %8s %12s %12s %12s %8s\n", "Rank", "Grid", "Compute (s)", "Comm (s)", "Total (s)", "Comm %");
+        printf("-------------------------------------------------------------\n");
+        for (int r = 0; r < s->nranks; ++r) {
+            char grid[32];
+            snprintf(grid, sizeof(grid), "(%d,%d)", r / s->pcols, r % s->pcols);
+            double *v = all + 3 * r;
+            printf("%6d %8s %12.6f %12.6f %12.6f %7.1f%%\n", r, grid, v[0], v[1], v[2],
+                   v[2] > 0.0 ? 100.0 * v[1] / v[2] : 0.0);
+        }
+        free(all);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    summa_ctx s;
+    memset(&s, 0, sizeof(s));
+    MPI_Comm_rank(MPI_COMM_WORLD, &s.rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &s.nranks);
+
+    s.n = argc > 1 ? atol(argv[1]) : DEFAULT_N;
+    long width = argc > 2 ? atol(argv[2]) : DEFAULT_PANEL;
+    if (argc > 3)
+        omp_set_num_threads(atoi(argv[3]));
+    int dims[2] = {0, 0};
+    MPI_Dims_create(s.nranks, 2, dims);
+    s.prows = dims[0];
+    s.pcols = dims[1];
+    if (s.n < s.prows || s.n < s.pcols || width <= 0 || s.n * s.n / s.nranks > 0x7fffffffL) {
+        if (s.rank == 0)
+            fprintf(stderr, "Usage: mpirun -np P %s [N >= grid side] [panel] [threads]\n", argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Grid communicators: the rank order of MPI_COMM_WORLD is row-major on the grid
+    int periods[2] = {0, 0}, coords[2];
+    MPI_Comm grid;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid);
+    MPI_Cart_coords(grid, s.rank, 2, coords);
+    s.row = coords[0];
+    s.col = coords[1];
+    int keep_cols[2] = {0, 1}, keep_rows[2] = {1, 0};
+    MPI_Cart_sub(grid, keep_cols, &s.row_comm);
+    MPI_Cart_sub(grid, keep_rows, &s.col_comm);
+
+    s.m0 = block_start(s.row, s.prows, s.n);
+    s.mloc = block_start(s.row + 1, s.prows, s.n) - s.m0;
+    s.n0 = block_start(s.col, s.pcols, s.n);
+    s.nloc = block_start(s.col + 1, s.pcols, s.n) - s.n0;
+    s.ka0 = s.n0;
+    s.kaloc = s.nloc;
+    s.kb0 = s.m0;
+    s.kbloc = s.mloc;
+    make_panels(&s, width);
+
+    s.a = malloc(s.mloc * s.kaloc * sizeof(double));
+    s.b = malloc(s.kbloc * s.nloc * sizeof(double));
+    s.c = malloc(s.mloc * s.nloc * sizeof(double));
+    for (int i = 0; i < 2; ++i) {
+        s.abuf[i] = malloc(s.mloc * s.max_width * sizeof(double));
+        s.bbuf[i] = malloc(s.max_width * s.nloc * sizeof(double));
+    }
+    if (s.a == NULL || s.b == NULL || s.c == NULL || s.abuf[0] == NULL || s.abuf[1] == NULL ||
+        s.bbuf[0] == NULL || s.bbuf[1] == NULL) {
+        fprintf(stderr, "Rank %d: memory allocation failed!\n", s.rank);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+#pragma omp parallel for schedule(static)
+    for (long i = 0; i < s.mloc; ++i)
+        for (long p = 0; p < s.kaloc; ++p)
+            s.a[i * s.kaloc + p] = a_value(s.m0 + i, s.ka0 + p);
+#pragma omp parallel for schedule(static)
+    for (long p = 0; p < s.kbloc; ++p)
+        for (long j = 0; j < s.nloc; ++j)
+            s.b[p * s.nloc + j] = b_value(s.kb0 + p, s.n0 + j);
+
+    // Records and text output from rank 0 only
+    bench_config cfg;
+    bench_init(&cfg, "summa");
+    if (s.rank != 0) {
+        if (cfg.out != stdout)
+            fclose(cfg.out);
+        cfg.out = fopen("/dev/null", "w");
+    }
+    cfg.threads = s.nranks * omp_get_max_threads();
+    cfg.size = s.n;
+    double flop = 2.0 * s.n * s.n * s.n;
+
+    if (s.rank == 0)
+        printf("SUMMA N=%ld on a %d x %d grid, %d threads per rank, %d panels of <= %ld columns\n",
+               s.n, s.prows, s.pcols, omp_get_max_threads(), s.npanels, width);
+
+    s.overlap = 0;
+    bench_result blocking = bench_run(&cfg, "blocking", bench_summa, &s, NAN, 0.0);
+    double err_blocking = verify(&s);
+    s.overlap = 1;
+    // Same panels, same order: the overlapped result must match to rounding
+    bench_result overlap = bench_run(&cfg, "overlap", bench_summa, &s, blocking.value,
+                                     fabs(blocking.value) * 1e-12);
+    double err_overlap = verify(&s);
+
+    double tol = 2.0 * s.n * DBL_EPSILON;
+    if (s.rank == 0) {
+        printf("%-10s %12s %10s %14s\n", "Variant", "Time (s)", "GFLOP/s", "Max rel err");
+        printf("-----------------------------------------------\n");
+        printf("%-10s %12.6f %10.2f %14.3e\n", "blocking", blocking.median, flop / blocking.median * 1e-9,
+               err_blocking);
+        printf("%-10s %12.6f %10.2f %14.3e\n", "overlap", overlap.median, flop / overlap.median * 1e-9,
+               err_overlap);
+        printf("Overlap speedup: %.2fx; %s against the serial result (%s)\n",
+               blocking.median / overlap.median, s.n <= SUMMA_VERIFY_FULL ? "all entries" : "sampled",
+               err_blocking <= tol && err_overlap <= tol ? "Correct" : "INCORRECT!");
+    }
+
+    s.overlap = 0;
+    report_ranks(&s, "blocking");
+    s.overlap = 1;
+    report_ranks(&s, "overlap");
+
+    for (int i = 0; i < 2; ++i) {
+        free(s.abuf[i]);
+        free(s.bbuf[i]);
+    }
+    free(s.a);
+    free(s.b);
+    free(s.c);
+    free(s.panels);
+    bench_finish(&cfg);
+    MPI_Comm_free(&s.row_comm);
+    MPI_Comm_free(&s.col_comm);
+    MPI_Comm_free(&grid);
+    MPI_Finalize();
+    return err_blocking <= tol && err_overlap <= tol && cfg.failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,351 @@
+/*
+ * worksteal.h - Small work-stealing task runtime on pthreads
+ *
+ * Every worker owns a Chase-Lev deque (Le et al., "Correct and efficient
+ * work-stealing for weak memory models", PPoPP 2013): the owner pushes and
+ * pops at the bottom without locks, thieves take from the top with one
+ * CAS. Idle workers steal from uniformly random victims.
+ *
+ * Fork-join API, called from inside a task (the root included):
+ *   ws_task *t = ws_alloc(w);  t->fn = f;  t->data[0] = ...;
+ *   ws_spawn(w, t);            // t may now run on any worker
+ *   ...                        // continue with the rest of the work
+ *   ws_sync(w, t);             // pops t and runs it inline if nobody stole
+ *                              // it, else steals other work until t is done
+ *   ... t->data[...] ...; ws_release(w, t);
+ * Syncs must happen in reverse spawn order (strict fork-join nesting).
+ *
+ * Task frames come from a per-worker free list refilled in slabs, so the
+ * spawn path does not call malloc once warm. A frame is always returned by
+ * the worker that allocated it, after its sync.
+ *
+ * ws_runtime_init() starts nthreads - 1 workers; ws_runtime_run() executes
+ * a root task on the calling thread (worker 0) while the others steal, and
+ * returns when the root returns and the workers have stopped stealing.
+ * Between runs the workers sleep on a condition variable. Per-worker
+ * counters record spawns, inline pops, steals and failed steal attempts.
+ *
+ * Header-only; compile with -pthread.
+ */
+
+#ifndef WORKSTEAL_H
+#define WORKSTEAL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#define WS_DEQUE_CAPACITY 4096    // Power of two; a full deque runs the spawn inline
+#define WS_SLAB 256               // Frames allocated at once when a free list runs dry
+#define WS_STEAL_SPINS 64         // Failed steals before an idle worker yields
+#define WS_CACHE_LINE 64
+
+struct ws_worker;
+
+typedef struct ws_task {
+    void (*fn)(struct ws_worker *w, struct ws_task *t);
+    atomic_int done;
+    struct ws_task *next_free;
+    long long data[4];            // Arguments and results, owned by the spawner
+} ws_task;
+
+typedef struct {
+    _Alignas(WS_CACHE_LINE) atomic_llong top;     // Thieves
+    _Alignas(WS_CACHE_LINE) atomic_llong bottom;  // Owner
+    _Atomic(ws_task *) buffer[WS_DEQUE_CAPACITY];
+} ws_deque;
+
+typedef struct {
+    long long spawns;
+    long long inline_pops;        // Spawned tasks the owner ran itself at sync
+    long long steals;
+    long long failed_steals;
+} ws_stats;
+
+struct ws_runtime;
+
+typedef struct ws_worker {
+    ws_deque deque;
+    struct ws_runtime *rt;
+    int id;
+    uint64_t rng;
+    ws_task *free_list;
+    void **slabs;                 // Owned slabs, freed at shutdown
+    int nslabs, slab_cap;
+    _Alignas(WS_CACHE_LINE) ws_stats stats;
+} ws_worker;
+
+typedef struct ws_runtime {
+    int nthreads;
+    ws_worker *workers;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int generation;
+    int shutdown;
+    atomic_int active;            // A root task is running
+    atomic_int stealing;          // Workers not yet back to waiting since the last run
+} ws_runtime;
+
+#define WS_EMPTY ((ws_task *)0)
+#define WS_ABORT ((ws_task *)1)
+
+/* Chase-Lev deque */
+
+static inline void ws_push(ws_deque *q, ws_task *t) {
+    long long b = atomic_load_explicit(&q->bottom, memory_order_relaxed);
+    // Release on the slot as well publishes the task's fields to the thief that reads it
+    atomic_store_explicit(&q->buffer[b & (WS_DEQUE_CAPACITY - 1)], t, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+}
+
+static inline ws_task *ws_take(ws_deque *q) {
+    long long b = atomic_load_explicit(&q->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&q->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long t = atomic_load_explicit(&q->top, memory_order_relaxed);
+    ws_task *x = WS_EMPTY;
+
+    if (t <= b) {
+        x = atomic_load_explicit(&q->buffer[b & (WS_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+        if (t == b) {
+            // Last element: race the thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst,
+                                                         memory_order_relaxed)) {
+                x = WS_EMPTY;
+            }
+            atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&q->bottom, b + 1, memory_order_relaxed);
+    }
+    return x;
+}
+
+static inline ws_task *ws_steal(ws_deque *q) {
+    long long t = atomic_load_explicit(&q->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long b = atomic_load_explicit(&q->bottom, memory_order_acquire);
+    if (t >= b) {
+        return WS_EMPTY;
+    }
+    ws_task *x = atomic_load_explicit(&q->buffer[t & (WS_DEQUE_CAPACITY - 1)], memory_order_acquire);
+    if (!atomic_compare_exchange_strong_explicit(&q->top, &t, t + 1, memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return WS_ABORT;
+    }
+    return x;
+}
+
+static inline long long ws_deque_size(ws_deque *q) {
+    return atomic_load_explicit(&q->bottom, memory_order_relaxed) -
+           atomic_load_explicit(&q->top, memory_order_relaxed);
+}
+
+/* Task frames */
+
+static inline ws_task *ws_alloc(ws_worker *w) {
+    if (w->free_list == NULL) {
+        ws_task *slab = (ws_task *)aligned_alloc(WS_CACHE_LINE, WS_SLAB * sizeof(ws_task));
+        for (int i = 0; i < WS_SLAB; i++) {
+            slab[i].next_free = i + 1 < WS_SLAB ? &slab[i + 1] : NULL;
+        }
+        if (w->nslabs == w->slab_cap) {
+            w->slab_cap = w->slab_cap ? 2 * w->slab_cap : 16;
+            w->slabs = (void **)realloc(w->slabs, w->slab_cap * sizeof(void *));
+        }
+        w->slabs[w->nslabs++] = slab;
+        w->free_list = slab;
+    }
+    ws_task *t = w->free_list;
+    w->free_list = t->next_free;
+    return t;
+}
+
+static inline void ws_release(ws_worker *w, ws_task *t) {
+    t->next_free = w->free_list;
+    w->free_list = t;
+}
+
+/* Scheduling */
+
+static inline void ws_execute(ws_worker *w, ws_task *t) {
+    t->fn(w, t);
+    atomic_store_explicit(&t->done, 1, memory_order_release);
+}
+
+static inline uint64_t ws_random(ws_worker *w) {
+    w->rng ^= w->rng << 13;
+    w->rng ^= w->rng >> 7;
+    w->rng ^= w->rng << 17;
+    return w->rng;
+}
+
+// Try one random victim; runs the stolen task. Returns 1 if it ran one.
+static inline int ws_try_steal(ws_worker *w) {
+    int n = w->rt->nthreads;
+    if (n < 2) {
+        return 0;
+    }
+    int victim = (int)(ws_random(w) % (uint64_t)(n - 1));
+    victim += victim >= w->id;
+    ws_task *t = ws_steal(&w->rt->workers[victim].deque);
+    if (t == WS_EMPTY || t == WS_ABORT) {
+        w->stats.failed_steals++;
+        return 0;
+    }
+    w->stats.steals++;
+    ws_execute(w, t);
+    return 1;
+}
+
+static inline void ws_spawn(ws_worker *w, ws_task *t) {
+    atomic_store_explicit(&t->done, 0, memory_order_relaxed);
+    w->stats.spawns++;
+    if (ws_deque_size(&w->deque) >= WS_DEQUE_CAPACITY - 1) {
+        ws_execute(w, t);
+        return;
+    }
+    ws_push(&w->deque, t);
+}
+
+static inline void ws_sync(ws_worker *w, ws_task *t) {
+    if (atomic_load_explicit(&t->done, memory_order_acquire)) {
+        return;
+    }
+    // Strict nesting: t is at the bottom of the deque unless it was stolen
+    ws_task *x = ws_take(&w->deque);
+    if (x == t) {
+        w->stats.inline_pops++;
+        t->fn(w, t);
+        return;
+    }
+    int fails = 0;
+    while (!atomic_load_explicit(&t->done, memory_order_acquire)) {
+        if (ws_try_steal(w)) {
+            fails = 0;
+        } else if (++fails >= WS_STEAL_SPINS) {
+            sched_yield();
+            fails = 0;
+        }
+    }
+}
+
+static inline void *ws_worker_main(void *arg) {
+    ws_worker *w = (ws_worker *)arg;
+    ws_runtime *rt = w->rt;
+    int seen = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&rt->lock);
+        while (rt->generation == seen && !rt->shutdown) {
+            pthread_cond_wait(&rt->wake, &rt->lock);
+        }
+        seen = rt->generation;
+        int stop = rt->shutdown;
+        pthread_mutex_unlock(&rt->lock);
+        if (stop) {
+            return NULL;
+        }
+
+        int fails = 0;
+        while (atomic_load_explicit(&rt->active, memory_order_acquire)) {
+            if (ws_try_steal(w)) {
+                fails = 0;
+            } else if (++fails >= WS_STEAL_SPINS) {
+                sched_yield();
+                fails = 0;
+            }
+        }
+        atomic_fetch_sub_explicit(&rt->stealing, 1, memory_order_release);
+    }
+}
+
+// Start nthreads - 1 workers; the caller acts as worker 0 in ws_runtime_run()
+static inline int ws_runtime_init(ws_runtime *rt, int nthreads) {
+    memset(rt, 0, sizeof(*rt));
+    rt->nthreads = nthreads;
+    rt->workers = (ws_worker *)aligned_alloc(WS_CACHE_LINE, nthreads * sizeof(ws_worker));
+    rt->threads = (pthread_t *)malloc(nthreads * sizeof(pthread_t));
+    if (rt->workers == NULL || rt->threads == NULL) {
+        return -1;
+    }
+    memset(rt->workers, 0, nthreads * sizeof(ws_worker));
+    pthread_mutex_init(&rt->lock, NULL);
+    pthread_cond_init(&rt->wake, NULL);
+
+    for (int i = 0; i < nthreads; i++) {
+        rt->workers[i].rt = rt;
+        rt->workers[i].id = i;
+        rt->workers[i].rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+    }
+    for (int i = 1; i < nthreads; i++) {
+        if (pthread_create(&rt->threads[i], NULL, ws_worker_main, &rt->workers[i]) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Run root on the calling thread with all workers stealing; returns once
+ * root has returned and every worker has stopped, so the stats are stable
+ */
+static inline void ws_runtime_run(ws_runtime *rt, ws_task *root) {
+    atomic_store_explicit(&rt->stealing, rt->nthreads - 1, memory_order_relaxed);
+    atomic_store_explicit(&rt->active, 1, memory_order_release);
+    pthread_mutex_lock(&rt->lock);
+    rt->generation++;
+    pthread_cond_broadcast(&rt->wake);
+    pthread_mutex_unlock(&rt->lock);
+
+    ws_execute(&rt->workers[0], root);
+    atomic_store_explicit(&rt->active, 0, memory_order_release);
+    while (atomic_load_explicit(&rt->stealing, memory_order_acquire) > 0) {
+        sched_yield();
+    }
+}
+
+static inline void ws_runtime_reset_stats(ws_runtime *rt) {
+    for (int i = 0; i < rt->nthreads; i++) {
+        memset(&rt->workers[i].stats, 0, sizeof(ws_stats));
+    }
+}
+
+static inline ws_stats ws_runtime_total_stats(ws_runtime *rt) {
+    ws_stats s;
+    memset(&s, 0, sizeof(s));
+    for (int i = 0; i < rt->nthreads; i++) {
+        s.spawns += rt->workers[i].stats.spawns;
+        s.inline_pops += rt->workers[i].stats.inline_pops;
+        s.steals += rt->workers[i].stats.steals;
+        s.failed_steals += rt->workers[i].stats.failed_steals;
+    }
+    return s;
+}
+
+static inline void ws_runtime_destroy(ws_runtime *rt) {
+    pthread_mutex_lock(&rt->lock);
+    rt->shutdown = 1;
+    pthread_cond_broadcast(&rt->wake);
+    pthread_mutex_unlock(&rt->lock);
+    for (int i = 1; i < rt->nthreads; i++) {
+        pthread_join(rt->threads[i], NULL);
+    }
+    for (int i = 0; i < rt->nthreads; i++) {
+        for (int s = 0; s < rt->workers[i].nslabs; s++) {
+            free(rt->workers[i].slabs[s]);
+        }
+        free(rt->workers[i].slabs);
+    }
+    pthread_mutex_destroy(&rt->lock);
+    pthread_cond_destroy(&rt->wake);
+    free(rt->workers);
+    free(rt->threads);
+}
+
+#endif /* WORKSTEAL_H */